@@ -0,0 +1,247 @@
+/* include area */
+#include "binary_tree.h"
+#include "hash_chain.h"
+#include "math2.h"
+
+
+/** Constants */
+
+/** Value of an empty table entry. */
+#define NIL 0U
+
+/** Minimum and maximum number of bits of the hash values. */
+#define MIN_HASH_BITS 8U
+#define MAX_HASH_BITS 20U
+
+/** Relative positions are rebased before reaching this value. */
+#define REBASE_LIMIT ( UINT32_MAX - 1 )
+
+
+/**
+ * Drops the positions that are out of the window and moves the base so the relative positions
+ * fit again in 32 bits.
+ * @param bt  Binary tree.
+ * @param pos Position about to be inserted.
+ */
+static void _rebase( binary_tree_t *bt, uint64_t pos )
+{
+  uint64_t new_base = pos - bt->window_size;
+  uint32_t delta = new_base - bt->base;
+
+  for( size_t i = 0; i < ( ( size_t )1 << bt->hash_bits ); i++ )
+    bt->head[i] = ( bt->head[i] > delta ) ? bt->head[i] - delta : NIL;
+
+  for( size_t i = 0; i < 2 * ( bt->window_size + 1 ); i++ )
+    bt->son[i] = ( bt->son[i] > delta ) ? bt->son[i] - delta : NIL;
+
+  bt->base = new_base;
+}
+
+
+/**
+ * Inserts \a pos as the new root of the tree of its hash, splitting the old tree in the strings
+ * that are smaller and greater than the one at \a pos.
+ * On the way down, every match longer than the previous ones is stored in \a matches (if there
+ * are more than \a max_matches, the last one is replaced by the longer ones).
+ * @param  bt          Binary tree.
+ * @param  w           Window holding the data.
+ * @param  pos         Stream offset to insert.
+ * @param  max_len     Maximum number of bytes compared (bytes available after \a pos).
+ * @param  matches     Matches found (can be \c NULL if not needed).
+ * @param  max_matches Capacity of \a matches.
+ * @param  pow2        Whether the window's buffer is a power of two (see \c window_byte).
+ * @return             Number of matches stored.
+ */
+static WINDOW_INLINE size_t _update( binary_tree_t *bt,
+                                     const window_t *w,
+                                     uint64_t pos,
+                                     size_t max_len,
+                                     match_t *matches,
+                                     size_t max_matches,
+                                     bool pow2 )
+{
+  if( pos - bt->base + 1 > REBASE_LIMIT )
+    _rebase( bt, pos );
+
+  uint32_t h = hash_chain_hash( w, pos, bt->hash_len, bt->hash_bits );
+  uint32_t pos_rel = ( uint32_t )( pos - bt->base + 1 );
+  uint32_t rel = bt->head[h];
+  bt->head[h] = pos_rel;
+
+  /* links still pending to be set, for the smaller and greater subtrees of the new root */
+  uint32_t *smaller = &bt->son[2 * ( pos % ( bt->window_size + 1 ) )];
+  uint32_t *greater = smaller + 1;
+
+  /* lengths known to match at the boundaries of both subtrees */
+  size_t len_smaller = 0, len_greater = 0;
+  size_t best_len = 0;
+  size_t num_matches = 0;
+
+  for( size_t depth = bt->max_depth; ; depth-- )
+  {
+    uint64_t candidate = bt->base + rel - 1;
+    if( rel == NIL || rel >= pos_rel || depth == 0 || pos - candidate > bt->window_size )
+    {
+      *smaller = NIL;
+      *greater = NIL;
+      break;
+    }
+
+    uint32_t *pair = &bt->son[2 * ( candidate % ( bt->window_size + 1 ) )];
+
+    /* every string in the subtree shares at least this prefix with the one at pos */
+    size_t len = MIN( len_smaller, len_greater );
+    len += window_match_length( w, candidate + len, pos + len, max_len - len );
+
+    if( len > best_len && matches )
+    {
+      best_len = len;
+
+      if( num_matches < max_matches )
+        num_matches++;
+
+      matches[num_matches - 1].pos = pos - candidate - 1;
+      matches[num_matches - 1].len = len;
+    }
+
+    if( len == max_len )
+    {
+      /* can't tell which string is smaller, so the candidate is replaced by the new root */
+      *smaller = pair[0];
+      *greater = pair[1];
+      break;
+    }
+
+    byte next = window_byte( w, candidate + len, pow2 );
+    if( next < ( byte )window_byte( w, pos + len, pow2 ) )
+    {
+      *smaller = rel;
+      smaller = &pair[1];
+      rel = *smaller;
+      len_smaller = len;
+    }
+    else
+    {
+      *greater = rel;
+      greater = &pair[0];
+      rel = *greater;
+      len_greater = len;
+    }
+  }
+
+  return num_matches;
+}
+
+
+/**
+ * Calls \c _update with the mapping of the window's buffer (the window is mapped the same way all
+ * the way down the tree).
+ * @param  bt          Binary tree.
+ * @param  w           Window holding the data.
+ * @param  pos         Stream offset to insert.
+ * @param  max_len     Maximum number of bytes compared (bytes available after \a pos).
+ * @param  matches     Matches found (can be \c NULL if not needed).
+ * @param  max_matches Capacity of \a matches.
+ * @return             Number of matches stored.
+ */
+static size_t _update_window( binary_tree_t *bt,
+                              const window_t *w,
+                              uint64_t pos,
+                              size_t max_len,
+                              match_t *matches,
+                              size_t max_matches )
+{
+  if( window_is_pow2( w ) )
+    return _update( bt, w, pos, max_len, matches, max_matches, true );
+
+  return _update( bt, w, pos, max_len, matches, max_matches, false );
+}
+
+
+/**
+ * Initializes a binary tree match finder.
+ * @param  bt          Binary tree to initialize.
+ * @param  window_size Maximum match distance.
+ * @param  hash_len    Number of bytes hashed at each position (the minimum match length).
+ * @param  max_depth   Maximum number of nodes visited per search.
+ * @return             \c true on success, \c false otherwise.
+ */
+bool binary_tree_init( binary_tree_t *bt, size_t window_size, size_t hash_len, size_t max_depth )
+{
+  /* the relative positions of a whole window must fit comfortably in 32 bits */
+  if( window_size == 0 || window_size > ( UINT32_MAX >> 1 ) || hash_len == 0 || max_depth == 0 )
+    return false;
+
+  bt->hash_bits = MIN( MAX( math_bits_in_n( window_size - 1 ), MIN_HASH_BITS ), MAX_HASH_BITS );
+  bt->hash_len = hash_len;
+  bt->window_size = window_size;
+  bt->max_depth = max_depth;
+  bt->base = 0;
+
+  bt->head = calloc( ( size_t )1 << bt->hash_bits, sizeof( uint32_t ) );
+  if( bt->head == NULL )
+    return false;
+
+  /* there's one extra node so the children of a candidate a whole window away don't overlap with
+   * the ones of the position being inserted */
+  bt->son = calloc( 2 * ( window_size + 1 ), sizeof( uint32_t ) );
+  if( bt->son == NULL )
+    goto error0;
+
+  return true;
+
+error0:
+  free( bt->head );
+  return false;
+}
+
+
+/**
+ * Releases all the resources taken by the binary tree.
+ * @param bt Binary tree.
+ */
+void binary_tree_release( binary_tree_t *bt )
+{
+  free( bt->head );
+  free( bt->son );
+  bt->head = NULL;
+  bt->son = NULL;
+}
+
+
+/**
+ * Inserts a position in the tree without looking for matches.
+ * The positions are inserted in order, but some can be skipped (like the middle of long runs):
+ * the trees stay sorted, and the positions skipped are only lost as match candidates.
+ * @param bt      Binary tree.
+ * @param w       Window holding the data.
+ * @param pos     Stream offset to insert.
+ * @param max_len Bytes available after \a pos (at least \c hash_len).
+ */
+void binary_tree_insert( binary_tree_t *bt, const window_t *w, uint64_t pos, size_t max_len )
+{
+  _update_window( bt, w, pos, max_len, NULL, 0 );
+}
+
+
+/**
+ * Finds the matches for the string at \a pos and inserts \a pos in the tree.
+ * Each match stored is longer than the previous one, and it's the closest with its length. If
+ * there are more matches than \a max_matches, the last one is replaced by the longer ones.
+ * @param  bt          Binary tree.
+ * @param  w           Window holding the data.
+ * @param  pos         Stream offset of the string to match.
+ * @param  max_len     Maximum match length (at least \c hash_len bytes must be available).
+ * @param  matches     Matches found (the positions are relative to the byte preceding \a pos).
+ * @param  max_matches Capacity of \a matches (at least 1).
+ * @return             Number of matches stored.
+ */
+size_t binary_tree_find_all( binary_tree_t *bt,
+                             const window_t *w,
+                             uint64_t pos,
+                             size_t max_len,
+                             match_t *matches,
+                             size_t max_matches )
+{
+  return _update_window( bt, w, pos, max_len, matches, max_matches );
+}
@@ -0,0 +1,57 @@
+#ifndef BINARY_TREE_H
+#define BINARY_TREE_H
+
+
+/* include area */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "match.h"
+#include "window.h"
+
+
+/** Binary tree match finder.
+ *  Every hash value has a binary search tree of the strings starting at the positions in the
+ *  window, with the newest position at the root. Positions are stored as 32 bits values relative
+ *  to \c base (the same way \c hash_chain_t does). */
+typedef struct
+{
+  /** Root of the tree of each hash value. */
+  uint32_t *head;
+
+  /** Children (smaller, greater) of each position, indexed by position modulo the window size
+   *  plus one. */
+  uint32_t *son;
+
+  /** Number of bits of the hash values. */
+  size_t hash_bits;
+
+  /** Number of bytes hashed at each position. */
+  size_t hash_len;
+
+  /** Maximum distance of a match. */
+  size_t window_size;
+
+  /** Maximum number of nodes visited per search. */
+  size_t max_depth;
+
+  /** Stream offset the stored positions are relative to. */
+  uint64_t base;
+
+} binary_tree_t;
+
+
+/* prototypes */
+bool binary_tree_init( binary_tree_t *bt, size_t window_size, size_t hash_len, size_t max_depth );
+void binary_tree_release( binary_tree_t *bt );
+
+void binary_tree_insert( binary_tree_t *bt, const window_t *w, uint64_t pos, size_t max_len );
+size_t binary_tree_find_all( binary_tree_t *bt,
+                             const window_t *w,
+                             uint64_t pos,
+                             size_t max_len,
+                             match_t *matches,
+                             size_t max_matches );
+
+
+#endif
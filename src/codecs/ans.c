@@ -0,0 +1,1083 @@
+/* include area */
+#include "ans.h"
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "bucket.h"
+#include "../math2.h"
+
+
+/** Constants */
+#define BITS_IN_BYTE 8U
+
+/** Number of bits of the sum of the frequencies of a table. */
+#define SCALE_BITS 12U
+
+/** Sum of the frequencies of a table. */
+#define SCALE ( 1U << SCALE_BITS )
+
+/** Number of interleaved states. */
+#define NUM_STATES 4U
+
+/** Lower bound of the states (they are kept between it and 256 times it). */
+#define STATE_LOW ( 1U << 23 )
+
+/** Symbol of the literal/length alphabet ending a block (the literals are the symbols before
+ *  it). */
+#define END_OF_BLOCK 256U
+
+/** First symbol of the literal/length alphabet for the match length buckets. */
+#define FIRST_LENGTH_SYMBOL 257U
+
+/** Maximum number of symbols of the literal/length alphabet. */
+#define MAX_LITLEN_SYMBOLS ( FIRST_LENGTH_SYMBOL + BUCKET_MAX_CODES )
+
+/** Maximum number of symbols of the offset alphabet. */
+#define MAX_OFFSET_SYMBOLS BUCKET_MAX_CODES
+
+/** Number of bits of the number of symbols of the literal/length alphabet in a block header. */
+#define LITLEN_COUNT_BITS 9U
+
+/** Number of bits of the number of symbols of the offset alphabet in a block header. */
+#define OFFSET_COUNT_BITS 7U
+
+/** Number of bits of the bucket code of a frequency in a block header. */
+#define FREQ_CODE_BITS 5U
+
+/** Number of bits of the number of zero frequencies following a zero frequency in a block
+ *  header. */
+#define ZERO_RUN_BITS 5U
+
+/** Number of bits of the sizes of the streams in a block header. */
+#define SIZE_BITS 24U
+
+/** Maximum number of symbols of a block (a literal/length symbol per token, the end of block
+ *  symbol and an offset symbol per match). */
+#define MAX_SYMBOLS ( 2 * ANS_CODEC_BLOCK_SIZE + 1 )
+
+/** Maximum size of the encoded symbols of a block (each symbol outputs up to 2 bytes, and the
+ *  final states take 4 bytes each). */
+#define MAX_STREAM_SIZE ( 2 * MAX_SYMBOLS + 4 * NUM_STATES )
+
+/** Maximum size of the extra bits of a block (up to 64 bits per token), with room for a whole
+ *  word after them. */
+#define MAX_EXTRA_SIZE ( 8 * ANS_CODEC_BLOCK_SIZE + sizeof( uint64_t ) )
+
+
+/*
+ * The tokens are encoded in blocks, each one with its own frequency tables:
+ *
+ *   last block flag (1 bit).
+ *   number of symbols of the literal/length alphabet (9 bits), followed by their frequencies.
+ *   number of symbols of the offset alphabet (7 bits), followed by their frequencies.
+ *   size of the symbol stream (24 bits).
+ *   size of the extra bits stream (24 bits), and zeros up to the end of the byte.
+ *   symbol stream: the four rANS states (4 bytes each, little endian) followed by the bytes read
+ *                  renormalizing them. The literal/length symbols of all the tokens come first
+ *                  (up to the end of block symbol), and then the offset symbols of the matches,
+ *                  decoded in turns by each state.
+ *   extra bits stream: the extra bits of the length and offset buckets, in token order.
+ *
+ * The frequencies add up to 4096 and are written as a bucket code (5 bits) and its extra bits,
+ * and a zero frequency is followed by 5 bits with the number of zero frequencies after it.
+ */
+
+
+/** Data types */
+
+/** Frequency table of an alphabet. */
+typedef struct
+{
+  /** Number of symbols (up to the last one with a frequency). */
+  size_t num_symbols;
+
+  /** Normalized frequency of each symbol (they add up to \c SCALE). */
+  uint16_t freqs[MAX_LITLEN_SYMBOLS];
+
+  /** Sum of the frequencies of the symbols before each one. */
+  uint16_t starts[MAX_LITLEN_SYMBOLS];
+
+} ans_table_t;
+
+
+/** Token buffered until its block is encoded. */
+typedef struct
+{
+  /** Match length (zero for a literal). */
+  uint32_t len;
+
+  /** Match position or literal. */
+  uint32_t value;
+
+} ans_token_t;
+
+
+/** Parts of the stream, in the order they are decoded. */
+typedef enum
+{
+  ans_state_block,
+  ans_state_freqs,
+  ans_state_offset_count,
+  ans_state_sizes,
+  ans_state_payload,
+  ans_state_tokens,
+  ans_state_done,
+
+} ans_state_t;
+
+
+/** ANS codec internal data. */
+typedef struct
+{
+  /** Bits encoded but not stored in the sink yet. */
+  bit_writer_t writer;
+
+  /** Where the encoded data is written (\c NULL if the codec is only used to decode). */
+  sink_t *sink;
+
+  /** Sink owned by the codec (when created with a callback). */
+  sink_t own_sink;
+
+  /** Minimum match length. */
+  size_t min_match_len;
+
+  /** Maximum match length. */
+  size_t max_match_len;
+
+  /** Number of symbols of the literal/length alphabet for the match lengths allowed. */
+  size_t max_litlen_symbols;
+
+  /** Number of symbols of the offset alphabet for the positions allowed. */
+  size_t max_offset_symbols;
+
+  /** Tokens of the block being encoded (\c ANS_CODEC_BLOCK_SIZE of them). */
+  ans_token_t *tokens;
+
+  /** Number of tokens in \c tokens. */
+  size_t num_tokens;
+
+  /** Occurrences of the literal/length symbols of the block. */
+  size_t litlen_counts[MAX_LITLEN_SYMBOLS];
+
+  /** Occurrences of the offset symbols of the block. */
+  size_t offset_counts[MAX_OFFSET_SYMBOLS];
+
+  /** Literal/length table of the last block (encoded or being decoded). */
+  ans_table_t litlen;
+
+  /** Offset table of the last block (encoded or being decoded). */
+  ans_table_t offset;
+
+  /** Symbols of the block (\c MAX_SYMBOLS of them), the literal/length ones followed by the offset
+   *  ones. */
+  uint16_t *symbols;
+
+  /** Symbol stream followed by the extra bits stream of a block (\c MAX_STREAM_SIZE and
+   *  \c MAX_EXTRA_SIZE bytes). */
+  byte *payload;
+
+  /** Bits read but not decoded yet. */
+  bit_reader_t reader;
+
+  /** Part of the stream being decoded. */
+  ans_state_t state;
+
+  /** Whether the block being decoded is the last one. */
+  bool last_block;
+
+  /** Table whose frequencies are being read. */
+  ans_table_t *reading;
+
+  /** Next symbol whose frequency is read. */
+  size_t symbol;
+
+  /** Size of the symbol stream of the block being decoded. */
+  size_t stream_size;
+
+  /** Size of the extra bits stream of the block being decoded. */
+  size_t extra_size;
+
+  /** Number of bytes of the payload read. */
+  size_t payload_len;
+
+  /** Next literal/length symbol decoded. */
+  size_t next_litlen;
+
+  /** Next offset symbol decoded. */
+  size_t next_offset;
+
+  /** Extra bits being decoded. */
+  bit_reader_t extra;
+
+  /** Next byte of the extra bits. */
+  const byte *extra_data;
+
+  /** Number of extra bits not decoded yet. */
+  size_t extra_left;
+
+  /** Symbol of each slot of the literal/length frequencies. */
+  uint16_t litlen_slots[SCALE];
+
+  /** Symbol of each slot of the offset frequencies. */
+  uint16_t offset_slots[SCALE];
+
+} ans_codec_t;
+
+
+/**
+ * Normalizes the occurrences of the symbols so the frequencies add up to \c SCALE (every symbol
+ * that occurs keeps a frequency).
+ * @param table  Table built.
+ * @param counts Occurrences of each symbol.
+ * @param n      Number of symbols of the alphabet.
+ */
+static void _normalize( ans_table_t *table, const size_t *counts, size_t n )
+{
+  size_t total = 0, largest = 0;
+
+  memset( table->freqs, 0, sizeof( table->freqs ) );
+  table->num_symbols = 0;
+
+  for( size_t i = 0; i < n; i++ )
+  {
+    total += counts[i];
+    if( counts[i] > 0 )
+      table->num_symbols = i + 1;
+    if( counts[i] > counts[largest] )
+      largest = i;
+  }
+
+  if( total == 0 )
+    return;
+
+  size_t sum = 0;
+  for( size_t i = 0; i < table->num_symbols; i++ )
+  {
+    if( counts[i] > 0 )
+    {
+      table->freqs[i] = MAX( ( uint64_t )counts[i] * SCALE / total, 1 );
+      sum += table->freqs[i];
+    }
+  }
+
+  /* the rounding error is fixed with the largest frequencies */
+  if( sum <= SCALE )
+    table->freqs[largest] += SCALE - sum;
+
+  while( sum > SCALE )
+  {
+    size_t max = 0;
+    for( size_t i = 1; i < table->num_symbols; i++ )
+      if( table->freqs[i] > table->freqs[max] )
+        max = i;
+
+    table->freqs[max]--;
+    sum--;
+  }
+
+  for( size_t i = 0, start = 0; i < table->num_symbols; i++ )
+  {
+    table->starts[i] = start;
+    start += table->freqs[i];
+  }
+}
+
+
+/**
+ * Builds the table of the symbols of each slot from the frequencies.
+ * @param  table Table with the frequencies set.
+ * @param  slots Symbol of each slot.
+ * @return       \c true on success, \c false if the frequencies are not valid.
+ */
+static bool _build_slots( ans_table_t *table, uint16_t *slots )
+{
+  size_t start = 0;
+
+  for( size_t i = 0; i < table->num_symbols; i++ )
+  {
+    if( table->freqs[i] > SCALE - start )
+      return false;
+
+    table->starts[i] = start;
+    for( size_t j = 0; j < table->freqs[i]; j++ )
+      slots[start + j] = i;
+
+    start += table->freqs[i];
+  }
+
+  /* an empty table is only valid if the alphabet isn't used */
+  return start == SCALE || table->num_symbols == 0;
+}
+
+
+/**
+ * Stores the bytes completed one at a time (near the end of a caller's buffer, where a whole word
+ * doesn't fit).
+ * @param  ac The ANS codec.
+ * @return    \c true on success, \c false otherwise.
+ */
+static bool _put_bytes( ans_codec_t *ac )
+{
+  while( ac->writer.count >= BITS_IN_BYTE )
+  {
+    byte b = bit_writer_take_byte( &ac->writer );
+    if( !sink_write( ac->sink, &b, sizeof( b ) ) )
+      return false;
+  }
+
+  return true;
+}
+
+
+/**
+ * Encodes some bits of a block header and stores the bytes completed in the sink.
+ * @param  ac       The ANS codec.
+ * @param  bits     Bits (the least significant \a num_bits).
+ * @param  num_bits Number of bits (up to \c BIT_WRITER_MAX_BITS).
+ * @return          \c true on success, \c false otherwise.
+ */
+static bool _put( ans_codec_t *ac, uint64_t bits, size_t num_bits )
+{
+  bit_writer_put( &ac->writer, bits, num_bits );
+
+  byte *out = sink_reserve( ac->sink, sizeof( uint64_t ) );
+  if( out == NULL )
+    return ac->sink->cb == NULL && _put_bytes( ac );
+
+  byte *end = out;
+  bit_writer_flush( &ac->writer, &end );
+  sink_commit( ac->sink, end - out );
+
+  return true;
+}
+
+
+/**
+ * Writes the frequencies of an alphabet in a block header.
+ * @param  ac         The ANS codec.
+ * @param  table      Table of the alphabet.
+ * @param  count_bits Number of bits of the number of symbols.
+ * @return            \c true on success, \c false otherwise.
+ */
+static bool _put_freqs( ans_codec_t *ac, const ans_table_t *table, size_t count_bits )
+{
+  if( !_put( ac, table->num_symbols, count_bits ) )
+    return false;
+
+  for( size_t i = 0; i < table->num_symbols; )
+  {
+    size_t freq = table->freqs[i++];
+    bool success;
+
+    /* a zero frequency is followed by the number of zero frequencies after it */
+    if( freq == 0 )
+    {
+      size_t run = 0;
+      while( i < table->num_symbols && table->freqs[i] == 0 && run < ( 1U << ZERO_RUN_BITS ) - 1 )
+      {
+        run++;
+        i++;
+      }
+
+      success = _put( ac, run, FREQ_CODE_BITS + ZERO_RUN_BITS );
+    }
+    else
+    {
+      size_t code = bucket_code( freq );
+      size_t extra_bits = bucket_extra_bits( code );
+      success = _put( ac,
+                      ( code << extra_bits ) | ( freq - bucket_base( code ) ),
+                      FREQ_CODE_BITS + extra_bits );
+    }
+
+    if( !success )
+      return false;
+  }
+
+  return true;
+}
+
+
+/**
+ * Appends the extra bits of a bucket to the extra bits stream.
+ * @param bw     Bit writer of the stream.
+ * @param out    End of the stream (advanced past the bytes completed).
+ * @param bucket Bucket code of the value.
+ * @param value  Value encoded by the bucket.
+ */
+static inline void _put_extra( bit_writer_t *bw, byte **out, size_t bucket, size_t value )
+{
+  size_t num_bits = bucket_extra_bits( bucket );
+
+  if( num_bits > 0 )
+  {
+    bit_writer_put( bw, value - bucket_base( bucket ), num_bits );
+    bit_writer_flush( bw, out );
+  }
+}
+
+
+/**
+ * Encodes the tokens buffered as a block, with frequency tables built for them.
+ * @param  ac   The ANS codec.
+ * @param  last Whether it's the last block of the stream.
+ * @return      \c true on success, \c false otherwise.
+ */
+static bool _write_block( ans_codec_t *ac, bool last )
+{
+  ac->litlen_counts[END_OF_BLOCK]++;
+  _normalize( &ac->litlen, ac->litlen_counts, MAX_LITLEN_SYMBOLS );
+  _normalize( &ac->offset, ac->offset_counts, MAX_OFFSET_SYMBOLS );
+
+  memset( ac->litlen_counts, 0, sizeof( ac->litlen_counts ) );
+  memset( ac->offset_counts, 0, sizeof( ac->offset_counts ) );
+
+  /* sorts out the symbols, and writes the extra bits in token order */
+  byte *extra = ac->payload + MAX_STREAM_SIZE;
+  byte *extra_end = extra;
+  bit_writer_t bw;
+  bit_writer_init( &bw );
+
+  size_t num_litlen = ac->num_tokens + 1;
+  size_t num_symbols = num_litlen;
+
+  for( size_t i = 0; i < ac->num_tokens; i++ )
+  {
+    const ans_token_t *token = &ac->tokens[i];
+
+    if( token->len == 0 )
+      ac->symbols[i] = token->value;
+    else
+    {
+      size_t len = token->len - ac->min_match_len;
+      size_t len_bucket = bucket_code( len );
+      size_t pos_bucket = bucket_code( token->value );
+
+      ac->symbols[i] = FIRST_LENGTH_SYMBOL + len_bucket;
+      ac->symbols[num_symbols++] = pos_bucket;
+      _put_extra( &bw, &extra_end, len_bucket, len );
+      _put_extra( &bw, &extra_end, pos_bucket, token->value );
+    }
+  }
+
+  ac->symbols[ac->num_tokens] = END_OF_BLOCK;
+  ac->num_tokens = 0;
+
+  size_t extra_size = ( extra_end - extra ) + ( bw.count > 0 );
+
+  /* the symbols are encoded backwards, so they are decoded forwards */
+  byte *stream_end = ac->payload + MAX_STREAM_SIZE;
+  byte *p = stream_end;
+  uint32_t x[NUM_STATES];
+
+  for( size_t i = 0; i < NUM_STATES; i++ )
+    x[i] = STATE_LOW;
+
+  for( size_t i = num_symbols; i-- > 0; )
+  {
+    const ans_table_t *table = ( i < num_litlen ) ? &ac->litlen : &ac->offset;
+    size_t symbol = ac->symbols[i];
+    uint32_t *s = &x[i % NUM_STATES];
+    uint32_t freq = table->freqs[symbol];
+
+    /* renormalizes so the state stays in range after the symbol is added */
+    uint32_t x_max = ( ( STATE_LOW >> SCALE_BITS ) << BITS_IN_BYTE ) * freq;
+    while( *s >= x_max )
+    {
+      *--p = *s;
+      *s >>= BITS_IN_BYTE;
+    }
+
+    *s = ( ( *s / freq ) << SCALE_BITS ) + ( *s % freq ) + table->starts[symbol];
+  }
+
+  for( size_t i = NUM_STATES; i-- > 0; )
+  {
+    p -= 4;
+    p[0] = x[i];
+    p[1] = x[i] >> 8;
+    p[2] = x[i] >> 16;
+    p[3] = x[i] >> 24;
+  }
+
+  /* the header, padded up to the end of the byte, and the streams */
+  if( !_put( ac, last, 1 ) ||
+      !_put_freqs( ac, &ac->litlen, LITLEN_COUNT_BITS ) ||
+      !_put_freqs( ac, &ac->offset, OFFSET_COUNT_BITS ) ||
+      !_put( ac, stream_end - p, SIZE_BITS ) ||
+      !_put( ac, extra_size, SIZE_BITS ) )
+    return false;
+
+  if( ac->writer.count > 0 )
+  {
+    byte b = bit_writer_take_byte( &ac->writer );
+    if( !sink_write( ac->sink, &b, sizeof( b ) ) )
+      return false;
+  }
+
+  return sink_write( ac->sink, p, stream_end - p ) && sink_write( ac->sink, extra, extra_size );
+}
+
+
+/**
+ * Writes an encoded literal.
+ * @param  codec The codec instance.
+ * @param  c     Character to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_literal( codec_t *codec, unsigned char c )
+{
+  ans_codec_t *ac = codec->_int_data;
+
+  /* the tokens are encoded once the block is full */
+  if( ac->num_tokens == ANS_CODEC_BLOCK_SIZE && !_write_block( ac, false ) )
+    return false;
+
+  ac->tokens[ac->num_tokens++] = ( ans_token_t ){ .len = 0, .value = c };
+  ac->litlen_counts[c]++;
+
+  return true;
+}
+
+
+/**
+ * Writes an encoded match.
+ * @param  codec The codec instance.
+ * @param  m     The match to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_match( codec_t *codec, match_t m )
+{
+  ans_codec_t *ac = codec->_int_data;
+
+  if( ac->num_tokens == ANS_CODEC_BLOCK_SIZE && !_write_block( ac, false ) )
+    return false;
+
+  ac->tokens[ac->num_tokens++] = ( ans_token_t ){ .len = m.len, .value = m.pos };
+  ac->litlen_counts[FIRST_LENGTH_SYMBOL + bucket_code( m.len - ac->min_match_len )]++;
+  ac->offset_counts[bucket_code( m.pos )]++;
+
+  return true;
+}
+
+
+/**
+ * Returns the number of bits of a symbol with the frequencies of the last block.
+ * @param  table    Table of the alphabet.
+ * @param  symbol   Symbol.
+ * @param  fallback Number of bits if the symbol had no frequency.
+ * @return          Number of bits (rounded down).
+ */
+static inline size_t _price_symbol( const ans_table_t *table, size_t symbol, size_t fallback )
+{
+  size_t freq = table->freqs[symbol];
+
+  return ( freq > 0 ) ? SCALE_BITS + 1 - math_bits_in_n( freq ) : fallback;
+}
+
+
+/**
+ * Returns the size of an encoded literal (estimated with the frequencies of the last block).
+ * @param  codec The codec instance.
+ * @param  c     Character to encode.
+ * @return       Number of bits.
+ */
+static size_t _price_literal( const codec_t *codec, unsigned char c )
+{
+  const ans_codec_t *ac = codec->_int_data;
+
+  return _price_symbol( &ac->litlen, c, BITS_IN_BYTE );
+}
+
+
+/**
+ * Returns the size of an encoded match (estimated with the frequencies of the last block).
+ * @param  codec The codec instance.
+ * @param  m     Match to encode.
+ * @param  pos   Stream offset of the match.
+ * @return       Number of bits.
+ */
+static size_t _price_match( const codec_t *codec, match_t m, uint64_t pos )
+{
+  const ans_codec_t *ac = codec->_int_data;
+  size_t len_bucket = bucket_code( m.len - ac->min_match_len );
+  size_t pos_bucket = bucket_code( m.pos );
+
+  /* the buckets are around 64, so an unknown one takes about 6 bits */
+  return _price_symbol( &ac->litlen, FIRST_LENGTH_SYMBOL + len_bucket, 6 ) +
+         bucket_extra_bits( len_bucket ) +
+         _price_symbol( &ac->offset, pos_bucket, 6 ) +
+         bucket_extra_bits( pos_bucket );
+}
+
+
+/**
+ * Returns why a part of the stream couldn't be read when there are not enough bits.
+ * @param  in Encoded data.
+ * @return    \c codec_token_error if the input is over, \c codec_token_need_input otherwise.
+ */
+static inline codec_token_t _starved( const codec_input_t *in )
+{
+  return in->last ? codec_token_error : codec_token_need_input;
+}
+
+
+/**
+ * Fills the bit reader with input bytes (8 at a time if possible).
+ * @param ac The ANS codec.
+ * @param in Encoded data.
+ */
+static void _fill( ans_codec_t *ac, codec_input_t *in )
+{
+  bit_reader_t *br = &ac->reader;
+
+  if( br->count >= BIT_READER_REFILL_BITS )
+    return;
+
+  if( in->size - in->pos >= sizeof( uint64_t ) )
+  {
+    const byte *data = in->data + in->pos;
+    bit_reader_refill( br, &data );
+    in->pos = data - in->data;
+    return;
+  }
+
+  while( br->count <= BIT_READER_REFILL_BITS && in->pos < in->size )
+    bit_reader_push( br, in->data[in->pos++], BITS_IN_BYTE );
+}
+
+
+/**
+ * Reads the frequencies of the alphabet in \c reading.
+ * @param  ac The ANS codec.
+ * @param  in Encoded data.
+ * @return    \c codec_token_end if all the frequencies were read, or why they weren't.
+ */
+static codec_token_t _read_freqs( ans_codec_t *ac, codec_input_t *in )
+{
+  bit_reader_t *br = &ac->reader;
+  ans_table_t *table = ac->reading;
+
+  while( ac->symbol < table->num_symbols )
+  {
+    _fill( ac, in );
+    if( br->count < FREQ_CODE_BITS )
+      return _starved( in );
+
+    size_t code = bit_reader_peek( br, FREQ_CODE_BITS );
+    size_t num_bits = FREQ_CODE_BITS + ( ( code == 0 ) ? ZERO_RUN_BITS : bucket_extra_bits( code ) );
+
+    if( code > bucket_code( SCALE ) )
+      return codec_token_error;
+    if( br->count < num_bits )
+      return _starved( in );
+
+    size_t low_bits = bit_reader_peek( br, num_bits ) & ( ( ( size_t )1 << ( num_bits - FREQ_CODE_BITS ) ) - 1 );
+    bit_reader_consume( br, num_bits );
+
+    if( code == 0 )
+    {
+      if( low_bits + 1 > table->num_symbols - ac->symbol )
+        return codec_token_error;
+
+      memset( table->freqs + ac->symbol, 0, ( low_bits + 1 ) * sizeof( table->freqs[0] ) );
+      ac->symbol += low_bits + 1;
+    }
+    else
+      table->freqs[ac->symbol++] = bucket_base( code ) + low_bits;
+  }
+
+  return codec_token_end;
+}
+
+
+/**
+ * Decodes a symbol and renormalizes the state.
+ * @param  x      State.
+ * @param  slots  Symbol of each slot of the alphabet.
+ * @param  table  Table of the alphabet.
+ * @param  p      Next byte of the symbol stream.
+ * @param  end    End of the symbol stream.
+ * @param  symbol The symbol decoded.
+ * @return        \c true on success, \c false if the stream is over.
+ */
+static inline bool _decode_symbol( uint32_t *x,
+                                   const uint16_t *slots,
+                                   const ans_table_t *table,
+                                   const byte **p,
+                                   const byte *end,
+                                   size_t *symbol )
+{
+  size_t slot = *x & ( SCALE - 1 );
+  size_t s = slots[slot];
+
+  *x = table->freqs[s] * ( *x >> SCALE_BITS ) + slot - table->starts[s];
+  while( *x < STATE_LOW )
+  {
+    if( *p == end )
+      return false;
+
+    *x = ( *x << BITS_IN_BYTE ) | *( *p )++;
+  }
+
+  *symbol = s;
+  return true;
+}
+
+
+/**
+ * Decodes all the symbols of a block, once its payload was read.
+ * The four states decode the symbols in turns, so the decoding of each symbol doesn't wait for
+ * the previous one.
+ * @param  ac The ANS codec.
+ * @return    \c true on success, \c false if the block is not valid.
+ */
+static bool _decode_block( ans_codec_t *ac )
+{
+  const byte *p = ac->payload;
+  const byte *end = p + ac->stream_size;
+  uint32_t x[NUM_STATES];
+  size_t num_symbols = 0, num_matches = 0, symbol;
+
+  if( ac->stream_size < 4 * NUM_STATES )
+    return false;
+
+  for( size_t i = 0; i < NUM_STATES; i++, p += 4 )
+    x[i] = p[0] | ( ( uint32_t )p[1] << 8 ) | ( ( uint32_t )p[2] << 16 ) | ( ( uint32_t )p[3] << 24 );
+
+  /* the literal/length symbols, up to the end of the block */
+  do
+  {
+    if( num_symbols > ANS_CODEC_BLOCK_SIZE ||
+        !_decode_symbol( &x[num_symbols % NUM_STATES], ac->litlen_slots, &ac->litlen, &p, end, &symbol ) )
+      return false;
+
+    ac->symbols[num_symbols++] = symbol;
+    num_matches += ( symbol >= FIRST_LENGTH_SYMBOL );
+  }
+  while( symbol != END_OF_BLOCK );
+
+  /* the offset symbols of the matches */
+  if( num_matches > 0 && ac->offset.num_symbols == 0 )
+    return false;
+
+  ac->next_litlen = 0;
+  ac->next_offset = num_symbols;
+
+  for( size_t i = 0; i < num_matches; i++ )
+  {
+    if( !_decode_symbol( &x[num_symbols % NUM_STATES], ac->offset_slots, &ac->offset, &p, end, &symbol ) )
+      return false;
+
+    ac->symbols[num_symbols++] = symbol;
+  }
+
+  /* the whole stream must be used, taking the states back to their initial value */
+  for( size_t i = 0; i < NUM_STATES; i++ )
+    if( x[i] != STATE_LOW )
+      return false;
+
+  return p == end;
+}
+
+
+/**
+ * Reads the extra bits of a bucket.
+ * @param  ac     The ANS codec.
+ * @param  bucket Bucket code.
+ * @param  value  The value of the bucket.
+ * @return        \c true on success, \c false if the extra bits stream is over.
+ */
+static inline bool _read_extra( ans_codec_t *ac, size_t bucket, size_t *value )
+{
+  bit_reader_t *br = &ac->extra;
+  size_t num_bits = bucket_extra_bits( bucket );
+
+  if( num_bits > ac->extra_left )
+    return false;
+
+  /* the payload has room for a whole word after the stream */
+  if( br->count < num_bits )
+    bit_reader_refill( br, &ac->extra_data );
+
+  *value = bucket_base( bucket ) + bit_reader_peek( br, num_bits );
+  bit_reader_consume( br, num_bits );
+  ac->extra_left -= num_bits;
+
+  return true;
+}
+
+
+/**
+ * Decodes the next token.
+ * The whole payload of a block is read before its symbols are decoded at once, and then the
+ * tokens are returned one by one.
+ * @param  codec The codec instance.
+ * @param  in    Encoded data.
+ * @param  c     The literal read.
+ * @param  m     The match read.
+ * @return       The kind of token read, or why none could be read.
+ */
+static codec_token_t _read( codec_t *codec, codec_input_t *in, byte *c, match_t *m )
+{
+  ans_codec_t *ac = codec->_int_data;
+  bit_reader_t *br = &ac->reader;
+  codec_token_t token;
+
+  while( true )
+  {
+    switch( ac->state )
+    {
+      case ans_state_block:
+        _fill( ac, in );
+        if( br->count < 1 + LITLEN_COUNT_BITS )
+          return _starved( in );
+
+        ac->last_block = bit_reader_peek( br, 1 );
+        ac->litlen.num_symbols = bit_reader_peek( br, 1 + LITLEN_COUNT_BITS ) &
+                                 ( ( 1U << LITLEN_COUNT_BITS ) - 1 );
+        bit_reader_consume( br, 1 + LITLEN_COUNT_BITS );
+
+        /* the end of block symbol must be there */
+        if( ac->litlen.num_symbols <= END_OF_BLOCK ||
+            ac->litlen.num_symbols > ac->max_litlen_symbols )
+          return codec_token_error;
+
+        ac->reading = &ac->litlen;
+        ac->symbol = 0;
+        ac->state = ans_state_freqs;
+        break;
+
+      case ans_state_freqs:
+        token = _read_freqs( ac, in );
+        if( token != codec_token_end )
+          return token;
+
+        if( ac->reading == &ac->litlen )
+          ac->state = ans_state_offset_count;
+        else if( _build_slots( &ac->litlen, ac->litlen_slots ) &&
+                 _build_slots( &ac->offset, ac->offset_slots ) )
+          ac->state = ans_state_sizes;
+        else
+          return codec_token_error;
+        break;
+
+      case ans_state_offset_count:
+        _fill( ac, in );
+        if( br->count < OFFSET_COUNT_BITS )
+          return _starved( in );
+
+        ac->offset.num_symbols = bit_reader_peek( br, OFFSET_COUNT_BITS );
+        bit_reader_consume( br, OFFSET_COUNT_BITS );
+
+        if( ac->offset.num_symbols > ac->max_offset_symbols )
+          return codec_token_error;
+
+        ac->reading = &ac->offset;
+        ac->symbol = 0;
+        ac->state = ans_state_freqs;
+        break;
+
+      case ans_state_sizes:
+        _fill( ac, in );
+        if( br->count < 2 * SIZE_BITS )
+          return _starved( in );
+
+        ac->stream_size = bit_reader_peek( br, SIZE_BITS );
+        ac->extra_size = bit_reader_peek( br, 2 * SIZE_BITS ) & ( ( 1U << SIZE_BITS ) - 1 );
+        bit_reader_consume( br, 2 * SIZE_BITS );
+
+        if( ac->stream_size > MAX_STREAM_SIZE ||
+            ac->extra_size > MAX_EXTRA_SIZE - sizeof( uint64_t ) )
+          return codec_token_error;
+
+        /* the padding is dropped, and the whole bytes left in the reader start the payload */
+        bit_reader_consume( br, br->count % BITS_IN_BYTE );
+        ac->payload_len = 0;
+        while( br->count > 0 && ac->payload_len < ac->stream_size + ac->extra_size )
+        {
+          ac->payload[ac->payload_len++] = bit_reader_peek( br, BITS_IN_BYTE );
+          bit_reader_consume( br, BITS_IN_BYTE );
+        }
+
+        /* the rest of the payload is copied straight from the input */
+        if( br->count == 0 )
+          bit_reader_init( br );
+
+        ac->state = ans_state_payload;
+        break;
+
+      case ans_state_payload:
+      {
+        size_t n = MIN( ac->stream_size + ac->extra_size - ac->payload_len, in->size - in->pos );
+        memcpy( ac->payload + ac->payload_len, in->data + in->pos, n );
+        ac->payload_len += n;
+        in->pos += n;
+
+        if( ac->payload_len < ac->stream_size + ac->extra_size )
+          return _starved( in );
+
+        if( !_decode_block( ac ) )
+          return codec_token_error;
+
+        bit_reader_init( &ac->extra );
+        ac->extra_data = ac->payload + ac->stream_size;
+        ac->extra_left = BITS_IN_BYTE * ac->extra_size;
+        ac->state = ans_state_tokens;
+        break;
+      }
+
+      case ans_state_tokens:
+      {
+        size_t symbol = ac->symbols[ac->next_litlen++];
+        size_t len, pos;
+
+        if( symbol < END_OF_BLOCK )
+        {
+          *c = symbol;
+          return codec_token_literal;
+        }
+
+        if( symbol == END_OF_BLOCK )
+        {
+          ac->state = ac->last_block ? ans_state_done : ans_state_block;
+          break;
+        }
+
+        if( !_read_extra( ac, symbol - FIRST_LENGTH_SYMBOL, &len ) ||
+            len > ac->max_match_len - ac->min_match_len ||
+            !_read_extra( ac, ac->symbols[ac->next_offset++], &pos ) )
+          return codec_token_error;
+
+        m->len = len + ac->min_match_len;
+        m->pos = pos;
+        return codec_token_match;
+      }
+
+      case ans_state_done:
+        return codec_token_end;
+    }
+  }
+}
+
+
+/**
+ * Finishes the encoded output.
+ * @param  codec The codec instance.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _close( codec_t *codec )
+{
+  ans_codec_t *ac = codec->_int_data;
+
+  return _write_block( ac, true ) && sink_flush( ac->sink );
+}
+
+
+/**
+ * Destroys the codec releasing all the taken resources.
+ * @param codec Codec to destroy.
+ */
+static void _destroy( codec_t *codec )
+{
+  ans_codec_t *ac = codec->_int_data;
+
+  if( ac->sink == &ac->own_sink )
+    sink_release( ac->sink );
+
+  free( ac->tokens );
+  free( ac->symbols );
+  free( ac->payload );
+  free( codec );
+}
+
+
+/**
+ * Creates a new ANS codec writing into a sink.
+ * The tokens are encoded in blocks of \c ANS_CODEC_BLOCK_SIZE with an interleaved rANS coder, with
+ * the literals and match lengths in an alphabet and the match offsets in another (split in buckets
+ * like in deflate), and frequency tables built for each block.
+ * @param  sink          Sink where the encoded data is written (\c NULL if only used to decode).
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *ans_codec_create_sink( sink_t *sink,
+                                size_t min_match_len,
+                                size_t max_match_len,
+                                size_t max_pos )
+{
+  /* input checks (the buckets take up to 32 bits) */
+  if( min_match_len == 0 || min_match_len > max_match_len )
+    return NULL;
+  if( max_match_len > UINT32_MAX || max_pos < 1 || max_pos - 1 > UINT32_MAX )
+    return NULL;
+
+  NEW_CODEC( ans_codec_t );
+
+  ic->sink = sink;
+  ic->min_match_len = min_match_len;
+  ic->max_match_len = max_match_len;
+  ic->max_litlen_symbols = FIRST_LENGTH_SYMBOL + bucket_code( max_match_len - min_match_len ) + 1;
+  ic->max_offset_symbols = bucket_code( max_pos - 1 ) + 1;
+  ic->state = ans_state_block;
+  bit_reader_init( &ic->reader );
+  bit_writer_init( &ic->writer );
+
+  ic->symbols = malloc( MAX_SYMBOLS * sizeof( uint16_t ) );
+  ic->payload = calloc( 1, MAX_STREAM_SIZE + MAX_EXTRA_SIZE );
+  if( ic->symbols == NULL || ic->payload == NULL )
+  {
+    codec->destroy( codec );
+    return NULL;
+  }
+
+  /* the tokens are only buffered to encode */
+  if( sink != NULL )
+  {
+    ic->tokens = malloc( ANS_CODEC_BLOCK_SIZE * sizeof( ans_token_t ) );
+    if( ic->tokens == NULL )
+    {
+      codec->destroy( codec );
+      return NULL;
+    }
+  }
+
+  return codec;
+}
+
+
+/**
+ * Creates a new ANS codec.
+ * The encoded data is output through \a cb in chunks of \c ANS_CODEC_BUFFER_SIZE bytes, and when
+ * the codec is closed.
+ * @param  cb            Callback used to output data (\c NULL if only used to decode).
+ * @param  cb_ctx        Context passed to \a cb.
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *ans_codec_create( codec_out_cb_t cb,
+                           void *cb_ctx,
+                           size_t min_match_len,
+                           size_t max_match_len,
+                           size_t max_pos )
+{
+  codec_t *codec = ans_codec_create_sink( NULL, min_match_len, max_match_len, max_pos );
+  if( codec == NULL || cb == NULL )
+    return codec;
+
+  ans_codec_t *ac = codec->_int_data;
+  ac->tokens = malloc( ANS_CODEC_BLOCK_SIZE * sizeof( ans_token_t ) );
+  if( ac->tokens == NULL ||
+      !sink_init_callback( &ac->own_sink, cb, cb_ctx, ANS_CODEC_BUFFER_SIZE ) )
+  {
+    codec->destroy( codec );
+    return NULL;
+  }
+
+  ac->sink = &ac->own_sink;
+
+  return codec;
+}
@@ -0,0 +1,30 @@
+#ifndef ANS_H
+#define ANS_H
+
+
+/* include area */
+#include "codec.h"
+
+
+/* constants */
+
+/** Default size of the output buffer of the ANS codec. */
+#define ANS_CODEC_BUFFER_SIZE 65536
+
+/** Number of tokens of a block (the frequency tables are built for each block). */
+#define ANS_CODEC_BLOCK_SIZE 32768
+
+
+/* prototypes */
+codec_t *ans_codec_create( codec_out_cb_t cb,
+                           void *cb_ctx,
+                           size_t min_match_len,
+                           size_t max_match_len,
+                           size_t max_pos );
+codec_t *ans_codec_create_sink( sink_t *sink,
+                                size_t min_match_len,
+                                size_t max_match_len,
+                                size_t max_pos );
+
+
+#endif
@@ -5,15 +5,24 @@
 /** ASCII codec's internal structure. */
 typedef struct
 {
-  /** Callback that handles the outputted data. */
-  codec_out_cb_t out_cb;
+  /** Where the encoded data is written (\c NULL if the codec is only used to decode). */
+  sink_t *sink;
 
-  /** Parameter passed to the output callback. */
-  void *out_cb_ctx;
+  /** Sink owned by the codec (when created with a callback). */
+  sink_t own_sink;
 
   /** Indicates whether some data has been encoded yet (used for the separators). */
   bool has_encoded_data;
 
+  /** Token being decoded (null terminated). */
+  char token[32];
+
+  /** Number of characters in \c token. */
+  size_t token_len;
+
+  /** Whether the end of the encoded data was reached. */
+  bool input_done;
+
 } ascii_codec_t;
 
 
@@ -27,19 +36,15 @@ static bool _write_literal( codec_t *codec, unsigned char c )
 {
   ascii_codec_t *ic = codec->_int_data;
 
-  char output[32];
-  if( snprintf( output, sizeof( output ), "0%c", c ) >= sizeof( output ) )
-    return false;
+  /* the character is written as is (it can be a null character) */
+  const char output[] = { ' ', '0', c };
 
   /* checks if the separator should be added */
-  if( ic->has_encoded_data )
-    if( !ic->out_cb( " ", 1, ic->out_cb_ctx ) )
-      return false;
-
+  size_t skip = ic->has_encoded_data ? 0 : 1;
   ic->has_encoded_data = true;
 
-  /* sends the encoded data to the through the output callback */
-  return ic->out_cb( output, strlen( output ), ic->out_cb_ctx );
+  /* sends the encoded data to the sink */
+  return sink_write( ic->sink, output + skip, sizeof( output ) - skip );
 }
 
 
@@ -53,34 +58,119 @@ static bool _write_match( codec_t *codec, match_t m )
 {
   ascii_codec_t *ic = codec->_int_data;
 
-  char output[32];
+  char output[64];
 
-  /* writes a pair (position, length) */
-  if( snprintf( output, sizeof( output ), "1(%zu,%zu)", m.pos, m.len ) >= sizeof( output ) )
+  /* writes a pair (position, length), preceded by the separator if needed */
+  int len = snprintf( output,
+                      sizeof( output ),
+                      ic->has_encoded_data ? " 1(%zu,%zu)" : "1(%zu,%zu)",
+                      m.pos,
+                      m.len );
+  if( len < 0 || len >= sizeof( output ) )
     return false;
 
-  /* checks if the separator should be added */
-  if( ic->has_encoded_data )
-    if( !ic->out_cb( " ", 1, ic->out_cb_ctx ) )
-      return false;
-
   ic->has_encoded_data = true;
 
-  /* sends the encoded data to the through the output callback */
-  return ic->out_cb( output, strlen( output ), ic->out_cb_ctx );
+  /* sends the encoded data to the sink */
+  return sink_write( ic->sink, output, len );
 }
 
 
 /**
- * Decodes and reads a character.
+ * Returns the size of an encoded literal (including the separator).
  * @param  codec The codec instance.
- * @param  c     The output character.
- * @return       \c true on success, \c false otherwise.
+ * @param  c     Character to encode.
+ * @return       Number of bits.
  */
-static bool _read( codec_t *codec, unsigned char *c )
+static size_t _price_literal( const codec_t *codec, unsigned char c )
 {
-  /* TODO: implement */
-  return false;
+  /* the '0' prefix, the character and the separator */
+  return 3 * 8;
+}
+
+
+/**
+ * Returns the size of an encoded match (including the separator).
+ * @param  codec The codec instance.
+ * @param  m     Match to encode.
+ * @param  pos   Stream offset of the match.
+ * @return       Number of bits.
+ */
+static size_t _price_match( const codec_t *codec, match_t m, uint64_t pos )
+{
+  /* "1(pos,len)" and the separator */
+  int len = snprintf( NULL, 0, "1(%zu,%zu) ", m.pos, m.len );
+
+  return ( len > 0 ? len : 0 ) * 8;
+}
+
+
+/**
+ * Decodes the next token.
+ * @param  codec The codec instance.
+ * @param  in    Encoded data.
+ * @param  c     The literal read.
+ * @param  m     The match read.
+ * @return       The kind of token read, or why none could be read.
+ */
+static codec_token_t _read( codec_t *codec, codec_input_t *in, byte *c, match_t *m )
+{
+  ascii_codec_t *ic = codec->_int_data;
+
+  while( !ic->input_done && in->pos < in->size )
+  {
+    char ch = in->data[in->pos++];
+
+    if( ic->token_len == 0 )
+    {
+      /* skips the separators, the new line marks the end */
+      if( ch == ' ' )
+        continue;
+
+      if( ch == '\n' )
+      {
+        ic->input_done = true;
+        break;
+      }
+
+      if( ch != '0' && ch != '1' )
+        return codec_token_error;
+    }
+
+    ic->token[ic->token_len++] = ch;
+    ic->token[ic->token_len] = '\0';
+
+    /* a literal is the '0' prefix and the character */
+    if( ic->token[0] == '0' && ic->token_len == 2 )
+    {
+      ic->token_len = 0;
+      *c = ch;
+      return codec_token_literal;
+    }
+
+    /* a match is a pair "1(pos,length)" */
+    if( ic->token[0] == '1' && ch == ')' )
+    {
+      int len = 0;
+      ic->token_len = 0;
+      if( sscanf( ic->token, "1(%zu,%zu)%n", &m->pos, &m->len, &len ) != 2 || ic->token[len] != '\0' )
+        return codec_token_error;
+
+      return codec_token_match;
+    }
+
+    if( ic->token_len + 1 >= sizeof( ic->token ) )
+      return codec_token_error;
+  }
+
+  if( ic->input_done )
+  {
+    /* ignores the terminating null character */
+    in->pos = in->size;
+    return codec_token_end;
+  }
+
+  return in->last ? codec_token_error : codec_token_need_input;
 }
 
 
@@ -96,7 +186,7 @@ static bool _close( codec_t *codec )
   const char output[] = "\n";
 
   /* encodes the new line + terminating null character */
-  return ic->out_cb( output, sizeof( output ), ic->out_cb_ctx );
+  return sink_write( ic->sink, output, sizeof( output ) ) && sink_flush( ic->sink );
 }
 
 
@@ -106,13 +196,42 @@ static bool _close( codec_t *codec )
  */
 static void _destroy( codec_t *codec )
 {
+  ascii_codec_t *ic = codec->_int_data;
+
+  if( ic->sink == &ic->own_sink )
+    sink_release( ic->sink );
+
   free( codec );
 }
 
 
+/**
+ * Creates a new ASCII codec writing into a sink.
+ * @param  sink          Sink where the encoded data is written (\c NULL if only used to decode).
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *ascii_codec_create_sink( sink_t *sink,
+                                  size_t min_match_len,
+                                  size_t max_match_len,
+                                  size_t max_pos )
+{
+  /* initializes the codec and returns it */
+  NEW_CODEC( ascii_codec_t );
+
+  ic->sink = sink;
+
+  return codec;
+}
+
+
 /**
  * Creates a new ASCII codec.
- * @param  cb            Callback used to output data.
+ * The encoded data is output through \a cb in chunks of \c ASCII_CODEC_BUFFER_SIZE bytes, and
+ * when the codec is closed.
+ * @param  cb            Callback used to output data (\c NULL if only used to decode).
  * @param  cb_ctx        Context passed to \a cb.
  * @param  min_match_len Minimum match length.
  * @param  max_match_len Maximum match length.
@@ -125,11 +244,18 @@ codec_t *ascii_codec_create( codec_out_cb_t cb,
                              size_t max_match_len,
                              size_t max_pos )
 {
-  /* initializes the codec and returns it */
-  NEW_CODEC( ascii_codec_t );
+  codec_t *codec = ascii_codec_create_sink( NULL, min_match_len, max_match_len, max_pos );
+  if( codec == NULL || cb == NULL )
+    return codec;
+
+  ascii_codec_t *ic = codec->_int_data;
+  if( !sink_init_callback( &ic->own_sink, cb, cb_ctx, ASCII_CODEC_BUFFER_SIZE ) )
+  {
+    codec->destroy( codec );
+    return NULL;
+  }
 
-  ic->out_cb = cb;
-  ic->out_cb_ctx = cb_ctx;
+  ic->sink = &ic->own_sink;
 
   return codec;
 }
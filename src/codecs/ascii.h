@@ -6,7 +6,17 @@
 #include "codec.h"
 
 
+/* constants */
+
+/** Size of the output buffer of the ASCII codec. */
+#define ASCII_CODEC_BUFFER_SIZE 65536
+
+
 /* prototypes */
+codec_t *ascii_codec_create_sink( sink_t *sink,
+                                  size_t min_match_len,
+                                  size_t max_match_len,
+                                  size_t max_pos );
 codec_t *ascii_codec_create( codec_out_cb_t cb,
                              void *cb_ctx,
                              size_t min_match_len,
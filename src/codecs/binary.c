@@ -1,5 +1,8 @@
 /* include area */
 #include "binary.h"
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "bucket.h"
 #include "../math2.h"
 #include "stdio.h"
 
@@ -7,31 +10,26 @@
 /** Constants */
 #define BITS_IN_BYTE 8U
 
-/** Number of bits in the output buffer of the binary codec. */
-#define BITS_IN_BC_BUFFER BITS_IN_BYTE
-
-
-/** Macros */
-
-/** Appends the \a num_bits least significant bits of \a c to the output buffer in the binary codec
- *  \a bc. If the output buffer gets full, the content is flushed. */
-#define APPEND_BITS( bc, c, num_bits )\
-  do {\
-    size_t bytes_free = ( BITS_IN_BC_BUFFER - bc->bits_stored );\
-    if( bytes_free > ( num_bits ) )\
-    {\
-      ( bc )->output |= ( ( c ) << ( bytes_free - ( num_bits ) ) );\
-      ( bc )->bits_stored += ( num_bits );\
-    }\
-    else\
-    {\
-      unsigned char output = ( bc )->output | ( ( c ) >> ( ( num_bits ) - bytes_free ) );\
-      if( !( bc )->out_cb( &output, sizeof( output ), ( bc )->out_cb_ctx ) )\
-        return false;\
-      ( bc )->output = ( c ) << ( BITS_IN_BC_BUFFER - ( ( num_bits ) - bytes_free ) );\
-      ( bc )->bits_stored = ( num_bits ) - bytes_free;\
-    }\
-  } while( 0 )
+/** Maximum number of bits of an encoded token (so a token can be decoded after any refill, and
+ *  encoded between flushes). */
+#define MAX_TOKEN_BITS BIT_READER_REFILL_BITS
+
+/** Number of bits of the index of a repeated position. */
+#define REP_BITS 2U
+
+/** Maximum number of bits of the length of a match. Its largest value is an escape, followed by
+ *  the bucket code of the rest of the length and its extra bits. */
+#define MAX_LENGTH_BITS 5U
+
+/** Number of bits of an encoded literal (the literal flag and the byte). */
+#define LITERAL_BITS ( 1U + BITS_IN_BYTE )
+
+/** Kinds of tokens, by their first two bits (a literal only takes the first bit).
+ *  A match is followed by the bucket code of its position (wide enough for the farthest position
+ *  seen so far), the extra bits of the bucket and the length. */
+#define LITERAL_TOKEN 0U
+#define MATCH_TOKEN 2U
+#define REP_TOKEN 3U
 
 
 /** Data types */
@@ -39,30 +37,119 @@
 /** Binary codec internal data. */
 typedef struct
 {
-  /** Holds the (partial) output of the codec. */
-  unsigned int output;
-
-  /** Number of bits (most significant) already set in output from previous writes. */
-  size_t bits_stored;
+  /** Bits encoded but not stored in \c buffer yet. */
+  bit_writer_t writer;
 
-  /** Callback to output encoded data. */
-  codec_out_cb_t out_cb;
+  /** Where the encoded data is written (\c NULL if the codec is only used to decode). */
+  sink_t *sink;
 
-  /** Context passed to the output callback. */
-  void *out_cb_ctx;
+  /** Sink owned by the codec (when created with a callback). */
+  sink_t own_sink;
 
   /** Minimum match length. */
   size_t min_match_len;
 
-  /** Number of bits required to represent an encoded match. */
+  /** Number of bits of the length of a match. */
   size_t num_bits_match;
 
+  /** Length (minus the minimum) written as an escape, followed by the rest of the length. */
+  size_t escape_len;
+
+  /** Number of bits of the bucket code of the rest of an escaped length. */
+  size_t num_bits_long_code;
+
+  /** Bucket code of the rest of the longest escaped length. */
+  size_t max_long_code;
+
   /** Maximum match position. */
-  size_t num_bits_pos;
+  size_t max_pos;
+
+  /** Number of bytes encoded (or decoded) so far, up to \c max_pos (no match reaches farther). */
+  size_t seen;
+
+  /** Bucket code of the farthest position a match can take. */
+  size_t max_code;
+
+  /** Number of bits of the bucket code of a position. */
+  size_t num_bits_code;
+
+  /** Positions of the last matches (see \c codec_reps_update). */
+  size_t reps[CODEC_NUM_REPS];
+
+  /** Bits read but not decoded yet. */
+  bit_reader_t reader;
+
+  /** Last byte read, held back until it's known whether it's the one with the padding. */
+  byte held;
+
+  /** Whether \c held contains a byte. */
+  bool has_held;
+
+  /** Whether the padding was reached (\c reader has the last bits of the stream). */
+  bool input_done;
 
 } binary_codec_t;
 
 
+/**
+ * Stores the bytes completed one at a time (near the end of a caller's buffer, where a whole word
+ * doesn't fit).
+ * @param  bc The binary codec.
+ * @return    \c true on success, \c false otherwise.
+ */
+static bool _put_bytes( binary_codec_t *bc )
+{
+  while( bc->writer.count >= BITS_IN_BYTE )
+  {
+    byte b = bit_writer_take_byte( &bc->writer );
+    if( !sink_write( bc->sink, &b, sizeof( b ) ) )
+      return false;
+  }
+
+  return true;
+}
+
+
+/**
+ * Encodes a whole token and stores the bytes completed in the sink.
+ * @param  bc       The binary codec.
+ * @param  token    Bits of the token (the least significant \a num_bits).
+ * @param  num_bits Number of bits (up to \c MAX_TOKEN_BITS).
+ * @return          \c true on success, \c false otherwise.
+ */
+static inline bool _put( binary_codec_t *bc, uint64_t token, size_t num_bits )
+{
+  bit_writer_put( &bc->writer, token, num_bits );
+
+  /* the whole accumulator is stored, so there must be room for a word */
+  byte *out = sink_reserve( bc->sink, sizeof( uint64_t ) );
+  if( out == NULL )
+    return bc->sink->cb == NULL && _put_bytes( bc );
+
+  byte *end = out;
+  bit_writer_flush( &bc->writer, &end );
+  sink_commit( bc->sink, end - out );
+
+  return true;
+}
+
+
+/**
+ * Accounts for bytes encoded (or decoded), widening the bucket codes of the positions with them.
+ * @param bc  The binary codec.
+ * @param len Number of bytes.
+ */
+static inline void _advance( binary_codec_t *bc, size_t len )
+{
+  if( bc->seen == bc->max_pos )
+    return;
+
+  bc->seen = MIN( bc->seen + len, bc->max_pos );
+  bc->max_code = bucket_code( bc->seen - 1 );
+  bc->num_bits_code = bucket_code_bits( bc->max_code );
+}
+
+
 /**
  * Writes an encoded literal.
  * @param  codec The codec instance.
@@ -73,12 +160,97 @@ static bool _write_literal( codec_t *codec, unsigned char c )
 {
   binary_codec_t *bc = codec->_int_data;
 
+  _advance( bc, 1 );
+
   /* a literal is made of a zero bit and the byte literal */
-  APPEND_BITS( bc, 0x00, 1 );
-  APPEND_BITS( bc, c, BITS_IN_BYTE );
+  return _put( bc, c, LITERAL_BITS );
+}
 
-  /* success */
-  return true;
+
+/**
+ * Appends a field to a token.
+ * @param token    Bits of the token (the least significant \a num_bits).
+ * @param num_bits Number of bits of the token (updated).
+ * @param field    Bits of the field.
+ * @param len      Number of bits of the field.
+ */
+static inline void _append( uint64_t *token, size_t *num_bits, uint64_t field, size_t len )
+{
+  *token = ( *token << len ) | field;
+  *num_bits += len;
+}
+
+
+/**
+ * Appends the length of a match to a token (escaped if it doesn't fit in its bits).
+ * @param bc       The binary codec.
+ * @param token    Bits of the token (the least significant \a num_bits).
+ * @param num_bits Number of bits of the token (updated).
+ * @param len      Match length.
+ */
+static inline void _append_length( const binary_codec_t *bc,
+                                   uint64_t *token,
+                                   size_t *num_bits,
+                                   size_t len )
+{
+  len -= bc->min_match_len;
+
+  if( len < bc->escape_len )
+  {
+    _append( token, num_bits, len, bc->num_bits_match );
+    return;
+  }
+
+  len -= bc->escape_len;
+  size_t code = bucket_code( len );
+
+  _append( token, num_bits, bc->escape_len, bc->num_bits_match );
+  _append( token, num_bits, code, bc->num_bits_long_code );
+  _append( token, num_bits, len - bucket_base( code ), bucket_extra_bits( code ) );
+}
+
+
+/**
+ * Encodes a match, as a repeat token if its position is one of the last ones.
+ * @param  bc The binary codec.
+ * @param  m  The match to encode.
+ * @return    \c true on success, \c false otherwise.
+ */
+static inline bool _put_match( binary_codec_t *bc, match_t m )
+{
+  /* the position can't reach farther than the bytes already encoded */
+  if( m.pos >= bc->seen )
+    return false;
+
+  size_t rep = codec_reps_update( bc->reps, m.pos );
+  size_t code = bucket_code( m.pos );
+  size_t num_bits_extra = bucket_extra_bits( code );
+
+  uint64_t token = 0;
+  size_t num_bits = 0;
+
+  /* the token kind and the index of the position (unless the position itself is shorter, like
+   * the closest ones at the beginning of the stream) */
+  if( rep < CODEC_NUM_REPS && REP_BITS <= bc->num_bits_code + num_bits_extra )
+  {
+    _append( &token, &num_bits, REP_TOKEN, 2 );
+    _append( &token, &num_bits, rep, REP_BITS );
+  }
+  else
+  {
+    /* the token kind, the bucket code of the position and its extra bits */
+    _append( &token, &num_bits, MATCH_TOKEN, 2 );
+    _append( &token, &num_bits, code, bc->num_bits_code );
+    _append( &token, &num_bits, m.pos - bucket_base( code ), num_bits_extra );
+  }
+
+  _append_length( bc, &token, &num_bits, m.len );
+  bool ok = _put( bc, token, num_bits );
+
+  /* the decoder widens the codes once it has the whole match too */
+  _advance( bc, m.len );
+
+  return ok;
 }
 
 
@@ -92,29 +264,324 @@ static bool _write_match( codec_t *codec, match_t m )
 {
   binary_codec_t *bc = codec->_int_data;
 
-  /* sets the bit indicating the match */
-  APPEND_BITS( bc, 0x01, 1 );
+  return _put_match( bc, m );
+}
+
 
-  /* encodes the position */
-  APPEND_BITS( bc, m.pos, bc->num_bits_pos );
+/**
+ * Writes all the sequences of a store.
+ * @param  codec The codec instance.
+ * @param  s     Sequences to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_sequences( codec_t *codec, const sequence_store_t *s )
+{
+  binary_codec_t *bc = codec->_int_data;
+  const byte *literals = s->literals;
+
+  for( size_t i = 0; i < s->num_sequences; i++ )
+  {
+    const sequence_t *seq = &s->sequences[i];
 
-  /* encodes the match length */
-  APPEND_BITS( bc, m.len - bc->min_match_len, bc->num_bits_match );
+    for( size_t j = 0; j < seq->literals_len; j++ )
+      if( !_put( bc, *literals++, LITERAL_BITS ) )
+        return false;
+
+    _advance( bc, seq->literals_len );
+
+    if( seq->match.len > 0 && !_put_match( bc, seq->match ) )
+      return false;
+  }
 
-  /* success */
   return true;
 }
 
 
 /**
- * Decodes and reads a character.
+ * Returns the size of an encoded literal.
  * @param  codec The codec instance.
- * @param  c     The output character.
- * @return       \c true on success, \c false otherwise.
+ * @param  c     Character to encode.
+ * @return       Number of bits.
  */
-static bool _read( codec_t *codec, unsigned char *c )
+static size_t _price_literal( const codec_t *codec, unsigned char c )
 {
-  return false;
+  /* the literal flag and the byte */
+  return LITERAL_BITS;
+}
+
+
+/**
+ * Returns the number of bits of the length of a match.
+ * @param  bc  The binary codec.
+ * @param  len Match length.
+ * @return     Number of bits.
+ */
+static inline size_t _length_bits( const binary_codec_t *bc, size_t len )
+{
+  len -= bc->min_match_len;
+  if( len < bc->escape_len )
+    return bc->num_bits_match;
+
+  return bc->num_bits_match + bc->num_bits_long_code +
+         bucket_extra_bits( bucket_code( len - bc->escape_len ) );
+}
+
+
+/**
+ * Returns the size of an encoded match.
+ * @param  codec The codec instance.
+ * @param  m     Match to encode.
+ * @param  pos   Stream offset of the match.
+ * @return       Number of bits.
+ */
+static size_t _price_match( const codec_t *codec, match_t m, uint64_t pos )
+{
+  const binary_codec_t *bc = codec->_int_data;
+  size_t code = bucket_code( m.pos );
+
+  /* the parser holds tokens back, so the bytes seen when the match is written are known from its
+   * offset rather than from the ones written so far (and the match can't reach farther) */
+  size_t seen = MIN( MAX( pos, m.pos + 1 ), bc->max_pos );
+
+  /* the token kind, the bucket code of the position (as wide as the farthest one seen), its extra
+   * bits and the length */
+  return 2 + bucket_code_bits( bucket_code( seen - 1 ) ) + bucket_extra_bits( code ) +
+         _length_bits( bc, m.len );
+}
+
+
+/**
+ * Returns the size of an encoded match repeating a recent position.
+ * @param  codec The codec instance.
+ * @param  rep   Index of the position in the last ones.
+ * @param  len   Match length.
+ * @return       Number of bits.
+ */
+static size_t _price_rep( const codec_t *codec, size_t rep, size_t len )
+{
+  const binary_codec_t *bc = codec->_int_data;
+
+  /* the token kind, the index of the position and the length (a closer position could take less,
+   * in which case the match is encoded as such) */
+  return 2 + REP_BITS + _length_bits( bc, len );
+}
+
+
+/**
+ * Reads input bytes one at a time until there are \a num_bits available.
+ * The last byte of the stream has the padding (a one bit followed by zeros), so the last byte read
+ * is held back until there's more input or the input is known to be over.
+ * @param  bc       The binary codec.
+ * @param  in       Encoded data.
+ * @param  num_bits Number of bits required (up to \c MAX_TOKEN_BITS).
+ * @return          \c true if the bits are available, \c false otherwise.
+ */
+static bool _fill( binary_codec_t *bc, codec_input_t *in, size_t num_bits )
+{
+  bit_reader_t *br = &bc->reader;
+
+  while( br->count < num_bits && !bc->input_done )
+  {
+    if( in->pos < in->size )
+    {
+      if( bc->has_held )
+        bit_reader_push( br, bc->held, BITS_IN_BYTE );
+
+      bc->held = in->data[in->pos++];
+      bc->has_held = true;
+    }
+    else if( in->last && bc->has_held && bc->held != 0 )
+    {
+      /* drops the padding, keeping the bits before the last one set */
+      bit_reader_push( br, bc->held, BITS_IN_BYTE - 1 - __builtin_ctz( bc->held ) );
+      bc->has_held = false;
+      bc->input_done = true;
+    }
+    else
+      return false;
+  }
+
+  return br->count >= num_bits;
+}
+
+
+/**
+ * Returns the number of bits of the next token, as far as the bits available tell.
+ * The size of a token is known in steps: its kind, then the bucket code of its position, and then
+ * whether its length is escaped and the bucket code of the rest.
+ * @param  bc        The binary codec.
+ * @param  available Number of bits available.
+ * @return           Number of bits of the token, or the number of bits required to tell more
+ *                   about it if there are not enough (greater than \a available). Zero if a bucket
+ *                   code is not valid.
+ */
+static inline size_t _token_bits( const binary_codec_t *bc, size_t available )
+{
+  const bit_reader_t *br = &bc->reader;
+
+  size_t kind = bit_reader_peek( br, 2 );
+  if( kind < MATCH_TOKEN )
+    return LITERAL_BITS;
+
+  size_t num_bits = 2 + REP_BITS;
+  if( kind == MATCH_TOKEN )
+  {
+    num_bits = 2 + bc->num_bits_code;
+    if( available < num_bits )
+      return num_bits;
+
+    size_t code = bit_reader_peek( br, num_bits ) & ( ( ( size_t )1 << bc->num_bits_code ) - 1 );
+    if( code > bc->max_code )
+      return 0;
+
+    num_bits += bucket_extra_bits( code );
+  }
+
+  num_bits += bc->num_bits_match;
+  if( available < num_bits )
+    return num_bits;
+
+  size_t len = bit_reader_peek( br, num_bits ) & ( ( ( size_t )1 << bc->num_bits_match ) - 1 );
+  if( len < bc->escape_len )
+    return num_bits;
+
+  num_bits += bc->num_bits_long_code;
+  if( available < num_bits )
+    return num_bits;
+
+  size_t code = bit_reader_peek( br, num_bits ) & ( ( ( size_t )1 << bc->num_bits_long_code ) - 1 );
+  if( code > bc->max_long_code )
+    return 0;
+
+  return num_bits + bucket_extra_bits( code );
+}
+
+
+/**
+ * Takes the next field of a token.
+ * @param  token Bits of the token.
+ * @param  left  Number of bits of the token not taken yet (updated).
+ * @param  len   Number of bits of the field.
+ * @return       Bits of the field.
+ */
+static inline size_t _field( uint64_t token, size_t *left, size_t len )
+{
+  *left -= len;
+  return ( token >> *left ) & ( ( ( uint64_t )1 << len ) - 1 );
+}
+
+
+/**
+ * Decodes a token (all its bits must be available).
+ * Both outputs are set, only the one matching the token type returned is meaningful.
+ * @param  bc       The binary codec.
+ * @param  num_bits Number of bits of the token (see \c _token_bits).
+ * @param  c        The literal read.
+ * @param  m        The match read.
+ * @return          The kind of token read.
+ */
+static inline codec_token_t _decode( binary_codec_t *bc, size_t num_bits, byte *c, match_t *m )
+{
+  bit_reader_t *br = &bc->reader;
+
+  uint64_t token = bit_reader_peek( br, num_bits );
+  bit_reader_consume( br, num_bits );
+
+  *c = ( byte )token;
+
+  size_t left = num_bits;
+  size_t kind = _field( token, &left, 2 );
+  if( kind < MATCH_TOKEN )
+  {
+    _advance( bc, 1 );
+    return codec_token_literal;
+  }
+
+  if( kind == REP_TOKEN )
+    m->pos = bc->reps[_field( token, &left, REP_BITS )];
+  else
+  {
+    size_t code = _field( token, &left, bc->num_bits_code );
+    m->pos = bucket_base( code ) + _field( token, &left, bucket_extra_bits( code ) );
+  }
+
+  size_t len = _field( token, &left, bc->num_bits_match );
+  if( len == bc->escape_len )
+  {
+    size_t code = _field( token, &left, bc->num_bits_long_code );
+    len += bucket_base( code ) + _field( token, &left, bucket_extra_bits( code ) );
+  }
+
+  m->len = len + bc->min_match_len;
+
+  codec_reps_update( bc->reps, m->pos );
+  _advance( bc, m->len );
+
+  return codec_token_match;
+}
+
+
+/**
+ * Decodes the next token.
+ * @param  codec The codec instance.
+ * @param  in    Encoded data.
+ * @param  c     The literal read.
+ * @param  m     The match read.
+ * @return       The kind of token read, or why none could be read.
+ */
+static codec_token_t _read( codec_t *codec, codec_input_t *in, byte *c, match_t *m )
+{
+  binary_codec_t *bc = codec->_int_data;
+  bit_reader_t *br = &bc->reader;
+
+  /* with 8 bytes left a refill never takes the last one, so it can't reach the padding */
+  if( in->size - in->pos >= sizeof( uint64_t ) && br->count < BIT_READER_REFILL_BITS )
+  {
+    if( bc->has_held )
+    {
+      bit_reader_push( br, bc->held, BITS_IN_BYTE );
+      bc->has_held = false;
+    }
+
+    const byte *data = in->data + in->pos;
+    bit_reader_refill( br, &data );
+    in->pos = data - in->data;
+
+    /* a whole token fits in a refill */
+    size_t num_bits = _token_bits( bc, br->count );
+    if( num_bits == 0 )
+      return codec_token_error;
+
+    return _decode( bc, num_bits, c, m );
+  }
+
+  /* near the end of the input, the bytes are read one at a time */
+  if( !_fill( bc, in, 1 ) )
+  {
+    if( bc->input_done )
+      return ( br->count == 0 ) ? codec_token_end : codec_token_error;
+
+    /* the stream can't end without the padding */
+    return in->last ? codec_token_error : codec_token_need_input;
+  }
+
+  /* the kind of token takes up to two bits, and then the bits read tell how many more it takes */
+  size_t available = 2;
+  size_t num_bits;
+
+  while( _fill( bc, in, available ) )
+  {
+    num_bits = _token_bits( bc, available );
+    if( num_bits == 0 )
+      return codec_token_error;
+
+    if( num_bits <= available )
+      return _decode( bc, num_bits, c, m );
+
+    available = num_bits;
+  }
+
+  return ( bc->input_done || in->last ) ? codec_token_error : codec_token_need_input;
 }
 
 
@@ -127,20 +594,19 @@ static bool _close( codec_t *codec )
 {
   binary_codec_t *bc = codec->_int_data;
 
-  unsigned char output;
+  /* the padding is a one bit followed by zeros up to the end of the byte (a full byte if the
+   * last one was already complete) */
+  if( !_put( bc, 1, 1 ) )
+    return false;
 
-  if( bc->bits_stored > 0 )
+  if( bc->writer.count > 0 )
   {
-    /* outputs the remaining bits and the padding */
-    output = bc->output | ( 1U << ( BITS_IN_BC_BUFFER - bc->bits_stored - 1 ) );
-  }
-  else
-  {
-    /* outputs a full byte of padding */
-    output = 0x80;
+    byte b = bit_writer_take_byte( &bc->writer );
+    if( !sink_write( bc->sink, &b, sizeof( b ) ) )
+      return false;
   }
 
-  return bc->out_cb( &output, sizeof( output ), bc->out_cb_ctx );
+  return sink_flush( bc->sink );
 }
 
 
@@ -150,25 +616,64 @@ static bool _close( codec_t *codec )
  */
 static void _destroy( codec_t *codec )
 {
+  binary_codec_t *bc = codec->_int_data;
+
+  if( bc->sink == &bc->own_sink )
+    sink_release( bc->sink );
+
   /* frees the allocated memory */
   free( codec );
 }
 
 
 /**
- * Creates a new binary codec.
- * @param  cb            Callback used to output data.
- * @param  cb_ctx        Context passed to \a cb.
+ * Sets how the lengths of the matches are encoded.
+ * @param bc            The binary codec.
+ * @param min_match_len Minimum match length.
+ * @param max_match_len Maximum match length.
+ */
+static void _init_lengths( binary_codec_t *bc, size_t min_match_len, size_t max_match_len )
+{
+  size_t max_len = max_match_len - min_match_len;
+
+  /* the longest lengths are escaped, unless they all fit below the escape */
+  bc->min_match_len = min_match_len;
+  bc->num_bits_match = MIN( math_bits_in_n( max_len + 1 ), MAX_LENGTH_BITS );
+  bc->escape_len = ( ( size_t )1 << bc->num_bits_match ) - 1;
+  bc->max_long_code = ( max_len >= bc->escape_len ) ? bucket_code( max_len - bc->escape_len ) : 0;
+  bc->num_bits_long_code = bucket_code_bits( bc->max_long_code );
+}
+
+
+/**
+ * Returns the number of bits of the longest match token (the farthest position once the window is
+ * full, and the longest length).
+ * @param  bc            The binary codec (with the lengths set).
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Number of bits.
+ */
+static size_t _max_match_bits( const binary_codec_t *bc, size_t max_match_len, size_t max_pos )
+{
+  size_t max_code = bucket_code( max_pos - 1 );
+  size_t pos_bits = MAX( bucket_code_bits( max_code ) + bucket_extra_bits( max_code ), REP_BITS );
+
+  return 2 + pos_bits + _length_bits( bc, max_match_len );
+}
+
+
+/**
+ * Creates a new binary codec writing into a sink.
+ * @param  sink          Sink where the encoded data is written (\c NULL if only used to decode).
  * @param  min_match_len Minimum match length.
  * @param  max_match_len Maximum match length.
  * @param  max_pos       Maximum match position.
  * @return               Codec or \c NULL on error.
  */
-codec_t *binary_codec_create( codec_out_cb_t cb,
-                              void *cb_ctx,
-                              size_t min_match_len,
-                              size_t max_match_len,
-                              size_t max_pos )
+codec_t *binary_codec_create_sink( sink_t *sink,
+                                   size_t min_match_len,
+                                   size_t max_match_len,
+                                   size_t max_pos )
 {
   /* input checks */
   if( max_match_len < 2 || min_match_len < 2 )
@@ -179,15 +684,126 @@ codec_t *binary_codec_create( codec_out_cb_t cb,
     return NULL;
 
   NEW_CODEC( binary_codec_t );
+  codec->write_sequences = _write_sequences;
+  codec->price_rep = _price_rep;
 
-  /* initializes the internal binary codec */
-  ic->out_cb = cb;
-  ic->out_cb_ctx = cb_ctx;
-  ic->min_match_len = min_match_len;
+  /* initializes the internal binary codec (the positions grow with the bytes encoded, from
+   * none) */
+  ic->sink = sink;
+  ic->max_pos = max_pos;
+  _init_lengths( ic, min_match_len, max_match_len );
 
-  /* calculates the number of bits required to encode the match length */
-  ic->num_bits_match = math_bits_in_n( ( max_match_len - min_match_len ) + 1 );
-  ic->num_bits_pos = math_bits_in_n( max_pos - 1 );
+  bit_reader_init( &ic->reader );
+  bit_writer_init( &ic->writer );
+
+  /* the decoder buffers whole tokens */
+  if( _max_match_bits( ic, max_match_len, max_pos ) > MAX_TOKEN_BITS )
+  {
+    free( buf );
+    return NULL;
+  }
 
   return codec;
 }
+
+
+/**
+ * Creates a new binary codec.
+ * The encoded data is output through \a cb in chunks of \c BINARY_CODEC_BUFFER_SIZE bytes, and
+ * when the codec is closed.
+ * @param  cb            Callback used to output data (\c NULL if only used to decode).
+ * @param  cb_ctx        Context passed to \a cb.
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *binary_codec_create( codec_out_cb_t cb,
+                              void *cb_ctx,
+                              size_t min_match_len,
+                              size_t max_match_len,
+                              size_t max_pos )
+{
+  return binary_codec_create_buffered( cb,
+                                       cb_ctx,
+                                       min_match_len,
+                                       max_match_len,
+                                       max_pos,
+                                       BINARY_CODEC_BUFFER_SIZE );
+}
+
+
+/**
+ * Creates a new binary codec with a given output buffer size.
+ * @param  cb            Callback used to output data (\c NULL if only used to decode).
+ * @param  cb_ctx        Context passed to \a cb.
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @param  buffer_size   Size of the output buffer (the callback is called when it gets full, at
+ *                       least 8 bytes).
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *binary_codec_create_buffered( codec_out_cb_t cb,
+                                       void *cb_ctx,
+                                       size_t min_match_len,
+                                       size_t max_match_len,
+                                       size_t max_pos,
+                                       size_t buffer_size )
+{
+  if( buffer_size < sizeof( uint64_t ) )
+    return NULL;
+
+  codec_t *codec = binary_codec_create_sink( NULL, min_match_len, max_match_len, max_pos );
+  if( codec == NULL || cb == NULL )
+    return codec;
+
+  binary_codec_t *bc = codec->_int_data;
+  if( !sink_init_callback( &bc->own_sink, cb, cb_ctx, buffer_size ) )
+  {
+    codec->destroy( codec );
+    return NULL;
+  }
+
+  bc->sink = &bc->own_sink;
+
+  return codec;
+}
+
+
+/**
+ * Returns the maximum size of the data encoded by a binary codec.
+ * @param  input_len     Number of bytes encoded (as literals or matches).
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Maximum size (including the padding), or zero if the parameters are not
+ *                       valid.
+ */
+size_t binary_codec_bound( size_t input_len,
+                           size_t min_match_len,
+                           size_t max_match_len,
+                           size_t max_pos )
+{
+  if( max_match_len < 2 || min_match_len < 2 || min_match_len > max_match_len || max_pos < 2 )
+    return 0;
+
+  binary_codec_t bc;
+  _init_lengths( &bc, min_match_len, max_match_len );
+
+  /* a short match with a wide position can take more bits per byte than a literal */
+  size_t short_len = MIN( max_match_len, min_match_len + bc.escape_len - 1 );
+  size_t short_bits = _max_match_bits( &bc, short_len, max_pos );
+  size_t bits_per_byte = MAX( LITERAL_BITS, ( short_bits + min_match_len - 1 ) / min_match_len );
+
+  /* and so can an escaped length, spread over the shortest of them */
+  if( max_match_len > short_len )
+  {
+    size_t long_bits = _max_match_bits( &bc, max_match_len, max_pos );
+    bits_per_byte = MAX( bits_per_byte, ( long_bits + short_len ) / ( short_len + 1 ) );
+  }
+
+  /* the length is split in bytes and bits so the product doesn't overflow */
+  return ( input_len / BITS_IN_BYTE ) * bits_per_byte +
+         ( ( input_len % BITS_IN_BYTE ) * bits_per_byte + BITS_IN_BYTE - 1 ) / BITS_IN_BYTE + 1;
+}
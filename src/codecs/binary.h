@@ -6,12 +6,33 @@
 #include "codec.h"
 
 
+/* constants */
+
+/** Default size of the output buffer of the binary codec. */
+#define BINARY_CODEC_BUFFER_SIZE 65536
+
+
 /* prototypes */
 codec_t *binary_codec_create( codec_out_cb_t cb,
                               void *cb_ctx,
                               size_t min_match_len,
                               size_t max_match_len,
                               size_t max_pos );
+codec_t *binary_codec_create_sink( sink_t *sink,
+                                   size_t min_match_len,
+                                   size_t max_match_len,
+                                   size_t max_pos );
+codec_t *binary_codec_create_buffered( codec_out_cb_t cb,
+                                       void *cb_ctx,
+                                       size_t min_match_len,
+                                       size_t max_match_len,
+                                       size_t max_pos,
+                                       size_t buffer_size );
+
+size_t binary_codec_bound( size_t input_len,
+                           size_t min_match_len,
+                           size_t max_match_len,
+                           size_t max_pos );
 
 
 #endif
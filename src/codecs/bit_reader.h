@@ -0,0 +1,106 @@
+#ifndef BIT_READER_H
+#define BIT_READER_H
+
+
+/* include area */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../datatype.h"
+
+
+/** Bit reader for streams packed most significant bit first.
+ *  The bits are kept in a 64 bits accumulator aligned to its most significant bit, so peeking
+ *  any number of bits is a single shift. The bits past \c count may hold the beginning of the
+ *  next bytes (left by \c bit_reader_refill), which are the same bits later refills store. */
+typedef struct
+{
+  /** Bits not consumed yet (the next one is the most significant). */
+  uint64_t bits;
+
+  /** Number of valid bits in \c bits. */
+  size_t count;
+
+} bit_reader_t;
+
+
+/* constants */
+
+/** Number of bits available after \c bit_reader_refill (at least). */
+#define BIT_READER_REFILL_BITS 56U
+
+
+/* inline functions */
+
+/**
+ * Initializes an empty bit reader.
+ * @param br Bit reader.
+ */
+static inline void bit_reader_init( bit_reader_t *br )
+{
+  br->bits = 0;
+  br->count = 0;
+}
+
+
+/**
+ * Fills the accumulator with an unaligned 8 bytes load, leaving at least
+ * \c BIT_READER_REFILL_BITS bits available.
+ * @param br   Bit reader (with \c count under 64).
+ * @param data Next byte of the stream (8 bytes must be readable), advanced past the bytes taken
+ *             (up to 7, the last one is only peeked).
+ */
+static inline void bit_reader_refill( bit_reader_t *br, const byte **data )
+{
+  uint64_t word;
+  memcpy( &word, *data, sizeof( word ) );
+
+#if defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  word = __builtin_bswap64( word );
+#endif
+
+  br->bits |= word >> br->count;
+  *data += ( 63 - br->count ) >> 3;
+  br->count |= BIT_READER_REFILL_BITS;
+}
+
+
+/**
+ * Appends the most significant bits of a byte (used when there are not 8 bytes to refill).
+ * @param br       Bit reader (with \c count up to 56).
+ * @param b        Byte.
+ * @param num_bits Number of bits of \a b taken (up to 8).
+ */
+static inline void bit_reader_push( bit_reader_t *br, byte b, size_t num_bits )
+{
+  br->bits |= ( uint64_t )b << ( 56 - br->count );
+  br->count += num_bits;
+}
+
+
+/**
+ * Returns the next bits without consuming them.
+ * @param  br       Bit reader.
+ * @param  num_bits Number of bits (up to 63, and no more than \c count).
+ * @return          The bits, in the least significant positions.
+ */
+static inline uint64_t bit_reader_peek( const bit_reader_t *br, size_t num_bits )
+{
+  /* shifted twice so zero bits don't shift by 64 */
+  return ( br->bits >> 1 ) >> ( 63 - num_bits );
+}
+
+
+/**
+ * Consumes bits.
+ * @param br       Bit reader.
+ * @param num_bits Number of bits (up to 63, and no more than \c count).
+ */
+static inline void bit_reader_consume( bit_reader_t *br, size_t num_bits )
+{
+  br->bits <<= num_bits;
+  br->count -= num_bits;
+}
+
+
+#endif
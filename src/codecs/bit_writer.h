@@ -0,0 +1,98 @@
+#ifndef BIT_WRITER_H
+#define BIT_WRITER_H
+
+
+/* include area */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../datatype.h"
+
+
+/** Bit writer for streams packed most significant bit first (the counterpart of
+ *  \c bit_reader_t).
+ *  The bits are accumulated in 64 bits aligned to the most significant bit, and the whole word is
+ *  stored on each flush, advancing the output only by the bytes completed. */
+typedef struct
+{
+  /** Bits not flushed yet (the first one is the most significant). */
+  uint64_t bits;
+
+  /** Number of bits in \c bits. */
+  size_t count;
+
+} bit_writer_t;
+
+
+/* constants */
+
+/** Maximum number of bits that can be put between flushes. */
+#define BIT_WRITER_MAX_BITS 56U
+
+
+/* inline functions */
+
+/**
+ * Initializes an empty bit writer.
+ * @param bw Bit writer.
+ */
+static inline void bit_writer_init( bit_writer_t *bw )
+{
+  bw->bits = 0;
+  bw->count = 0;
+}
+
+
+/**
+ * Appends bits to the accumulator.
+ * @param bw       Bit writer.
+ * @param value    Bits to append (the least significant \a num_bits, the others must be zero).
+ * @param num_bits Number of bits (up to \c BIT_WRITER_MAX_BITS since the last flush).
+ */
+static inline void bit_writer_put( bit_writer_t *bw, uint64_t value, size_t num_bits )
+{
+  bw->bits |= value << ( 64 - bw->count - num_bits );
+  bw->count += num_bits;
+}
+
+
+/**
+ * Stores the accumulator as a whole word, advancing the output past the bytes completed (the
+ * bits of the last byte, if incomplete, are kept).
+ * @param bw  Bit writer.
+ * @param out Output (8 bytes must be writable), advanced past the bytes completed (up to 7).
+ */
+static inline void bit_writer_flush( bit_writer_t *bw, byte **out )
+{
+  uint64_t word = bw->bits;
+
+#if defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  word = __builtin_bswap64( word );
+#endif
+
+  memcpy( *out, &word, sizeof( word ) );
+
+  size_t num_bytes = bw->count >> 3;
+  *out += num_bytes;
+  bw->bits <<= num_bytes << 3;
+  bw->count &= 7;
+}
+
+
+/**
+ * Takes the first byte of the accumulator (where a whole word can't be stored).
+ * @param  bw Bit writer.
+ * @return    The byte (padded with zeros if there were less than 8 bits).
+ */
+static inline byte bit_writer_take_byte( bit_writer_t *bw )
+{
+  byte b = bw->bits >> 56;
+
+  bw->bits <<= 8;
+  bw->count = ( bw->count > 8 ) ? bw->count - 8 : 0;
+
+  return b;
+}
+
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef BUCKET_H
+#define BUCKET_H
+
+
+/* include area */
+#include <stdlib.h>
+
+
+/** Values are encoded as a bucket code followed by extra bits, like the lengths and distances of
+ *  deflate: codes 0 to 3 are the values themselves, and each power of two from 4 on is split in
+ *  two codes, with the bits below the two most significant ones as extra bits. */
+
+
+/* constants */
+
+/** Maximum number of bucket codes (for values up to 32 bits). */
+#define BUCKET_MAX_CODES 64U
+
+
+/* inline functions */
+
+/**
+ * Returns the bucket code of a value.
+ * @param  value Value (up to 32 bits).
+ * @return       Bucket code.
+ */
+static inline size_t bucket_code( size_t value )
+{
+  if( value < 4 )
+    return value;
+
+  size_t msb = 8 * sizeof( unsigned long long ) - 1 - __builtin_clzll( value );
+  return 2 * msb + ( ( value >> ( msb - 1 ) ) & 1 );
+}
+
+
+/**
+ * Returns the number of extra bits of a bucket code.
+ * @param  code Bucket code.
+ * @return      Number of extra bits.
+ */
+static inline size_t bucket_extra_bits( size_t code )
+{
+  return ( code < 4 ) ? 0 : code / 2 - 1;
+}
+
+
+/**
+ * Returns the smallest value of a bucket code (the extra bits are added to it).
+ * @param  code Bucket code.
+ * @return      Smallest value.
+ */
+static inline size_t bucket_base( size_t code )
+{
+  return ( code < 4 ) ? code : ( size_t )( 2 | ( code & 1 ) ) << ( code / 2 - 1 );
+}
+
+
+/**
+ * Returns the number of bits required to write the bucket codes up to \a max_code.
+ * @param  max_code Largest bucket code.
+ * @return          Number of bits (zero if the only code is zero).
+ */
+static inline size_t bucket_code_bits( size_t max_code )
+{
+  return ( max_code == 0 ) ? 0 : 8 * sizeof( unsigned long long ) - __builtin_clzll( max_code );
+}
+
+
+#endif
@@ -0,0 +1,29 @@
+/* include area */
+#include "codec.h"
+
+
+/**
+ * Writes all the sequences of a store, one token at a time (the default implementation of
+ * \c write_sequences).
+ * @param  codec The codec instance.
+ * @param  s     Sequences to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+bool codec_write_sequences( codec_t *codec, const sequence_store_t *s )
+{
+  const byte *literals = s->literals;
+
+  for( size_t i = 0; i < s->num_sequences; i++ )
+  {
+    const sequence_t *seq = &s->sequences[i];
+
+    for( size_t j = 0; j < seq->literals_len; j++ )
+      if( !codec->write_literal( codec, *literals++ ) )
+        return false;
+
+    if( seq->match.len > 0 && !codec->write_match( codec, seq->match ) )
+      return false;
+  }
+
+  return true;
+}
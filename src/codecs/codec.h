@@ -6,14 +6,25 @@
 #include <stdbool.h>
 #include <string.h>
 #include "../match.h"
+#include "../sequence.h"
 #include "../datatype.h"
+#include "sink.h"
+
+
+/** Number of positions of the last matches kept to be repeated (see \c codec_reps_update). */
+#define CODEC_NUM_REPS 4
 
 
 /** Codec implementation initializer. */
 #define CODEC_INIT( int_data )  ( codec_t ) {  \
     .write_literal = _write_literal,           \
     .write_match = _write_match,               \
+    .write_sequences = codec_write_sequences,  \
+    .price_literal = _price_literal,           \
+    .price_match = _price_match,               \
+    .price_rep = NULL,                         \
     .read = _read,                             \
+    .read_literals = NULL,                     \
     .close = _close,                           \
     .destroy = _destroy,                       \
     ._int_data = int_data                      \
@@ -41,9 +52,43 @@
   buf->api = CODEC_INIT( ic )
 
 
-/** Callback used by the codec to output the encoded data.
- *  Receives the data to output, the size of the data and the user provided context. */
-typedef bool ( *codec_out_cb_t )( const void *buffer, size_t buffer_size, void *ctx );
+/** Encoded data being read by a codec. */
+typedef struct
+{
+  /** Encoded data. */
+  const byte *data;
+
+  /** Number of bytes of \c data. */
+  size_t size;
+
+  /** Number of bytes already consumed (updated by the codec). */
+  size_t pos;
+
+  /** Whether there's no more encoded data after \c data. */
+  bool last;
+
+} codec_input_t;
+
+
+/** Results of reading a token from a codec. */
+typedef enum
+{
+  /** A literal was read. */
+  codec_token_literal,
+
+  /** A match was read. */
+  codec_token_match,
+
+  /** The input ended in the middle of a token (the partial token is kept by the codec). */
+  codec_token_need_input,
+
+  /** The end of the encoded data was reached. */
+  codec_token_end,
+
+  /** The encoded data is not valid. */
+  codec_token_error,
+
+} codec_token_t;
 
 
 /** Codec type forward declaration. */
@@ -62,8 +107,29 @@ struct codec
   /** Writes an encoded match. */
   bool ( *write_match )( codec_t *codec, match_t m );
 
-  /** Reads a character from the codec. */
-  bool ( *read )( codec_t *codec, byte *c );
+  /** Writes all the sequences of a store (\c codec_write_sequences unless the codec has a faster
+   *  way). */
+  bool ( *write_sequences )( codec_t *codec, const sequence_store_t *s );
+
+  /** Returns the number of bits taken by an encoded literal. */
+  size_t ( *price_literal )( const codec_t *codec, byte c );
+
+  /** Returns the number of bits taken by an encoded match starting at stream offset \a pos (the
+   *  tokens before it may not have been written yet). */
+  size_t ( *price_match )( const codec_t *codec, match_t m, uint64_t pos );
+
+  /** Returns the number of bits taken by a match of length \a len repeating the position of the
+   *  \a rep-th last match (see \c codec_reps_update). \c NULL if the codec encodes those matches
+   *  like the others. */
+  size_t ( *price_rep )( const codec_t *codec, size_t rep, size_t len );
+
+  /** Decodes the next token (a literal in \a c or a match in \a m) from the input. */
+  codec_token_t ( *read )( codec_t *codec, codec_input_t *in, byte *c, match_t *m );
+
+  /** Decodes a run of literals into \a out (up to \a cap of them), returning how many were
+   *  decoded (zero if the next token is not a literal). \c NULL if the codec decodes literals only
+   *  through \c read. */
+  size_t ( *read_literals )( codec_t *codec, codec_input_t *in, byte *out, size_t cap );
 
   /** Closes the codec (finishes the encoding, like flushing pending data). */
   bool ( *close )( codec_t *codec );
@@ -74,4 +140,37 @@ struct codec
 };
 
 
+/* prototypes */
+bool codec_write_sequences( codec_t *codec, const sequence_store_t *s );
+
+
+/* inline functions */
+
+/**
+ * Moves the position of a match to the front of the positions of the last matches.
+ * The encoder and the decoder must track the same matches, so a match can be encoded as the index
+ * of its position.
+ * @param  reps Positions of the last matches, the last one first (\c CODEC_NUM_REPS of them).
+ * @param  pos  Position of the new match.
+ * @return      Index of \a pos in \a reps before the update (the first one if repeated), or
+ *              \c CODEC_NUM_REPS if it wasn't there.
+ */
+static inline size_t codec_reps_update( size_t *reps, size_t pos )
+{
+  size_t i = 0;
+  while( i < CODEC_NUM_REPS - 1 && reps[i] != pos )
+    i++;
+
+  size_t found = ( reps[i] == pos ) ? i : CODEC_NUM_REPS;
+
+  /* the positions before it move back (the last one is dropped if \a pos is new) */
+  for( ; i > 0; i-- )
+    reps[i] = reps[i - 1];
+
+  reps[0] = pos;
+
+  return found;
+}
+
+
 #endif
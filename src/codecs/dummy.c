@@ -34,14 +34,41 @@ static bool _write_match( codec_t *codec, match_t m )
 
 
 /**
- * Decodes and reads a character.
+ * Returns the size of an encoded literal.
  * @param  codec The codec instance.
- * @param  c     The output character.
- * @return       \c true on success, \c false otherwise.
+ * @param  c     Character to encode.
+ * @return       Number of bits.
+ */
+static size_t _price_literal( const codec_t *codec, unsigned char c )
+{
+  return 0;
+}
+
+
+/**
+ * Returns the size of an encoded match.
+ * @param  codec The codec instance.
+ * @param  m     Match to encode.
+ * @param  pos   Stream offset of the match.
+ * @return       Number of bits.
+ */
+static size_t _price_match( const codec_t *codec, match_t m, uint64_t pos )
+{
+  return 0;
+}
+
+
+/**
+ * Decodes the next token (there are none, the codec doesn't output anything).
+ * @param  codec The codec instance.
+ * @param  in    Encoded data.
+ * @param  c     The literal read.
+ * @param  m     The match read.
+ * @return       Always \c codec_token_end.
  */
-static bool _read( codec_t *codec, unsigned char *c )
+static codec_token_t _read( codec_t *codec, codec_input_t *in, byte *c, match_t *m )
 {
-  return false;
+  return codec_token_end;
 }
 
 
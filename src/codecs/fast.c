@@ -0,0 +1,629 @@
+/* include area */
+#include <stdint.h>
+#include "fast.h"
+#include "../math2.h"
+
+
+/** Constants */
+
+/** Value of a length nibble meaning the length continues in extra bytes. */
+#define LENGTH_ESCAPE 15U
+
+/** Value of an extra length byte meaning the length continues in the next one. */
+#define LENGTH_BYTE_MAX 255U
+
+/** Maximum number of bytes of an encoded offset. */
+#define MAX_OFFSET_BYTES 4U
+
+
+/*
+ * The data is encoded in byte-aligned sequences: a run of literals followed by a match.
+ *
+ *   token (1 byte): the literal run length in the high nibble and the match length (minus the
+ *                   minimum) in the low nibble, 15 meaning the length continues in extra bytes.
+ *   literal run length extra bytes: added to the 15 of the nibble, each 255 continues.
+ *   literals: copied as they are.
+ *   offset (2 to 4 bytes, little endian, as many as the maximum position takes): the match
+ *                    position plus one, or zero if the sequence has no match (the match nibble is
+ *                    zero then).
+ *   match length extra bytes: like the literal run length ones.
+ *
+ * A sequence without literals nor match ends the stream.
+ */
+
+
+/** Data types */
+
+/** Parts of a sequence, in the order they are decoded. */
+typedef enum
+{
+  fast_state_token,
+  fast_state_literals_len,
+  fast_state_literals,
+  fast_state_offset,
+  fast_state_match_len,
+  fast_state_match,
+  fast_state_done,
+
+} fast_state_t;
+
+
+/** Fast codec internal data. */
+typedef struct
+{
+  /** Where the encoded data is written (\c NULL if the codec is only used to decode). */
+  sink_t *sink;
+
+  /** Sink owned by the codec (when created with a callback). */
+  sink_t own_sink;
+
+  /** Minimum match length. */
+  size_t min_match_len;
+
+  /** Maximum match length. */
+  size_t max_match_len;
+
+  /** Number of bytes of an encoded offset (2 to 4). */
+  size_t offset_bytes;
+
+  /** Literals written since the last match (\c FAST_CODEC_MAX_LITERALS bytes). */
+  byte *literals;
+
+  /** Number of bytes in \c literals. */
+  size_t num_literals;
+
+  /** Part of the sequence being decoded. */
+  fast_state_t state;
+
+  /** Token of the sequence being decoded. */
+  byte token;
+
+  /** Literals of the sequence not decoded yet. */
+  size_t literals_left;
+
+  /** Match of the sequence being decoded (its length without the minimum). */
+  match_t match;
+
+  /** Offset of the sequence being decoded. */
+  size_t offset;
+
+  /** Number of bytes of \c offset already read. */
+  size_t offset_read;
+
+} fast_codec_t;
+
+
+/**
+ * Writes the extra bytes of a length that doesn't fit in its nibble.
+ * @param  fc  The fast codec.
+ * @param  len The length minus \c LENGTH_ESCAPE.
+ * @return     \c true on success, \c false otherwise.
+ */
+static bool _put_length( fast_codec_t *fc, size_t len )
+{
+  for( ; len >= LENGTH_BYTE_MAX; len -= LENGTH_BYTE_MAX )
+  {
+    byte *out = sink_reserve( fc->sink, 1 );
+    if( out == NULL )
+      return false;
+
+    *out = LENGTH_BYTE_MAX;
+    sink_commit( fc->sink, 1 );
+  }
+
+  byte *out = sink_reserve( fc->sink, 1 );
+  if( out == NULL )
+    return false;
+
+  *out = len;
+  sink_commit( fc->sink, 1 );
+
+  return true;
+}
+
+
+/**
+ * Writes a sequence.
+ * @param  fc           The fast codec.
+ * @param  literals     Literals before the match.
+ * @param  literals_len Number of literals.
+ * @param  m            The match (zero length if the sequence has no match).
+ * @return              \c true on success, \c false otherwise.
+ */
+static bool _put_sequence( fast_codec_t *fc, const byte *literals, size_t literals_len, match_t m )
+{
+  size_t match_len = ( m.len > 0 ) ? m.len - fc->min_match_len : 0;
+  size_t offset = ( m.len > 0 ) ? m.pos + 1 : 0;
+
+  byte *out = sink_reserve( fc->sink, 1 );
+  if( out == NULL )
+    return false;
+
+  *out = ( MIN( literals_len, LENGTH_ESCAPE ) << 4 ) | MIN( match_len, LENGTH_ESCAPE );
+  sink_commit( fc->sink, 1 );
+
+  if( literals_len >= LENGTH_ESCAPE && !_put_length( fc, literals_len - LENGTH_ESCAPE ) )
+    return false;
+
+  if( !sink_write( fc->sink, literals, literals_len ) )
+    return false;
+
+  out = sink_reserve( fc->sink, fc->offset_bytes );
+  if( out == NULL )
+    return false;
+
+  for( size_t i = 0; i < fc->offset_bytes; i++ )
+    out[i] = offset >> ( 8 * i );
+  sink_commit( fc->sink, fc->offset_bytes );
+
+  if( match_len >= LENGTH_ESCAPE && !_put_length( fc, match_len - LENGTH_ESCAPE ) )
+    return false;
+
+  return true;
+}
+
+
+/**
+ * Buffers literals until the next match, writing them in sequences without a match whenever the
+ * buffer gets full.
+ * @param  fc       The fast codec.
+ * @param  literals Literals to buffer.
+ * @param  len      Number of literals.
+ * @return          \c true on success, \c false otherwise.
+ */
+static bool _add_literals( fast_codec_t *fc, const byte *literals, size_t len )
+{
+  static const match_t no_match = { .pos = 0, .len = 0 };
+
+  while( len > 0 )
+  {
+    if( fc->num_literals == FAST_CODEC_MAX_LITERALS )
+    {
+      if( !_put_sequence( fc, fc->literals, fc->num_literals, no_match ) )
+        return false;
+
+      fc->num_literals = 0;
+    }
+
+    size_t n = MIN( len, FAST_CODEC_MAX_LITERALS - fc->num_literals );
+    memcpy( fc->literals + fc->num_literals, literals, n );
+    fc->num_literals += n;
+    literals += n;
+    len -= n;
+  }
+
+  return true;
+}
+
+
+/**
+ * Writes an encoded literal.
+ * @param  codec The codec instance.
+ * @param  c     Character to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_literal( codec_t *codec, unsigned char c )
+{
+  fast_codec_t *fc = codec->_int_data;
+
+  /* the literals are written along with the next match */
+  if( fc->num_literals < FAST_CODEC_MAX_LITERALS )
+  {
+    fc->literals[fc->num_literals++] = c;
+    return true;
+  }
+
+  return _add_literals( fc, &c, 1 );
+}
+
+
+/**
+ * Writes an encoded match.
+ * @param  codec The codec instance.
+ * @param  m     The match to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_match( codec_t *codec, match_t m )
+{
+  fast_codec_t *fc = codec->_int_data;
+
+  bool success = _put_sequence( fc, fc->literals, fc->num_literals, m );
+  fc->num_literals = 0;
+
+  return success;
+}
+
+
+/**
+ * Writes all the sequences of a store.
+ * The literals are written straight from the store, unless there are literals buffered before
+ * them.
+ * @param  codec The codec instance.
+ * @param  s     Sequences to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_sequences( codec_t *codec, const sequence_store_t *s )
+{
+  fast_codec_t *fc = codec->_int_data;
+  const byte *literals = s->literals;
+
+  for( size_t i = 0; i < s->num_sequences; i++ )
+  {
+    const sequence_t *seq = &s->sequences[i];
+    bool success;
+
+    /* the literals without a match are joined with the next sequence */
+    if( seq->match.len == 0 )
+      success = _add_literals( fc, literals, seq->literals_len );
+    else if( fc->num_literals == 0 )
+      success = _put_sequence( fc, literals, seq->literals_len, seq->match );
+    else
+    {
+      success = _add_literals( fc, literals, seq->literals_len ) &&
+                _put_sequence( fc, fc->literals, fc->num_literals, seq->match );
+      fc->num_literals = 0;
+    }
+
+    if( !success )
+      return false;
+
+    literals += seq->literals_len;
+  }
+
+  return true;
+}
+
+
+/**
+ * Returns the size of an encoded literal.
+ * @param  codec The codec instance.
+ * @param  c     Character to encode.
+ * @return       Number of bits.
+ */
+static size_t _price_literal( const codec_t *codec, unsigned char c )
+{
+  /* the literal is copied as it is (the run length is shared with the sequence) */
+  return 8;
+}
+
+
+/**
+ * Returns the size of an encoded match.
+ * @param  codec The codec instance.
+ * @param  m     Match to encode.
+ * @param  pos   Stream offset of the match.
+ * @return       Number of bits.
+ */
+static size_t _price_match( const codec_t *codec, match_t m, uint64_t pos )
+{
+  const fast_codec_t *fc = codec->_int_data;
+  size_t match_len = m.len - fc->min_match_len;
+
+  /* the token, the offset and the extra length bytes */
+  size_t num_bytes = 1 + fc->offset_bytes;
+  if( match_len >= LENGTH_ESCAPE )
+    num_bytes += ( match_len - LENGTH_ESCAPE ) / LENGTH_BYTE_MAX + 1;
+
+  return 8 * num_bytes;
+}
+
+
+/**
+ * Reads the extra bytes of a length (until one is not \c LENGTH_BYTE_MAX).
+ * @param  in  Encoded data.
+ * @param  len Length the bytes are added to.
+ * @param  max Maximum length allowed.
+ * @return     \c codec_token_end when the length is complete, or why it's not.
+ */
+static codec_token_t _read_length( codec_input_t *in, size_t *len, size_t max )
+{
+  while( in->pos < in->size )
+  {
+    byte b = in->data[in->pos++];
+
+    if( b > max - *len )
+      return codec_token_error;
+
+    *len += b;
+    if( b != LENGTH_BYTE_MAX )
+      return codec_token_end;
+  }
+
+  return in->last ? codec_token_error : codec_token_need_input;
+}
+
+
+/**
+ * Starts decoding a sequence from its token.
+ * @param fc    The fast codec.
+ * @param token The token.
+ */
+static inline void _start_sequence( fast_codec_t *fc, byte token )
+{
+  fc->token = token;
+  fc->literals_left = token >> 4;
+  fc->match.len = token & LENGTH_ESCAPE;
+  fc->offset = 0;
+  fc->offset_read = 0;
+  fc->state = ( fc->literals_left == LENGTH_ESCAPE ) ? fast_state_literals_len :
+                                                       fast_state_literals;
+}
+
+
+/**
+ * Decodes the next token.
+ * The sequences are decoded a part at a time, so they can be split anywhere in the input.
+ * @param  codec The codec instance.
+ * @param  in    Encoded data.
+ * @param  c     The literal read.
+ * @param  m     The match read.
+ * @return       The kind of token read, or why none could be read.
+ */
+static codec_token_t _read( codec_t *codec, codec_input_t *in, byte *c, match_t *m )
+{
+  fast_codec_t *fc = codec->_int_data;
+  codec_token_t token;
+
+  /* fast path: a match right after the literals with its offset and length in the input (the
+   * tokens of sequences with literals are taken by _read_literals) */
+  if( fc->state == fast_state_token && in->pos < in->size && in->data[in->pos] <= LENGTH_ESCAPE )
+    _start_sequence( fc, in->data[in->pos++] );
+
+  if( fc->state == fast_state_literals && fc->literals_left == 0 &&
+      in->size - in->pos > fc->offset_bytes )
+  {
+    const byte *p = in->data + in->pos;
+    size_t offset = p[0] | ( ( size_t )p[1] << 8 );
+    for( size_t i = 2; i < fc->offset_bytes; i++ )
+      offset |= ( size_t )p[i] << ( 8 * i );
+
+    size_t len = fc->match.len;
+    if( len == LENGTH_ESCAPE )
+      len += p[fc->offset_bytes];
+
+    if( offset > 0 && len <= fc->max_match_len - fc->min_match_len &&
+        ( fc->match.len < LENGTH_ESCAPE || p[fc->offset_bytes] != LENGTH_BYTE_MAX ) )
+    {
+      in->pos += fc->offset_bytes + ( fc->match.len == LENGTH_ESCAPE );
+      fc->state = fast_state_token;
+      m->pos = offset - 1;
+      m->len = len + fc->min_match_len;
+      return codec_token_match;
+    }
+  }
+
+  while( true )
+  {
+    switch( fc->state )
+    {
+      case fast_state_token:
+      {
+        if( in->pos == in->size )
+          return in->last ? codec_token_error : codec_token_need_input;
+
+        _start_sequence( fc, in->data[in->pos++] );
+        break;
+      }
+
+      case fast_state_literals_len:
+        token = _read_length( in, &fc->literals_left, SIZE_MAX );
+        if( token != codec_token_end )
+          return token;
+
+        fc->state = fast_state_literals;
+        break;
+
+      case fast_state_literals:
+        if( fc->literals_left > 0 )
+        {
+          if( in->pos == in->size )
+            return in->last ? codec_token_error : codec_token_need_input;
+
+          *c = in->data[in->pos++];
+          fc->literals_left--;
+          return codec_token_literal;
+        }
+
+        fc->state = fast_state_offset;
+        break;
+
+      case fast_state_offset:
+        /* the whole offset at once if it's in the input */
+        if( fc->offset_read == 0 && in->size - in->pos >= fc->offset_bytes )
+        {
+          const byte *p = in->data + in->pos;
+          fc->offset = p[0] | ( ( size_t )p[1] << 8 );
+          for( size_t i = 2; i < fc->offset_bytes; i++ )
+            fc->offset |= ( size_t )p[i] << ( 8 * i );
+
+          fc->offset_read = fc->offset_bytes;
+          in->pos += fc->offset_bytes;
+        }
+
+        for( ; fc->offset_read < fc->offset_bytes; fc->offset_read++ )
+        {
+          if( in->pos == in->size )
+            return in->last ? codec_token_error : codec_token_need_input;
+
+          fc->offset |= ( size_t )in->data[in->pos++] << ( 8 * fc->offset_read );
+        }
+
+        if( fc->offset > 0 )
+          fc->state = ( fc->match.len == LENGTH_ESCAPE ) ? fast_state_match_len : fast_state_match;
+        else if( fc->match.len > 0 )
+          return codec_token_error;
+        else
+        {
+          /* a sequence without a match ends the stream if it has no literals either */
+          fc->state = ( fc->token == 0 ) ? fast_state_done : fast_state_token;
+        }
+        break;
+
+      case fast_state_match_len:
+        token = _read_length( in, &fc->match.len, fc->max_match_len - fc->min_match_len );
+        if( token != codec_token_end )
+          return token;
+
+        fc->state = fast_state_match;
+        break;
+
+      case fast_state_match:
+        fc->state = fast_state_token;
+        m->pos = fc->offset - 1;
+        m->len = fc->match.len + fc->min_match_len;
+        return codec_token_match;
+
+      case fast_state_done:
+        return codec_token_end;
+    }
+  }
+}
+
+
+/**
+ * Decodes a run of literals, copying as many as possible at once.
+ * @param  codec The codec instance.
+ * @param  in    Encoded data.
+ * @param  out   Where the literals are decoded.
+ * @param  cap   Maximum number of literals to decode.
+ * @return       Number of literals decoded (zero if the next token is not a literal).
+ */
+static size_t _read_literals( codec_t *codec, codec_input_t *in, byte *out, size_t cap )
+{
+  fast_codec_t *fc = codec->_int_data;
+
+  /* starts the next sequence if it has literals (they are right after the token) */
+  if( fc->state == fast_state_token && in->pos < in->size && in->data[in->pos] > LENGTH_ESCAPE )
+    _start_sequence( fc, in->data[in->pos++] );
+
+  if( fc->state != fast_state_literals )
+    return 0;
+
+  size_t n = MIN( MIN( fc->literals_left, in->size - in->pos ), cap );
+  memcpy( out, in->data + in->pos, n );
+  in->pos += n;
+  fc->literals_left -= n;
+
+  return n;
+}
+
+
+/**
+ * Finishes the encoded output.
+ * @param  codec The codec instance.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _close( codec_t *codec )
+{
+  static const match_t no_match = { .pos = 0, .len = 0 };
+  fast_codec_t *fc = codec->_int_data;
+
+  /* writes the literals left and the sequence ending the stream */
+  if( fc->num_literals > 0 && !_put_sequence( fc, fc->literals, fc->num_literals, no_match ) )
+    return false;
+
+  fc->num_literals = 0;
+
+  if( !_put_sequence( fc, NULL, 0, no_match ) )
+    return false;
+
+  return sink_flush( fc->sink );
+}
+
+
+/**
+ * Destroys the codec releasing all the taken resources.
+ * @param codec Codec to destroy.
+ */
+static void _destroy( codec_t *codec )
+{
+  fast_codec_t *fc = codec->_int_data;
+
+  if( fc->sink == &fc->own_sink )
+    sink_release( fc->sink );
+
+  free( fc->literals );
+  free( codec );
+}
+
+
+/**
+ * Creates a new fast codec writing into a sink.
+ * The data is encoded in byte-aligned sequences, which take more space than the bit-packed
+ * tokens of the binary codec but are much faster to decode.
+ * @param  sink          Sink where the encoded data is written (\c NULL if only used to decode).
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *fast_codec_create_sink( sink_t *sink,
+                                 size_t min_match_len,
+                                 size_t max_match_len,
+                                 size_t max_pos )
+{
+  /* input checks */
+  if( min_match_len == 0 || min_match_len > max_match_len )
+    return NULL;
+  if( max_pos < 1 || math_bits_in_n( max_pos ) > 8 * MAX_OFFSET_BYTES )
+    return NULL;
+
+  NEW_CODEC( fast_codec_t );
+  codec->write_sequences = _write_sequences;
+  codec->read_literals = _read_literals;
+
+  ic->sink = sink;
+  ic->min_match_len = min_match_len;
+  ic->max_match_len = max_match_len;
+  ic->offset_bytes = MAX( ( math_bits_in_n( max_pos ) + 7 ) / 8, 2 );
+  ic->state = fast_state_token;
+
+  /* the literals are only buffered to encode */
+  if( sink != NULL )
+  {
+    ic->literals = malloc( FAST_CODEC_MAX_LITERALS );
+    if( ic->literals == NULL )
+    {
+      free( buf );
+      return NULL;
+    }
+  }
+
+  return codec;
+}
+
+
+/**
+ * Creates a new fast codec.
+ * The encoded data is output through \a cb in chunks of \c FAST_CODEC_BUFFER_SIZE bytes, and
+ * when the codec is closed.
+ * @param  cb            Callback used to output data (\c NULL if only used to decode).
+ * @param  cb_ctx        Context passed to \a cb.
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *fast_codec_create( codec_out_cb_t cb,
+                            void *cb_ctx,
+                            size_t min_match_len,
+                            size_t max_match_len,
+                            size_t max_pos )
+{
+  codec_t *codec = fast_codec_create_sink( NULL, min_match_len, max_match_len, max_pos );
+  if( codec == NULL || cb == NULL )
+    return codec;
+
+  fast_codec_t *fc = codec->_int_data;
+  fc->literals = malloc( FAST_CODEC_MAX_LITERALS );
+  if( fc->literals == NULL ||
+      !sink_init_callback( &fc->own_sink, cb, cb_ctx, FAST_CODEC_BUFFER_SIZE ) )
+  {
+    codec->destroy( codec );
+    return NULL;
+  }
+
+  fc->sink = &fc->own_sink;
+
+  return codec;
+}
@@ -0,0 +1,31 @@
+#ifndef FAST_H
+#define FAST_H
+
+
+/* include area */
+#include "codec.h"
+
+
+/* constants */
+
+/** Default size of the output buffer of the fast codec. */
+#define FAST_CODEC_BUFFER_SIZE 65536
+
+/** Maximum number of literals buffered by the fast codec before they are written without a
+ *  match. */
+#define FAST_CODEC_MAX_LITERALS 65536
+
+
+/* prototypes */
+codec_t *fast_codec_create( codec_out_cb_t cb,
+                            void *cb_ctx,
+                            size_t min_match_len,
+                            size_t max_match_len,
+                            size_t max_pos );
+codec_t *fast_codec_create_sink( sink_t *sink,
+                                 size_t min_match_len,
+                                 size_t max_match_len,
+                                 size_t max_pos );
+
+
+#endif
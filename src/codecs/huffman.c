@@ -0,0 +1,977 @@
+/* include area */
+#include "huffman.h"
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "bucket.h"
+#include "../math2.h"
+
+
+/** Constants */
+#define BITS_IN_BYTE 8U
+
+/** Maximum length of a code (the decoding tables have an entry for each value of this many bits). */
+#define MAX_CODE_BITS HUFFMAN_CODEC_MAX_CODE_BITS
+
+/** Symbol of the literal/length alphabet ending a block (the literals are the symbols before
+ *  it). */
+#define END_OF_BLOCK 256U
+
+/** First symbol of the literal/length alphabet for the match length buckets. */
+#define FIRST_LENGTH_SYMBOL 257U
+
+/** Maximum number of symbols of the literal/length alphabet. */
+#define MAX_LITLEN_SYMBOLS ( FIRST_LENGTH_SYMBOL + BUCKET_MAX_CODES )
+
+/** Maximum number of symbols of the offset alphabet. */
+#define MAX_OFFSET_SYMBOLS BUCKET_MAX_CODES
+
+/** Number of bits of the number of symbols of the literal/length alphabet in a block header. */
+#define LITLEN_COUNT_BITS 9U
+
+/** Number of bits of the number of symbols of the offset alphabet in a block header. */
+#define OFFSET_COUNT_BITS 7U
+
+/** Number of bits of a code length in a block header. */
+#define CODE_LEN_BITS 4U
+
+/** Number of bits of the number of zero lengths following a zero length in a block header. */
+#define ZERO_RUN_BITS 5U
+
+
+/*
+ * The tokens are encoded in blocks, each one with its own canonical Huffman codes (like deflate):
+ *
+ *   last block flag (1 bit).
+ *   number of symbols of the literal/length alphabet (9 bits), followed by their code lengths.
+ *   number of symbols of the offset alphabet (7 bits), followed by their code lengths.
+ *   tokens: a literal is its symbol, and a match is the symbol of its length bucket (and its extra
+ *           bits) followed by the symbol of its offset bucket (and its extra bits).
+ *   end of block symbol.
+ *
+ * The code lengths take 4 bits each, and a zero length is followed by 5 bits with the number of
+ * zero lengths after it. The bits are packed most significant bit first, and the last byte is
+ * padded with zeros.
+ */
+
+
+/** Data types */
+
+/** Huffman code of an alphabet. */
+typedef struct
+{
+  /** Number of symbols (up to the last one with a code). */
+  size_t num_symbols;
+
+  /** Length of the code of each symbol (zero if the symbol has no code). */
+  byte lengths[MAX_LITLEN_SYMBOLS];
+
+  /** Code of each symbol. */
+  uint16_t codes[MAX_LITLEN_SYMBOLS];
+
+} huffman_code_t;
+
+
+/** Entry of a decoding table, indexed by the next \c MAX_CODE_BITS bits. */
+typedef struct
+{
+  /** Symbol whose code is at the beginning of the bits. */
+  uint16_t symbol;
+
+  /** Length of the code (zero if the bits don't start with a code). */
+  byte len;
+
+} huffman_entry_t;
+
+
+/** Token buffered until its block is encoded. */
+typedef struct
+{
+  /** Match length (zero for a literal). */
+  uint32_t len;
+
+  /** Match position or literal. */
+  uint32_t value;
+
+} huffman_token_t;
+
+
+/** Parts of the stream, in the order they are decoded. */
+typedef enum
+{
+  huffman_state_block,
+  huffman_state_lengths,
+  huffman_state_offset_count,
+  huffman_state_tokens,
+  huffman_state_offset,
+  huffman_state_done,
+
+} huffman_state_t;
+
+
+/** Huffman codec internal data. */
+typedef struct
+{
+  /** Bits encoded but not stored in the sink yet. */
+  bit_writer_t writer;
+
+  /** Where the encoded data is written (\c NULL if the codec is only used to decode). */
+  sink_t *sink;
+
+  /** Sink owned by the codec (when created with a callback). */
+  sink_t own_sink;
+
+  /** Minimum match length. */
+  size_t min_match_len;
+
+  /** Maximum match length. */
+  size_t max_match_len;
+
+  /** Number of symbols of the literal/length alphabet for the match lengths allowed. */
+  size_t max_litlen_symbols;
+
+  /** Number of symbols of the offset alphabet for the positions allowed. */
+  size_t max_offset_symbols;
+
+  /** Tokens of the block being encoded (\c HUFFMAN_CODEC_BLOCK_SIZE of them). */
+  huffman_token_t *tokens;
+
+  /** Number of tokens in \c tokens. */
+  size_t num_tokens;
+
+  /** Frequencies of the literal/length symbols of the block. */
+  size_t litlen_freqs[MAX_LITLEN_SYMBOLS];
+
+  /** Frequencies of the offset symbols of the block. */
+  size_t offset_freqs[MAX_OFFSET_SYMBOLS];
+
+  /** Literal/length code of the last block (encoded or being decoded). */
+  huffman_code_t litlen;
+
+  /** Offset code of the last block (encoded or being decoded). */
+  huffman_code_t offset;
+
+  /** Bits read but not decoded yet. */
+  bit_reader_t reader;
+
+  /** Part of the stream being decoded. */
+  huffman_state_t state;
+
+  /** Whether the block being decoded is the last one. */
+  bool last_block;
+
+  /** Code whose lengths are being read. */
+  huffman_code_t *reading;
+
+  /** Next symbol whose length is read. */
+  size_t symbol;
+
+  /** Length of the match whose offset is being decoded. */
+  size_t match_len;
+
+  /** Decoding table of the literal/length code. */
+  huffman_entry_t litlen_table[1 << MAX_CODE_BITS];
+
+  /** Decoding table of the offset code. */
+  huffman_entry_t offset_table[1 << MAX_CODE_BITS];
+
+} huffman_codec_t;
+
+
+/** Symbol and frequency, used to sort the symbols building a code. */
+typedef struct
+{
+  size_t freq;
+  size_t symbol;
+
+} huffman_leaf_t;
+
+
+/**
+ * Compares two leaves by frequency (and symbol, so the order is always the same).
+ * @param  a First leaf.
+ * @param  b Second leaf.
+ * @return   Negative, zero or positive as \a a goes before, with or after \a b.
+ */
+static int _compare_leaves( const void *a, const void *b )
+{
+  const huffman_leaf_t *la = a, *lb = b;
+
+  if( la->freq != lb->freq )
+    return ( la->freq < lb->freq ) ? -1 : 1;
+
+  return ( la->symbol < lb->symbol ) ? -1 : ( la->symbol > lb->symbol );
+}
+
+
+/**
+ * Limits the code lengths to \c MAX_CODE_BITS, making the codes of the least frequent symbols
+ * longer until the lengths are valid again, and then using the room left to make the codes of the
+ * most frequent ones shorter.
+ * @param lengths  Code lengths of the symbols.
+ * @param leaves   Symbols with a code, sorted by frequency.
+ * @param n        Number of leaves.
+ */
+static void _limit_lengths( byte *lengths, const huffman_leaf_t *leaves, size_t n )
+{
+  const size_t max_kraft = ( size_t )1 << MAX_CODE_BITS;
+  size_t kraft = 0;
+
+  for( size_t i = 0; i < n; i++ )
+  {
+    byte *len = &lengths[leaves[i].symbol];
+    *len = MIN( *len, MAX_CODE_BITS );
+    kraft += ( size_t )1 << ( MAX_CODE_BITS - *len );
+  }
+
+  while( kraft > max_kraft )
+  {
+    for( size_t i = 0; i < n && kraft > max_kraft; i++ )
+    {
+      byte *len = &lengths[leaves[i].symbol];
+      if( *len < MAX_CODE_BITS )
+      {
+        kraft -= ( size_t )1 << ( MAX_CODE_BITS - *len - 1 );
+        ( *len )++;
+      }
+    }
+  }
+
+  for( size_t i = n; i-- > 0; )
+  {
+    byte *len = &lengths[leaves[i].symbol];
+    while( *len > 1 && kraft + ( ( size_t )1 << ( MAX_CODE_BITS - *len ) ) <= max_kraft )
+    {
+      kraft += ( size_t )1 << ( MAX_CODE_BITS - *len );
+      ( *len )--;
+    }
+  }
+}
+
+
+/**
+ * Assigns the canonical codes of an alphabet from its code lengths.
+ * @param  code Code with the lengths set.
+ * @return      \c true on success, \c false if the lengths are not valid.
+ */
+static bool _assign_codes( huffman_code_t *code )
+{
+  size_t counts[MAX_CODE_BITS + 1] = { 0 };
+  size_t next[MAX_CODE_BITS + 1];
+
+  for( size_t i = 0; i < code->num_symbols; i++ )
+    counts[code->lengths[i]]++;
+
+  /* the codes of each length follow the ones of the previous length */
+  size_t first = 0, kraft = 0;
+  counts[0] = 0;
+  for( size_t len = 1; len <= MAX_CODE_BITS; len++ )
+  {
+    first = ( first + counts[len - 1] ) << 1;
+    next[len] = first;
+    kraft += counts[len] << ( MAX_CODE_BITS - len );
+  }
+
+  if( kraft > ( ( size_t )1 << MAX_CODE_BITS ) )
+    return false;
+
+  for( size_t i = 0; i < code->num_symbols; i++ )
+    if( code->lengths[i] > 0 )
+      code->codes[i] = next[code->lengths[i]]++;
+
+  return true;
+}
+
+
+/**
+ * Builds a length-limited canonical Huffman code.
+ * @param code  Code built.
+ * @param freqs Frequency of each symbol.
+ * @param n     Number of symbols of the alphabet.
+ */
+static void _build_code( huffman_code_t *code, const size_t *freqs, size_t n )
+{
+  huffman_leaf_t leaves[MAX_LITLEN_SYMBOLS];
+  size_t weights[2 * MAX_LITLEN_SYMBOLS];
+  size_t parents[2 * MAX_LITLEN_SYMBOLS];
+  size_t num_leaves = 0;
+
+  memset( code->lengths, 0, sizeof( code->lengths ) );
+  code->num_symbols = 0;
+
+  for( size_t i = 0; i < n; i++ )
+  {
+    if( freqs[i] > 0 )
+    {
+      leaves[num_leaves++] = ( huffman_leaf_t ){ .freq = freqs[i], .symbol = i };
+      code->num_symbols = i + 1;
+    }
+  }
+
+  /* a single symbol still takes a bit */
+  if( num_leaves == 1 )
+    code->lengths[leaves[0].symbol] = 1;
+
+  if( num_leaves > 1 )
+  {
+    qsort( leaves, num_leaves, sizeof( huffman_leaf_t ), _compare_leaves );
+
+    /* the internal nodes are created in increasing weight order, so the two lightest nodes are
+     * always at the front of the leaves or the internal nodes */
+    size_t leaf = 0, node = num_leaves, root = 2 * num_leaves - 2;
+    for( size_t i = 0; i < num_leaves; i++ )
+      weights[i] = leaves[i].freq;
+
+    for( size_t next = num_leaves; next <= root; next++ )
+    {
+      weights[next] = 0;
+      for( size_t k = 0; k < 2; k++ )
+      {
+        size_t child = ( leaf < num_leaves && ( node >= next || weights[leaf] <= weights[node] ) ) ?
+                       leaf++ : node++;
+        weights[next] += weights[child];
+        parents[child] = next;
+      }
+    }
+
+    /* the weights are replaced by the depths, from the root down */
+    weights[root] = 0;
+    for( size_t i = root; i-- > 0; )
+      weights[i] = weights[parents[i]] + 1;
+
+    for( size_t i = 0; i < num_leaves; i++ )
+      code->lengths[leaves[i].symbol] = MIN( weights[i], MAX_CODE_BITS + 1 );
+
+    _limit_lengths( code->lengths, leaves, num_leaves );
+  }
+
+  _assign_codes( code );
+}
+
+
+/**
+ * Builds the decoding table of a code.
+ * @param  code  Code with the lengths set.
+ * @param  table Decoding table.
+ * @return       \c true on success, \c false if the lengths are not valid.
+ */
+static bool _build_table( huffman_code_t *code, huffman_entry_t *table )
+{
+  if( !_assign_codes( code ) )
+    return false;
+
+  memset( table, 0, sizeof( huffman_entry_t ) << MAX_CODE_BITS );
+
+  /* each code fills the entries starting with it */
+  for( size_t i = 0; i < code->num_symbols; i++ )
+  {
+    size_t len = code->lengths[i];
+    if( len == 0 )
+      continue;
+
+    huffman_entry_t entry = { .symbol = i, .len = len };
+    size_t first = ( size_t )code->codes[i] << ( MAX_CODE_BITS - len );
+    for( size_t j = 0; j < ( ( size_t )1 << ( MAX_CODE_BITS - len ) ); j++ )
+      table[first + j] = entry;
+  }
+
+  return true;
+}
+
+
+/**
+ * Stores the bytes completed one at a time (near the end of a caller's buffer, where a whole word
+ * doesn't fit).
+ * @param  hc The Huffman codec.
+ * @return    \c true on success, \c false otherwise.
+ */
+static bool _put_bytes( huffman_codec_t *hc )
+{
+  while( hc->writer.count >= BITS_IN_BYTE )
+  {
+    byte b = bit_writer_take_byte( &hc->writer );
+    if( !sink_write( hc->sink, &b, sizeof( b ) ) )
+      return false;
+  }
+
+  return true;
+}
+
+
+/**
+ * Encodes some bits and stores the bytes completed in the sink.
+ * @param  hc       The Huffman codec.
+ * @param  bits     Bits (the least significant \a num_bits).
+ * @param  num_bits Number of bits (up to \c BIT_WRITER_MAX_BITS).
+ * @return          \c true on success, \c false otherwise.
+ */
+static inline bool _put( huffman_codec_t *hc, uint64_t bits, size_t num_bits )
+{
+  bit_writer_put( &hc->writer, bits, num_bits );
+
+  byte *out = sink_reserve( hc->sink, sizeof( uint64_t ) );
+  if( out == NULL )
+    return hc->sink->cb == NULL && _put_bytes( hc );
+
+  byte *end = out;
+  bit_writer_flush( &hc->writer, &end );
+  sink_commit( hc->sink, end - out );
+
+  return true;
+}
+
+
+/**
+ * Encodes a symbol followed by the extra bits of its bucket.
+ * @param  hc     The Huffman codec.
+ * @param  code   Code of the alphabet.
+ * @param  symbol Symbol.
+ * @param  bucket Bucket code of the value.
+ * @param  value  Value encoded by the bucket.
+ * @return        \c true on success, \c false otherwise.
+ */
+static inline bool _put_bucket( huffman_codec_t *hc,
+                                const huffman_code_t *code,
+                                size_t symbol,
+                                size_t bucket,
+                                size_t value )
+{
+  size_t extra_bits = bucket_extra_bits( bucket );
+
+  return _put( hc,
+               ( ( uint64_t )code->codes[symbol] << extra_bits ) | ( value - bucket_base( bucket ) ),
+               code->lengths[symbol] + extra_bits );
+}
+
+
+/**
+ * Writes the code lengths of an alphabet in a block header.
+ * @param  hc         The Huffman codec.
+ * @param  code       Code of the alphabet.
+ * @param  count_bits Number of bits of the number of symbols.
+ * @return            \c true on success, \c false otherwise.
+ */
+static bool _put_lengths( huffman_codec_t *hc, const huffman_code_t *code, size_t count_bits )
+{
+  if( !_put( hc, code->num_symbols, count_bits ) )
+    return false;
+
+  for( size_t i = 0; i < code->num_symbols; )
+  {
+    size_t len = code->lengths[i++];
+
+    /* a zero length is followed by the number of zero lengths after it */
+    if( len == 0 )
+    {
+      size_t run = 0;
+      while( i < code->num_symbols && code->lengths[i] == 0 && run < ( 1U << ZERO_RUN_BITS ) - 1 )
+      {
+        run++;
+        i++;
+      }
+
+      if( !_put( hc, run, CODE_LEN_BITS + ZERO_RUN_BITS ) )
+        return false;
+    }
+    else if( !_put( hc, len, CODE_LEN_BITS ) )
+      return false;
+  }
+
+  return true;
+}
+
+
+/**
+ * Encodes the tokens buffered as a block, with codes built for them.
+ * @param  hc   The Huffman codec.
+ * @param  last Whether it's the last block of the stream.
+ * @return      \c true on success, \c false otherwise.
+ */
+static bool _write_block( huffman_codec_t *hc, bool last )
+{
+  hc->litlen_freqs[END_OF_BLOCK]++;
+  _build_code( &hc->litlen, hc->litlen_freqs, MAX_LITLEN_SYMBOLS );
+  _build_code( &hc->offset, hc->offset_freqs, MAX_OFFSET_SYMBOLS );
+
+  memset( hc->litlen_freqs, 0, sizeof( hc->litlen_freqs ) );
+  memset( hc->offset_freqs, 0, sizeof( hc->offset_freqs ) );
+
+  if( !_put( hc, last, 1 ) ||
+      !_put_lengths( hc, &hc->litlen, LITLEN_COUNT_BITS ) ||
+      !_put_lengths( hc, &hc->offset, OFFSET_COUNT_BITS ) )
+    return false;
+
+  for( size_t i = 0; i < hc->num_tokens; i++ )
+  {
+    const huffman_token_t *token = &hc->tokens[i];
+    bool success;
+
+    if( token->len == 0 )
+      success = _put( hc, hc->litlen.codes[token->value], hc->litlen.lengths[token->value] );
+    else
+    {
+      size_t len = token->len - hc->min_match_len;
+      size_t len_bucket = bucket_code( len );
+      size_t pos_bucket = bucket_code( token->value );
+
+      success = _put_bucket( hc, &hc->litlen, FIRST_LENGTH_SYMBOL + len_bucket, len_bucket, len ) &&
+                _put_bucket( hc, &hc->offset, pos_bucket, pos_bucket, token->value );
+    }
+
+    if( !success )
+      return false;
+  }
+
+  hc->num_tokens = 0;
+
+  return _put( hc, hc->litlen.codes[END_OF_BLOCK], hc->litlen.lengths[END_OF_BLOCK] );
+}
+
+
+/**
+ * Writes an encoded literal.
+ * @param  codec The codec instance.
+ * @param  c     Character to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_literal( codec_t *codec, unsigned char c )
+{
+  huffman_codec_t *hc = codec->_int_data;
+
+  /* the tokens are encoded once the block is full */
+  if( hc->num_tokens == HUFFMAN_CODEC_BLOCK_SIZE && !_write_block( hc, false ) )
+    return false;
+
+  hc->tokens[hc->num_tokens++] = ( huffman_token_t ){ .len = 0, .value = c };
+  hc->litlen_freqs[c]++;
+
+  return true;
+}
+
+
+/**
+ * Writes an encoded match.
+ * @param  codec The codec instance.
+ * @param  m     The match to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_match( codec_t *codec, match_t m )
+{
+  huffman_codec_t *hc = codec->_int_data;
+
+  if( hc->num_tokens == HUFFMAN_CODEC_BLOCK_SIZE && !_write_block( hc, false ) )
+    return false;
+
+  hc->tokens[hc->num_tokens++] = ( huffman_token_t ){ .len = m.len, .value = m.pos };
+  hc->litlen_freqs[FIRST_LENGTH_SYMBOL + bucket_code( m.len - hc->min_match_len )]++;
+  hc->offset_freqs[bucket_code( m.pos )]++;
+
+  return true;
+}
+
+
+/**
+ * Returns the number of bits of a symbol in the last block's code.
+ * @param  code     Code of the alphabet.
+ * @param  symbol   Symbol.
+ * @param  fallback Number of bits if the symbol had no code.
+ * @return          Number of bits.
+ */
+static inline size_t _price_symbol( const huffman_code_t *code, size_t symbol, size_t fallback )
+{
+  return ( code->lengths[symbol] > 0 ) ? code->lengths[symbol] : fallback;
+}
+
+
+/**
+ * Returns the size of an encoded literal (estimated with the codes of the last block).
+ * @param  codec The codec instance.
+ * @param  c     Character to encode.
+ * @return       Number of bits.
+ */
+static size_t _price_literal( const codec_t *codec, unsigned char c )
+{
+  const huffman_codec_t *hc = codec->_int_data;
+
+  return _price_symbol( &hc->litlen, c, BITS_IN_BYTE );
+}
+
+
+/**
+ * Returns the size of an encoded match (estimated with the codes of the last block).
+ * @param  codec The codec instance.
+ * @param  m     Match to encode.
+ * @param  pos   Stream offset of the match.
+ * @return       Number of bits.
+ */
+static size_t _price_match( const codec_t *codec, match_t m, uint64_t pos )
+{
+  const huffman_codec_t *hc = codec->_int_data;
+  size_t len_bucket = bucket_code( m.len - hc->min_match_len );
+  size_t pos_bucket = bucket_code( m.pos );
+
+  /* the buckets are around 64, so an unknown one takes about 6 bits */
+  return _price_symbol( &hc->litlen, FIRST_LENGTH_SYMBOL + len_bucket, 6 ) +
+         bucket_extra_bits( len_bucket ) +
+         _price_symbol( &hc->offset, pos_bucket, 6 ) +
+         bucket_extra_bits( pos_bucket );
+}
+
+
+/**
+ * Returns why a part of the stream couldn't be read when there are not enough bits.
+ * @param  in Encoded data.
+ * @return    \c codec_token_error if the input is over, \c codec_token_need_input otherwise.
+ */
+static inline codec_token_t _starved( const codec_input_t *in )
+{
+  return in->last ? codec_token_error : codec_token_need_input;
+}
+
+
+/**
+ * Fills the bit reader with input bytes (8 at a time if possible).
+ * @param hc The Huffman codec.
+ * @param in Encoded data.
+ */
+static inline void _fill( huffman_codec_t *hc, codec_input_t *in )
+{
+  bit_reader_t *br = &hc->reader;
+
+  if( br->count >= BIT_READER_REFILL_BITS )
+    return;
+
+  if( in->size - in->pos >= sizeof( uint64_t ) )
+  {
+    const byte *data = in->data + in->pos;
+    bit_reader_refill( br, &data );
+    in->pos = data - in->data;
+    return;
+  }
+
+  while( br->count <= BIT_READER_REFILL_BITS && in->pos < in->size )
+    bit_reader_push( br, in->data[in->pos++], BITS_IN_BYTE );
+}
+
+
+/**
+ * Decodes a symbol, and the extra bits of its bucket if the symbol is a bucket code.
+ * Nothing is consumed unless the whole symbol is available.
+ * @param  hc     The Huffman codec.
+ * @param  in     Encoded data.
+ * @param  table  Decoding table of the alphabet.
+ * @param  first  First symbol of the alphabet that is a bucket code.
+ * @param  symbol The symbol read.
+ * @param  value  The value of the bucket (if the symbol is a bucket code).
+ * @return        \c codec_token_end if the symbol was read, or why it wasn't.
+ */
+static inline codec_token_t _read_symbol( huffman_codec_t *hc,
+                                          codec_input_t *in,
+                                          const huffman_entry_t *table,
+                                          size_t first,
+                                          size_t *symbol,
+                                          size_t *value )
+{
+  bit_reader_t *br = &hc->reader;
+
+  _fill( hc, in );
+
+  huffman_entry_t entry = table[bit_reader_peek( br, MAX_CODE_BITS )];
+  size_t bucket = entry.symbol - first;
+  size_t extra_bits = ( entry.symbol >= first ) ? bucket_extra_bits( bucket ) : 0;
+
+  if( entry.len == 0 || entry.len + extra_bits > br->count )
+  {
+    /* a full table index not starting with a code is not valid */
+    if( entry.len == 0 && br->count >= MAX_CODE_BITS )
+      return codec_token_error;
+
+    return _starved( in );
+  }
+
+  bit_reader_consume( br, entry.len );
+  *symbol = entry.symbol;
+
+  if( entry.symbol >= first )
+  {
+    *value = bucket_base( bucket ) + bit_reader_peek( br, extra_bits );
+    bit_reader_consume( br, extra_bits );
+  }
+
+  return codec_token_end;
+}
+
+
+/**
+ * Reads the code lengths of the alphabet in \c reading.
+ * @param  hc The Huffman codec.
+ * @param  in Encoded data.
+ * @return    \c codec_token_end if all the lengths were read, or why they weren't.
+ */
+static codec_token_t _read_lengths( huffman_codec_t *hc, codec_input_t *in )
+{
+  bit_reader_t *br = &hc->reader;
+  huffman_code_t *code = hc->reading;
+
+  while( hc->symbol < code->num_symbols )
+  {
+    _fill( hc, in );
+    if( br->count < CODE_LEN_BITS )
+      return _starved( in );
+
+    size_t len = bit_reader_peek( br, CODE_LEN_BITS );
+    size_t run = 1;
+
+    if( len == 0 )
+    {
+      if( br->count < CODE_LEN_BITS + ZERO_RUN_BITS )
+        return _starved( in );
+
+      run += bit_reader_peek( br, CODE_LEN_BITS + ZERO_RUN_BITS ) & ( ( 1U << ZERO_RUN_BITS ) - 1 );
+      bit_reader_consume( br, ZERO_RUN_BITS );
+    }
+
+    bit_reader_consume( br, CODE_LEN_BITS );
+
+    if( len > MAX_CODE_BITS || run > code->num_symbols - hc->symbol )
+      return codec_token_error;
+
+    memset( code->lengths + hc->symbol, len, run );
+    hc->symbol += run;
+  }
+
+  return codec_token_end;
+}
+
+
+/**
+ * Decodes the next token.
+ * @param  codec The codec instance.
+ * @param  in    Encoded data.
+ * @param  c     The literal read.
+ * @param  m     The match read.
+ * @return       The kind of token read, or why none could be read.
+ */
+static codec_token_t _read( codec_t *codec, codec_input_t *in, byte *c, match_t *m )
+{
+  huffman_codec_t *hc = codec->_int_data;
+  bit_reader_t *br = &hc->reader;
+  codec_token_t token;
+  size_t symbol, value;
+
+  while( true )
+  {
+    switch( hc->state )
+    {
+      case huffman_state_block:
+        _fill( hc, in );
+        if( br->count < 1 + LITLEN_COUNT_BITS )
+          return _starved( in );
+
+        hc->last_block = bit_reader_peek( br, 1 );
+        hc->litlen.num_symbols = bit_reader_peek( br, 1 + LITLEN_COUNT_BITS ) &
+                                 ( ( 1U << LITLEN_COUNT_BITS ) - 1 );
+        bit_reader_consume( br, 1 + LITLEN_COUNT_BITS );
+
+        /* the end of block symbol must be there */
+        if( hc->litlen.num_symbols <= END_OF_BLOCK ||
+            hc->litlen.num_symbols > hc->max_litlen_symbols )
+          return codec_token_error;
+
+        hc->reading = &hc->litlen;
+        hc->symbol = 0;
+        hc->state = huffman_state_lengths;
+        break;
+
+      case huffman_state_lengths:
+        token = _read_lengths( hc, in );
+        if( token != codec_token_end )
+          return token;
+
+        if( hc->reading == &hc->litlen )
+          hc->state = huffman_state_offset_count;
+        else if( _build_table( &hc->litlen, hc->litlen_table ) &&
+                 _build_table( &hc->offset, hc->offset_table ) )
+          hc->state = huffman_state_tokens;
+        else
+          return codec_token_error;
+        break;
+
+      case huffman_state_offset_count:
+        _fill( hc, in );
+        if( br->count < OFFSET_COUNT_BITS )
+          return _starved( in );
+
+        hc->offset.num_symbols = bit_reader_peek( br, OFFSET_COUNT_BITS );
+        bit_reader_consume( br, OFFSET_COUNT_BITS );
+
+        if( hc->offset.num_symbols > hc->max_offset_symbols )
+          return codec_token_error;
+
+        hc->reading = &hc->offset;
+        hc->symbol = 0;
+        hc->state = huffman_state_lengths;
+        break;
+
+      case huffman_state_tokens:
+        token = _read_symbol( hc, in, hc->litlen_table, FIRST_LENGTH_SYMBOL, &symbol, &value );
+        if( token != codec_token_end )
+          return token;
+
+        if( symbol < END_OF_BLOCK )
+        {
+          *c = symbol;
+          return codec_token_literal;
+        }
+
+        if( symbol == END_OF_BLOCK )
+        {
+          hc->state = hc->last_block ? huffman_state_done : huffman_state_block;
+          break;
+        }
+
+        if( value > hc->max_match_len - hc->min_match_len )
+          return codec_token_error;
+
+        hc->match_len = value + hc->min_match_len;
+        hc->state = huffman_state_offset;
+        break;
+
+      case huffman_state_offset:
+        token = _read_symbol( hc, in, hc->offset_table, 0, &symbol, &value );
+        if( token != codec_token_end )
+          return token;
+
+        hc->state = huffman_state_tokens;
+        m->pos = value;
+        m->len = hc->match_len;
+        return codec_token_match;
+
+      case huffman_state_done:
+        return codec_token_end;
+    }
+  }
+}
+
+
+/**
+ * Finishes the encoded output.
+ * @param  codec The codec instance.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _close( codec_t *codec )
+{
+  huffman_codec_t *hc = codec->_int_data;
+
+  if( !_write_block( hc, true ) )
+    return false;
+
+  /* the last byte is padded with zeros */
+  if( hc->writer.count > 0 )
+  {
+    byte b = bit_writer_take_byte( &hc->writer );
+    if( !sink_write( hc->sink, &b, sizeof( b ) ) )
+      return false;
+  }
+
+  return sink_flush( hc->sink );
+}
+
+
+/**
+ * Destroys the codec releasing all the taken resources.
+ * @param codec Codec to destroy.
+ */
+static void _destroy( codec_t *codec )
+{
+  huffman_codec_t *hc = codec->_int_data;
+
+  if( hc->sink == &hc->own_sink )
+    sink_release( hc->sink );
+
+  free( hc->tokens );
+  free( codec );
+}
+
+
+/**
+ * Creates a new Huffman codec writing into a sink.
+ * The tokens are encoded in blocks of \c HUFFMAN_CODEC_BLOCK_SIZE, with the literals and match
+ * lengths in an alphabet and the match offsets in another (split in buckets like in deflate), and
+ * codes built for each block.
+ * @param  sink          Sink where the encoded data is written (\c NULL if only used to decode).
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *huffman_codec_create_sink( sink_t *sink,
+                                    size_t min_match_len,
+                                    size_t max_match_len,
+                                    size_t max_pos )
+{
+  /* input checks (the buckets take up to 32 bits) */
+  if( min_match_len == 0 || min_match_len > max_match_len )
+    return NULL;
+  if( max_match_len > UINT32_MAX || max_pos < 1 || max_pos - 1 > UINT32_MAX )
+    return NULL;
+
+  NEW_CODEC( huffman_codec_t );
+
+  ic->sink = sink;
+  ic->min_match_len = min_match_len;
+  ic->max_match_len = max_match_len;
+  ic->max_litlen_symbols = FIRST_LENGTH_SYMBOL + bucket_code( max_match_len - min_match_len ) + 1;
+  ic->max_offset_symbols = bucket_code( max_pos - 1 ) + 1;
+  ic->state = huffman_state_block;
+  bit_reader_init( &ic->reader );
+  bit_writer_init( &ic->writer );
+
+  /* the tokens are only buffered to encode */
+  if( sink != NULL )
+  {
+    ic->tokens = malloc( HUFFMAN_CODEC_BLOCK_SIZE * sizeof( huffman_token_t ) );
+    if( ic->tokens == NULL )
+    {
+      free( buf );
+      return NULL;
+    }
+  }
+
+  return codec;
+}
+
+
+/**
+ * Creates a new Huffman codec.
+ * The encoded data is output through \a cb in chunks of \c HUFFMAN_CODEC_BUFFER_SIZE bytes, and
+ * when the codec is closed.
+ * @param  cb            Callback used to output data (\c NULL if only used to decode).
+ * @param  cb_ctx        Context passed to \a cb.
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *huffman_codec_create( codec_out_cb_t cb,
+                               void *cb_ctx,
+                               size_t min_match_len,
+                               size_t max_match_len,
+                               size_t max_pos )
+{
+  codec_t *codec = huffman_codec_create_sink( NULL, min_match_len, max_match_len, max_pos );
+  if( codec == NULL || cb == NULL )
+    return codec;
+
+  huffman_codec_t *hc = codec->_int_data;
+  hc->tokens = malloc( HUFFMAN_CODEC_BLOCK_SIZE * sizeof( huffman_token_t ) );
+  if( hc->tokens == NULL ||
+      !sink_init_callback( &hc->own_sink, cb, cb_ctx, HUFFMAN_CODEC_BUFFER_SIZE ) )
+  {
+    codec->destroy( codec );
+    return NULL;
+  }
+
+  hc->sink = &hc->own_sink;
+
+  return codec;
+}
@@ -0,0 +1,33 @@
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+
+/* include area */
+#include "codec.h"
+
+
+/* constants */
+
+/** Default size of the output buffer of the Huffman codec. */
+#define HUFFMAN_CODEC_BUFFER_SIZE 65536
+
+/** Number of tokens of a block (the codes are built for each block). */
+#define HUFFMAN_CODEC_BLOCK_SIZE 32768
+
+/** Maximum length of a code (the deepest codes of a block are shortened to it). */
+#define HUFFMAN_CODEC_MAX_CODE_BITS 12U
+
+
+/* prototypes */
+codec_t *huffman_codec_create( codec_out_cb_t cb,
+                               void *cb_ctx,
+                               size_t min_match_len,
+                               size_t max_match_len,
+                               size_t max_pos );
+codec_t *huffman_codec_create_sink( sink_t *sink,
+                                    size_t min_match_len,
+                                    size_t max_match_len,
+                                    size_t max_pos );
+
+
+#endif
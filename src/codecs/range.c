@@ -0,0 +1,981 @@
+/* include area */
+#include <string.h>
+#include "bucket.h"
+#include "range.h"
+#include "../math2.h"
+
+
+/** Constants */
+#define BITS_IN_BYTE 8U
+
+/** Number of bits of the probabilities (of a bit being zero). */
+#define PROB_BITS 11U
+
+/** Initial probability (a half). */
+#define PROB_INIT ( 1U << ( PROB_BITS - 1 ) )
+
+/** How fast the probabilities adapt (they move 1/32 of the way on each bit). */
+#define MOVE_BITS 5U
+
+/** The range is renormalized when it gets below this. */
+#define RANGE_TOP ( 1U << 24 )
+
+/** Number of bytes output when the encoder is flushed (read by the decoder before the first
+ *  bit). */
+#define FLUSH_SIZE 5U
+
+/** Number of previous tokens (whether they were matches) the literal/match flag depends on. */
+#define HISTORY_BITS 3U
+
+/** Number of low bits of the position in the output the flag and the short lengths depend on. */
+#define POS_STATE_BITS 2U
+
+/** Number of high bits of the last literal the bits of a literal depend on. */
+#define LITERAL_CONTEXT_BITS 3U
+
+/** Number of bits of the short match lengths (the ones with their own tree). */
+#define LOW_LEN_BITS 3U
+
+/** Number of bits of a bucket code. */
+#define BUCKET_CODE_BITS 6U
+
+/** Number of match lengths the offset buckets depend on (the longer ones share a tree). */
+#define LEN_CONTEXTS 4U
+
+/** Number of low extra bits of the offsets coded with their own tree (the others are sent as
+ *  they are). */
+#define ALIGN_BITS 4U
+
+/** First offset bucket whose extra bits are not all coded with a tree of its own. */
+#define FIRST_ALIGNED_BUCKET ( 2 * ( ALIGN_BITS + 2 ) )
+
+/** Maximum number of bytes a token takes (it's less than one per bit). */
+#define MAX_TOKEN_SIZE 128U
+
+/** Number of fraction bits of the prices (they're computed in sixteenths of a bit). */
+#define PRICE_FRACTION_BITS 4U
+
+/** Number of low bits of the probabilities dropped to look up their prices. */
+#define PRICE_REDUCE_BITS 4U
+
+
+/*
+ * The tokens are encoded bit by bit with an adaptive binary range coder (like in LZMA), every bit
+ * with its own probability depending on its context:
+ *
+ *   literal/match flag: depends on whether the last 3 tokens were matches, and on the low bits of
+ *                       the position in the output.
+ *   literal: bit tree depending on the last literal (the codec doesn't know the bytes of the
+ *            matches, so it stands for the previous byte).
+ *   match length: flag choosing the short lengths (3 bit tree depending on the position in the
+ *                 output), then another one choosing the next 8 lengths (another 3 bit tree), or
+ *                 else the bucket code of the length (6 bit tree) and its extra bits.
+ *   match offset: bucket code (6 bit tree depending on the length), then its extra bits, with the
+ *                 low 4 bits coded with a reverse bit tree (of its own for the small buckets).
+ *
+ * The stream ends with a match whose position is the maximum position plus one, and the bytes
+ * left in the encoder.
+ */
+
+
+/** Data types */
+
+/** Probabilities of all the bits encoded (only made of probabilities). */
+typedef struct
+{
+  /** Literal/match flag. */
+  uint16_t is_match[1 << HISTORY_BITS][1 << POS_STATE_BITS];
+
+  /** Literal bits. */
+  uint16_t literal[1 << LITERAL_CONTEXT_BITS][1 << BITS_IN_BYTE];
+
+  /** Flag set if the length is not a short one. */
+  uint16_t len_choice;
+
+  /** Flag set if the length is not one of the 8 after the short ones. */
+  uint16_t len_choice2;
+
+  /** Short lengths. */
+  uint16_t len_low[1 << POS_STATE_BITS][1 << LOW_LEN_BITS];
+
+  /** The 8 lengths after the short ones. */
+  uint16_t len_mid[1 << LOW_LEN_BITS];
+
+  /** Bucket code of the longer lengths. */
+  uint16_t len_high[1 << BUCKET_CODE_BITS];
+
+  /** Bucket code of the offsets. */
+  uint16_t offset_bucket[LEN_CONTEXTS][1 << BUCKET_CODE_BITS];
+
+  /** Extra bits of the small offset buckets (each one with its own tree). */
+  uint16_t offset_extra[FIRST_ALIGNED_BUCKET][1 << ALIGN_BITS];
+
+  /** Low extra bits of the larger offset buckets. */
+  uint16_t offset_align[1 << ALIGN_BITS];
+
+} range_model_t;
+
+
+/** Parts of the stream, in the order they are decoded. */
+typedef enum
+{
+  range_state_init,
+  range_state_tokens,
+  range_state_done,
+
+} range_state_t;
+
+
+/** Range codec internal data. */
+typedef struct
+{
+  /** Probabilities of the bits. */
+  range_model_t model;
+
+  /** Where the encoded data is written (\c NULL if the codec is only used to decode). */
+  sink_t *sink;
+
+  /** Sink owned by the codec (when created with a callback). */
+  sink_t own_sink;
+
+  /** Minimum match length. */
+  size_t min_match_len;
+
+  /** Maximum match length. */
+  size_t max_match_len;
+
+  /** Maximum match position (the position after it ends the stream). */
+  size_t max_pos;
+
+  /** Whether the last tokens were matches (the last one in the lowest bit). */
+  size_t history;
+
+  /** Last literal. */
+  byte last_literal;
+
+  /** Number of bytes output by the tokens (its low bits are part of the contexts). */
+  size_t out_pos;
+
+  /** Size of the current range. */
+  uint32_t range;
+
+  /** Low end of the range (encoder only, with the carry in the 33rd bit). */
+  uint64_t low;
+
+  /** Byte of \c low not output yet, since a carry may change it (encoder only). */
+  byte cache;
+
+  /** Number of bytes not output yet (\c cache followed by 0xff bytes, encoder only). */
+  size_t cache_size;
+
+  /** Whether the output failed (encoder only). */
+  bool failed;
+
+  /** Position of the encoded data within the range (decoder only). */
+  uint32_t code;
+
+  /** Part of the stream being decoded. */
+  range_state_t state;
+
+  /** Next byte of the encoded data being decoded. */
+  const byte *next;
+
+  /** End of the encoded data being decoded. */
+  const byte *end;
+
+  /** Whether the decoder needed bytes past \c end. */
+  bool overrun;
+
+  /** Input left over from the previous calls, followed by a copy of the next input (used when
+   *  there's not enough input for a whole token). */
+  byte tail[2 * MAX_TOKEN_SIZE];
+
+  /** Number of bytes of \c tail left over from the previous calls. */
+  size_t tail_len;
+
+  /** Price of a bit for each reduced probability, in sixteenths of a bit. */
+  uint16_t prices[1 << ( PROB_BITS - PRICE_REDUCE_BITS )];
+
+} range_codec_t;
+
+
+/**
+ * Outputs a byte of the encoded data.
+ * @param rc The range codec.
+ * @param b  Byte to output.
+ */
+static inline void _out_byte( range_codec_t *rc, byte b )
+{
+  byte *out = sink_reserve( rc->sink, 1 );
+  if( out == NULL )
+  {
+    rc->failed = true;
+    return;
+  }
+
+  *out = b;
+  sink_commit( rc->sink, 1 );
+}
+
+
+/**
+ * Shifts the top byte out of \c low, outputting the bytes that a carry can't change anymore.
+ * @param rc The range codec.
+ */
+static void _shift_low( range_codec_t *rc )
+{
+  if( ( uint32_t )rc->low < 0xff000000U || ( rc->low >> 32 ) != 0 )
+  {
+    byte carry = rc->low >> 32;
+    byte b = rc->cache;
+
+    do
+    {
+      _out_byte( rc, b + carry );
+      b = 0xff;
+    }
+    while( --rc->cache_size != 0 );
+
+    rc->cache = rc->low >> 24;
+  }
+
+  rc->cache_size++;
+  rc->low = ( rc->low & 0x00ffffffU ) << BITS_IN_BYTE;
+}
+
+
+/**
+ * Encodes a bit, adapting its probability.
+ * @param rc   The range codec.
+ * @param prob Probability of the bit being zero.
+ * @param bit  The bit.
+ */
+static inline void _encode_bit( range_codec_t *rc, uint16_t *prob, size_t bit )
+{
+  uint32_t bound = ( rc->range >> PROB_BITS ) * *prob;
+
+  if( bit == 0 )
+  {
+    rc->range = bound;
+    *prob += ( ( 1U << PROB_BITS ) - *prob ) >> MOVE_BITS;
+  }
+  else
+  {
+    rc->low += bound;
+    rc->range -= bound;
+    *prob -= *prob >> MOVE_BITS;
+  }
+
+  while( rc->range < RANGE_TOP )
+  {
+    rc->range <<= BITS_IN_BYTE;
+    _shift_low( rc );
+  }
+}
+
+
+/**
+ * Encodes bits with a probability of a half, the most significant first.
+ * @param rc       The range codec.
+ * @param value    Bits.
+ * @param num_bits Number of bits.
+ */
+static inline void _encode_direct( range_codec_t *rc, size_t value, size_t num_bits )
+{
+  while( num_bits-- > 0 )
+  {
+    rc->range >>= 1;
+    if( ( value >> num_bits ) & 1 )
+      rc->low += rc->range;
+
+    while( rc->range < RANGE_TOP )
+    {
+      rc->range <<= BITS_IN_BYTE;
+      _shift_low( rc );
+    }
+  }
+}
+
+
+/**
+ * Encodes a value with a bit tree, the most significant bit first (each bit depends on the ones
+ * before it).
+ * @param rc       The range codec.
+ * @param probs    Probabilities of the tree (the root at 1).
+ * @param value    Value.
+ * @param num_bits Number of bits of the value.
+ */
+static inline void _encode_tree( range_codec_t *rc, uint16_t *probs, size_t value, size_t num_bits )
+{
+  size_t node = 1;
+
+  while( num_bits-- > 0 )
+  {
+    size_t bit = ( value >> num_bits ) & 1;
+    _encode_bit( rc, &probs[node], bit );
+    node = ( node << 1 ) | bit;
+  }
+}
+
+
+/**
+ * Encodes a value with a bit tree, the least significant bit first.
+ * @param rc       The range codec.
+ * @param probs    Probabilities of the tree (the root at 1).
+ * @param value    Value.
+ * @param num_bits Number of bits of the value.
+ */
+static inline void _encode_reverse_tree( range_codec_t *rc,
+                                         uint16_t *probs,
+                                         size_t value,
+                                         size_t num_bits )
+{
+  size_t node = 1;
+
+  while( num_bits-- > 0 )
+  {
+    size_t bit = value & 1;
+    _encode_bit( rc, &probs[node], bit );
+    node = ( node << 1 ) | bit;
+    value >>= 1;
+  }
+}
+
+
+/**
+ * Returns the price of a bit.
+ * @param  rc   The range codec.
+ * @param  prob Probability of the bit being zero.
+ * @param  bit  The bit.
+ * @return      Price in sixteenths of a bit.
+ */
+static inline size_t _price_bit( const range_codec_t *rc, uint16_t prob, size_t bit )
+{
+  return rc->prices[( bit ? ( 1U << PROB_BITS ) - prob : prob ) >> PRICE_REDUCE_BITS];
+}
+
+
+/**
+ * Returns the price of a value encoded with a bit tree.
+ * @param  rc       The range codec.
+ * @param  probs    Probabilities of the tree.
+ * @param  value    Value.
+ * @param  num_bits Number of bits of the value.
+ * @return          Price in sixteenths of a bit.
+ */
+static inline size_t _price_tree( const range_codec_t *rc,
+                                  const uint16_t *probs,
+                                  size_t value,
+                                  size_t num_bits )
+{
+  size_t node = 1, price = 0;
+
+  while( num_bits-- > 0 )
+  {
+    size_t bit = ( value >> num_bits ) & 1;
+    price += _price_bit( rc, probs[node], bit );
+    node = ( node << 1 ) | bit;
+  }
+
+  return price;
+}
+
+
+/**
+ * Returns the price of a value encoded with a reverse bit tree.
+ * @param  rc       The range codec.
+ * @param  probs    Probabilities of the tree.
+ * @param  value    Value.
+ * @param  num_bits Number of bits of the value.
+ * @return          Price in sixteenths of a bit.
+ */
+static inline size_t _price_reverse_tree( const range_codec_t *rc,
+                                          const uint16_t *probs,
+                                          size_t value,
+                                          size_t num_bits )
+{
+  size_t node = 1, price = 0;
+
+  while( num_bits-- > 0 )
+  {
+    size_t bit = value & 1;
+    price += _price_bit( rc, probs[node], bit );
+    node = ( node << 1 ) | bit;
+    value >>= 1;
+  }
+
+  return price;
+}
+
+
+/**
+ * Updates the contexts after a token.
+ * @param rc       The range codec.
+ * @param is_match Whether the token is a match.
+ * @param len      Number of bytes output by the token.
+ */
+static inline void _update_context( range_codec_t *rc, size_t is_match, size_t len )
+{
+  rc->history = ( ( rc->history << 1 ) | is_match ) & ( ( 1U << HISTORY_BITS ) - 1 );
+  rc->out_pos += len;
+}
+
+
+/**
+ * Returns the position state (the low bits of the position in the output).
+ * @param  rc The range codec.
+ * @return    Position state.
+ */
+static inline size_t _pos_state( const range_codec_t *rc )
+{
+  return rc->out_pos & ( ( 1U << POS_STATE_BITS ) - 1 );
+}
+
+
+/**
+ * Returns the literal probabilities for the current context.
+ * @param  rc The range codec.
+ * @return    Probabilities of the literal bit tree.
+ */
+static inline uint16_t *_literal_probs( range_codec_t *rc )
+{
+  return rc->model.literal[rc->last_literal >> ( BITS_IN_BYTE - LITERAL_CONTEXT_BITS )];
+}
+
+
+/**
+ * Writes an encoded literal.
+ * @param  codec The codec instance.
+ * @param  c     Character to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_literal( codec_t *codec, unsigned char c )
+{
+  range_codec_t *rc = codec->_int_data;
+
+  _encode_bit( rc, &rc->model.is_match[rc->history][_pos_state( rc )], 0 );
+  _encode_tree( rc, _literal_probs( rc ), c, BITS_IN_BYTE );
+
+  rc->last_literal = c;
+  _update_context( rc, 0, 1 );
+
+  return !rc->failed;
+}
+
+
+/**
+ * Encodes a match (or the end of the stream).
+ * @param rc  The range codec.
+ * @param len Match length minus the minimum.
+ * @param pos Match position.
+ */
+static void _encode_match( range_codec_t *rc, size_t len, size_t pos )
+{
+  range_model_t *model = &rc->model;
+  size_t pos_state = _pos_state( rc );
+
+  _encode_bit( rc, &model->is_match[rc->history][pos_state], 1 );
+
+  /* length */
+  if( len < ( 1U << LOW_LEN_BITS ) )
+  {
+    _encode_bit( rc, &model->len_choice, 0 );
+    _encode_tree( rc, model->len_low[pos_state], len, LOW_LEN_BITS );
+  }
+  else if( len < ( 2U << LOW_LEN_BITS ) )
+  {
+    _encode_bit( rc, &model->len_choice, 1 );
+    _encode_bit( rc, &model->len_choice2, 0 );
+    _encode_tree( rc, model->len_mid, len - ( 1U << LOW_LEN_BITS ), LOW_LEN_BITS );
+  }
+  else
+  {
+    size_t high = len - ( 2U << LOW_LEN_BITS );
+    size_t bucket = bucket_code( high );
+
+    _encode_bit( rc, &model->len_choice, 1 );
+    _encode_bit( rc, &model->len_choice2, 1 );
+    _encode_tree( rc, model->len_high, bucket, BUCKET_CODE_BITS );
+    _encode_direct( rc, high - bucket_base( bucket ), bucket_extra_bits( bucket ) );
+  }
+
+  /* offset */
+  size_t bucket = bucket_code( pos );
+  size_t extra_bits = bucket_extra_bits( bucket );
+  size_t extra = pos - bucket_base( bucket );
+
+  _encode_tree( rc, model->offset_bucket[MIN( len, LEN_CONTEXTS - 1 )], bucket, BUCKET_CODE_BITS );
+
+  if( bucket < FIRST_ALIGNED_BUCKET )
+    _encode_reverse_tree( rc, model->offset_extra[bucket], extra, extra_bits );
+  else
+  {
+    _encode_direct( rc, extra >> ALIGN_BITS, extra_bits - ALIGN_BITS );
+    _encode_reverse_tree( rc, model->offset_align, extra, ALIGN_BITS );
+  }
+}
+
+
+/**
+ * Writes an encoded match.
+ * @param  codec The codec instance.
+ * @param  m     The match to write.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _write_match( codec_t *codec, match_t m )
+{
+  range_codec_t *rc = codec->_int_data;
+
+  _encode_match( rc, m.len - rc->min_match_len, m.pos );
+  _update_context( rc, 1, m.len );
+
+  return !rc->failed;
+}
+
+
+/**
+ * Returns the size of an encoded literal (estimated with the current probabilities).
+ * @param  codec The codec instance.
+ * @param  c     Character to encode.
+ * @return       Number of bits.
+ */
+static size_t _price_literal( const codec_t *codec, unsigned char c )
+{
+  const range_codec_t *rc = codec->_int_data;
+  const range_model_t *model = &rc->model;
+
+  size_t price = _price_bit( rc, model->is_match[rc->history][_pos_state( rc )], 0 ) +
+                 _price_tree( rc,
+                              model->literal[rc->last_literal >> ( BITS_IN_BYTE - LITERAL_CONTEXT_BITS )],
+                              c,
+                              BITS_IN_BYTE );
+
+  return ( price + ( 1U << ( PRICE_FRACTION_BITS - 1 ) ) ) >> PRICE_FRACTION_BITS;
+}
+
+
+/**
+ * Returns the size of an encoded match (estimated with the current probabilities).
+ * @param  codec The codec instance.
+ * @param  m     Match to encode.
+ * @param  pos   Stream offset of the match.
+ * @return       Number of bits.
+ */
+static size_t _price_match( const codec_t *codec, match_t m, uint64_t pos )
+{
+  const range_codec_t *rc = codec->_int_data;
+  const range_model_t *model = &rc->model;
+  size_t pos_state = _pos_state( rc );
+  size_t len = m.len - rc->min_match_len;
+
+  size_t price = _price_bit( rc, model->is_match[rc->history][pos_state], 1 );
+
+  if( len < ( 1U << LOW_LEN_BITS ) )
+    price += _price_bit( rc, model->len_choice, 0 ) +
+             _price_tree( rc, model->len_low[pos_state], len, LOW_LEN_BITS );
+  else if( len < ( 2U << LOW_LEN_BITS ) )
+    price += _price_bit( rc, model->len_choice, 1 ) +
+             _price_bit( rc, model->len_choice2, 0 ) +
+             _price_tree( rc, model->len_mid, len - ( 1U << LOW_LEN_BITS ), LOW_LEN_BITS );
+  else
+  {
+    size_t bucket = bucket_code( len - ( 2U << LOW_LEN_BITS ) );
+    price += _price_bit( rc, model->len_choice, 1 ) +
+             _price_bit( rc, model->len_choice2, 1 ) +
+             _price_tree( rc, model->len_high, bucket, BUCKET_CODE_BITS ) +
+             ( bucket_extra_bits( bucket ) << PRICE_FRACTION_BITS );
+  }
+
+  size_t bucket = bucket_code( m.pos );
+  size_t extra = m.pos - bucket_base( bucket );
+
+  price += _price_tree( rc, model->offset_bucket[MIN( len, LEN_CONTEXTS - 1 )], bucket, BUCKET_CODE_BITS );
+
+  if( bucket < FIRST_ALIGNED_BUCKET )
+    price += _price_reverse_tree( rc, model->offset_extra[bucket], extra, bucket_extra_bits( bucket ) );
+  else
+    price += ( ( bucket_extra_bits( bucket ) - ALIGN_BITS ) << PRICE_FRACTION_BITS ) +
+             _price_reverse_tree( rc, model->offset_align, extra, ALIGN_BITS );
+
+  return ( price + ( 1U << ( PRICE_FRACTION_BITS - 1 ) ) ) >> PRICE_FRACTION_BITS;
+}
+
+
+/**
+ * Shifts the next byte of the encoded data into the code.
+ * @param rc The range codec.
+ */
+static inline void _shift_code( range_codec_t *rc )
+{
+  rc->range <<= BITS_IN_BYTE;
+  rc->code <<= BITS_IN_BYTE;
+
+  if( rc->next < rc->end )
+    rc->code |= *rc->next++;
+  else
+    rc->overrun = true;
+}
+
+
+/**
+ * Decodes a bit, adapting its probability.
+ * @param  rc   The range codec.
+ * @param  prob Probability of the bit being zero.
+ * @return      The bit.
+ */
+static inline size_t _decode_bit( range_codec_t *rc, uint16_t *prob )
+{
+  uint32_t bound = ( rc->range >> PROB_BITS ) * *prob;
+  size_t bit;
+
+  if( rc->code < bound )
+  {
+    rc->range = bound;
+    *prob += ( ( 1U << PROB_BITS ) - *prob ) >> MOVE_BITS;
+    bit = 0;
+  }
+  else
+  {
+    rc->code -= bound;
+    rc->range -= bound;
+    *prob -= *prob >> MOVE_BITS;
+    bit = 1;
+  }
+
+  while( rc->range < RANGE_TOP )
+    _shift_code( rc );
+
+  return bit;
+}
+
+
+/**
+ * Decodes bits with a probability of a half, the most significant first.
+ * @param  rc       The range codec.
+ * @param  num_bits Number of bits.
+ * @return          The bits.
+ */
+static inline size_t _decode_direct( range_codec_t *rc, size_t num_bits )
+{
+  size_t value = 0;
+
+  while( num_bits-- > 0 )
+  {
+    rc->range >>= 1;
+
+    size_t bit = ( rc->code >= rc->range );
+    if( bit )
+      rc->code -= rc->range;
+    value = ( value << 1 ) | bit;
+
+    while( rc->range < RANGE_TOP )
+      _shift_code( rc );
+  }
+
+  return value;
+}
+
+
+/**
+ * Decodes a value encoded with a bit tree.
+ * @param  rc       The range codec.
+ * @param  probs    Probabilities of the tree.
+ * @param  num_bits Number of bits of the value.
+ * @return          The value.
+ */
+static inline size_t _decode_tree( range_codec_t *rc, uint16_t *probs, size_t num_bits )
+{
+  size_t node = 1;
+
+  for( size_t i = 0; i < num_bits; i++ )
+    node = ( node << 1 ) | _decode_bit( rc, &probs[node] );
+
+  return node - ( ( size_t )1 << num_bits );
+}
+
+
+/**
+ * Decodes a value encoded with a reverse bit tree.
+ * @param  rc       The range codec.
+ * @param  probs    Probabilities of the tree.
+ * @param  num_bits Number of bits of the value.
+ * @return          The value.
+ */
+static inline size_t _decode_reverse_tree( range_codec_t *rc, uint16_t *probs, size_t num_bits )
+{
+  size_t node = 1, value = 0;
+
+  for( size_t i = 0; i < num_bits; i++ )
+  {
+    size_t bit = _decode_bit( rc, &probs[node] );
+    node = ( node << 1 ) | bit;
+    value |= bit << i;
+  }
+
+  return value;
+}
+
+
+/**
+ * Decodes the next token from \c next (there must be enough bytes for it unless the input is
+ * over).
+ * @param  rc The range codec.
+ * @param  c  The literal read.
+ * @param  m  The match read.
+ * @return    The kind of token read, \c codec_token_end at the end of the stream, or
+ *            \c codec_token_error if the data is not valid.
+ */
+static codec_token_t _decode_token( range_codec_t *rc, byte *c, match_t *m )
+{
+  range_model_t *model = &rc->model;
+  size_t pos_state = _pos_state( rc );
+
+  if( rc->state == range_state_init )
+  {
+    /* the first byte is always zero (the encoder outputs its empty cache first) */
+    if( rc->next == rc->end || *rc->next++ != 0 )
+      return codec_token_error;
+
+    rc->range = UINT32_MAX;
+    for( size_t i = 1; i < FLUSH_SIZE; i++ )
+      _shift_code( rc );
+
+    rc->range = UINT32_MAX;
+    rc->state = range_state_tokens;
+  }
+
+  if( _decode_bit( rc, &model->is_match[rc->history][pos_state] ) == 0 )
+  {
+    *c = _decode_tree( rc, _literal_probs( rc ), BITS_IN_BYTE );
+
+    rc->last_literal = *c;
+    _update_context( rc, 0, 1 );
+
+    return codec_token_literal;
+  }
+
+  /* length */
+  size_t len;
+
+  if( _decode_bit( rc, &model->len_choice ) == 0 )
+    len = _decode_tree( rc, model->len_low[pos_state], LOW_LEN_BITS );
+  else if( _decode_bit( rc, &model->len_choice2 ) == 0 )
+    len = ( 1U << LOW_LEN_BITS ) + _decode_tree( rc, model->len_mid, LOW_LEN_BITS );
+  else
+  {
+    size_t bucket = _decode_tree( rc, model->len_high, BUCKET_CODE_BITS );
+    len = ( 2U << LOW_LEN_BITS ) + bucket_base( bucket ) +
+          _decode_direct( rc, bucket_extra_bits( bucket ) );
+  }
+
+  /* offset */
+  size_t bucket = _decode_tree( rc, model->offset_bucket[MIN( len, LEN_CONTEXTS - 1 )], BUCKET_CODE_BITS );
+  size_t extra_bits = bucket_extra_bits( bucket );
+  size_t pos = bucket_base( bucket );
+
+  if( bucket < FIRST_ALIGNED_BUCKET )
+    pos += _decode_reverse_tree( rc, model->offset_extra[bucket], extra_bits );
+  else
+  {
+    pos += _decode_direct( rc, extra_bits - ALIGN_BITS ) << ALIGN_BITS;
+    pos += _decode_reverse_tree( rc, model->offset_align, ALIGN_BITS );
+  }
+
+  /* the position after the maximum one ends the stream */
+  if( pos == rc->max_pos && len == 0 )
+  {
+    rc->state = range_state_done;
+    return codec_token_end;
+  }
+
+  if( pos >= rc->max_pos || len > rc->max_match_len - rc->min_match_len )
+    return codec_token_error;
+
+  m->len = len + rc->min_match_len;
+  m->pos = pos;
+  _update_context( rc, 1, m->len );
+
+  return codec_token_match;
+}
+
+
+/**
+ * Decodes the next token.
+ * The token is decoded straight from the input when it surely fits in it. Otherwise the input is
+ * kept in a buffer of the codec until there's enough of it.
+ * @param  codec The codec instance.
+ * @param  in    Encoded data.
+ * @param  c     The literal read.
+ * @param  m     The match read.
+ * @return       The kind of token read, or why none could be read.
+ */
+static codec_token_t _read( codec_t *codec, codec_input_t *in, byte *c, match_t *m )
+{
+  range_codec_t *rc = codec->_int_data;
+  size_t avail = in->size - in->pos;
+  bool direct = ( rc->tail_len == 0 && ( avail >= MAX_TOKEN_SIZE || in->last ) );
+
+  if( rc->state == range_state_done )
+    return codec_token_end;
+
+  if( direct )
+  {
+    rc->next = in->data + in->pos;
+    rc->end = in->data + in->size;
+  }
+  else
+  {
+    size_t n = MIN( avail, MAX_TOKEN_SIZE );
+    memcpy( rc->tail + rc->tail_len, in->data + in->pos, n );
+
+    /* all the input is kept until there's enough for a token */
+    if( rc->tail_len + n < MAX_TOKEN_SIZE && !in->last )
+    {
+      rc->tail_len += n;
+      in->pos += n;
+      return codec_token_need_input;
+    }
+
+    rc->next = rc->tail;
+    rc->end = rc->tail + rc->tail_len + n;
+  }
+
+  rc->overrun = false;
+  codec_token_t token = _decode_token( rc, c, m );
+  if( rc->overrun )
+    token = codec_token_error;
+
+  /* the bytes used past the ones left over are consumed from the input */
+  if( direct )
+    in->pos = rc->next - in->data;
+  else
+  {
+    size_t used = rc->next - rc->tail;
+
+    if( used >= rc->tail_len )
+    {
+      in->pos += used - rc->tail_len;
+      rc->tail_len = 0;
+    }
+    else
+    {
+      memmove( rc->tail, rc->next, rc->tail_len - used );
+      rc->tail_len -= used;
+    }
+  }
+
+  return token;
+}
+
+
+/**
+ * Finishes the encoded output.
+ * @param  codec The codec instance.
+ * @return       \c true on success, \c false otherwise.
+ */
+static bool _close( codec_t *codec )
+{
+  range_codec_t *rc = codec->_int_data;
+
+  _encode_match( rc, 0, rc->max_pos );
+  for( size_t i = 0; i < FLUSH_SIZE; i++ )
+    _shift_low( rc );
+
+  return !rc->failed && sink_flush( rc->sink );
+}
+
+
+/**
+ * Destroys the codec releasing all the taken resources.
+ * @param codec Codec to destroy.
+ */
+static void _destroy( codec_t *codec )
+{
+  range_codec_t *rc = codec->_int_data;
+
+  if( rc->sink == &rc->own_sink )
+    sink_release( rc->sink );
+
+  free( codec );
+}
+
+
+/**
+ * Creates a new range codec writing into a sink.
+ * The tokens are encoded with an adaptive binary range coder, with every bit modeled in its
+ * context (see the format above), which makes the strongest but slowest codec.
+ * @param  sink          Sink where the encoded data is written (\c NULL if only used to decode).
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *range_codec_create_sink( sink_t *sink,
+                                  size_t min_match_len,
+                                  size_t max_match_len,
+                                  size_t max_pos )
+{
+  /* input checks (the lengths and positions take up to 32 bits, the end of stream included) */
+  if( min_match_len == 0 || min_match_len > max_match_len )
+    return NULL;
+  if( max_match_len - min_match_len > UINT32_MAX - ( 2U << LOW_LEN_BITS ) || max_pos > UINT32_MAX )
+    return NULL;
+
+  NEW_CODEC( range_codec_t );
+
+  ic->sink = sink;
+  ic->min_match_len = min_match_len;
+  ic->max_match_len = max_match_len;
+  ic->max_pos = max_pos;
+  ic->range = UINT32_MAX;
+  ic->cache_size = 1;
+  ic->state = range_state_init;
+
+  /* the model is only made of probabilities */
+  uint16_t *probs = ( uint16_t * )&ic->model;
+  for( size_t i = 0; i < sizeof( ic->model ) / sizeof( uint16_t ); i++ )
+    probs[i] = PROB_INIT;
+
+  /* the prices are taken at the middle of the probabilities reduced to each entry */
+  for( size_t i = 0; i < sizeof( ic->prices ) / sizeof( ic->prices[0] ); i++ )
+  {
+    double prob = ( i + 0.5 ) / ( 1U << ( PROB_BITS - PRICE_REDUCE_BITS ) );
+    ic->prices[i] = -log2( prob ) * ( 1U << PRICE_FRACTION_BITS ) + 0.5;
+  }
+
+  return codec;
+}
+
+
+/**
+ * Creates a new range codec.
+ * The encoded data is output through \a cb in chunks of \c RANGE_CODEC_BUFFER_SIZE bytes, and when
+ * the codec is closed.
+ * @param  cb            Callback used to output data (\c NULL if only used to decode).
+ * @param  cb_ctx        Context passed to \a cb.
+ * @param  min_match_len Minimum match length.
+ * @param  max_match_len Maximum match length.
+ * @param  max_pos       Maximum match position.
+ * @return               Codec or \c NULL on error.
+ */
+codec_t *range_codec_create( codec_out_cb_t cb,
+                             void *cb_ctx,
+                             size_t min_match_len,
+                             size_t max_match_len,
+                             size_t max_pos )
+{
+  codec_t *codec = range_codec_create_sink( NULL, min_match_len, max_match_len, max_pos );
+  if( codec == NULL || cb == NULL )
+    return codec;
+
+  range_codec_t *rc = codec->_int_data;
+  if( !sink_init_callback( &rc->own_sink, cb, cb_ctx, RANGE_CODEC_BUFFER_SIZE ) )
+  {
+    codec->destroy( codec );
+    return NULL;
+  }
+
+  rc->sink = &rc->own_sink;
+
+  return codec;
+}
@@ -0,0 +1,27 @@
+#ifndef RANGE_H
+#define RANGE_H
+
+
+/* include area */
+#include "codec.h"
+
+
+/* constants */
+
+/** Default size of the output buffer of the range codec. */
+#define RANGE_CODEC_BUFFER_SIZE 65536
+
+
+/* prototypes */
+codec_t *range_codec_create( codec_out_cb_t cb,
+                             void *cb_ctx,
+                             size_t min_match_len,
+                             size_t max_match_len,
+                             size_t max_pos );
+codec_t *range_codec_create_sink( sink_t *sink,
+                                  size_t min_match_len,
+                                  size_t max_match_len,
+                                  size_t max_pos );
+
+
+#endif
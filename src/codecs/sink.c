@@ -0,0 +1,128 @@
+/* include area */
+#include <string.h>
+#include "sink.h"
+#include "../math2.h"
+
+
+/**
+ * Initializes a sink writing into a caller's buffer.
+ * The number of bytes written is \c len, and the writes fail once the buffer is full.
+ * @param s      Sink to initialize.
+ * @param buffer Buffer where the data is written.
+ * @param size   Size of \a buffer.
+ */
+void sink_init_buffer( sink_t *s, void *buffer, size_t size )
+{
+  s->buffer = buffer;
+  s->size = size;
+  s->len = 0;
+  s->cb = NULL;
+  s->cb_ctx = NULL;
+}
+
+
+/**
+ * Initializes a sink outputting the data through a callback in chunks.
+ * @param  s           Sink to initialize.
+ * @param  cb          Callback used to output the data.
+ * @param  cb_ctx      Context passed to \a cb.
+ * @param  buffer_size Size of the chunks (the callback is called when the buffer gets full and
+ *                     on \c sink_flush).
+ * @return             \c true on success, \c false otherwise.
+ */
+bool sink_init_callback( sink_t *s, codec_out_cb_t cb, void *cb_ctx, size_t buffer_size )
+{
+  if( cb == NULL || buffer_size == 0 )
+    return false;
+
+  s->buffer = malloc( buffer_size );
+  if( s->buffer == NULL )
+    return false;
+
+  s->size = buffer_size;
+  s->len = 0;
+  s->cb = cb;
+  s->cb_ctx = cb_ctx;
+
+  return true;
+}
+
+
+/**
+ * Releases all the resources taken by the sink (the data not flushed is lost).
+ * @param s Sink.
+ */
+void sink_release( sink_t *s )
+{
+  if( s->cb != NULL )
+    free( s->buffer );
+
+  s->buffer = NULL;
+  s->size = 0;
+  s->len = 0;
+}
+
+
+/**
+ * Makes room in the buffer for \a len bytes (flushing it), called by \c sink_reserve when they
+ * don't fit.
+ * @param  s   Sink.
+ * @param  len Number of bytes to write.
+ * @return     Pointer to \a len writable bytes, or \c NULL if there's no room for them.
+ */
+byte *sink_make_room( sink_t *s, size_t len )
+{
+  if( s->cb == NULL || len > s->size || !sink_flush( s ) )
+    return NULL;
+
+  return s->buffer;
+}
+
+
+/**
+ * Writes data into the sink.
+ * @param  s    Sink.
+ * @param  data Data to write.
+ * @param  len  Size of \a data.
+ * @return      \c true on success, \c false otherwise (nothing is written if it doesn't fit in a
+ *              caller's buffer).
+ */
+bool sink_write( sink_t *s, const void *data, size_t len )
+{
+  const byte *bytes = data;
+
+  if( s->cb == NULL && s->size - s->len < len )
+    return false;
+
+  while( len > 0 )
+  {
+    if( s->len == s->size && !sink_flush( s ) )
+      return false;
+
+    size_t n = MIN( len, s->size - s->len );
+    memcpy( s->buffer + s->len, bytes, n );
+    s->len += n;
+    bytes += n;
+    len -= n;
+  }
+
+  return true;
+}
+
+
+/**
+ * Outputs the data buffered through the callback (nothing to do when writing into a caller's
+ * buffer).
+ * @param  s Sink.
+ * @return   \c true on success, \c false otherwise.
+ */
+bool sink_flush( sink_t *s )
+{
+  if( s->cb == NULL || s->len == 0 )
+    return true;
+
+  size_t len = s->len;
+  s->len = 0;
+
+  return s->cb( s->buffer, len, s->cb_ctx );
+}
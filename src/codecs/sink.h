@@ -0,0 +1,79 @@
+#ifndef SINK_H
+#define SINK_H
+
+
+/* include area */
+#include <stdbool.h>
+#include <stdlib.h>
+#include "../datatype.h"
+
+
+/** Callback used by the codec to output the encoded data.
+ *  Receives the data to output, the size of the data and the user provided context. */
+typedef bool ( *codec_out_cb_t )( const void *buffer, size_t buffer_size, void *ctx );
+
+
+/** Destination of the encoded data.
+ *  The codecs write straight into \c buffer. Either the buffer is provided by the caller (and the
+ *  output fails once it's full, see \c sink_init_buffer), or it's owned by the sink and its
+ *  content is output through a callback every time it gets full (see \c sink_init_callback). */
+typedef struct
+{
+  /** Buffer where the data is written. */
+  byte *buffer;
+
+  /** Size of \c buffer. */
+  size_t size;
+
+  /** Number of bytes written in \c buffer. */
+  size_t len;
+
+  /** Callback the buffer is output through (\c NULL to write into a caller's buffer). */
+  codec_out_cb_t cb;
+
+  /** Context passed to \c cb. */
+  void *cb_ctx;
+
+} sink_t;
+
+
+/* prototypes */
+void sink_init_buffer( sink_t *s, void *buffer, size_t size );
+bool sink_init_callback( sink_t *s, codec_out_cb_t cb, void *cb_ctx, size_t buffer_size );
+void sink_release( sink_t *s );
+
+byte *sink_make_room( sink_t *s, size_t len );
+bool sink_write( sink_t *s, const void *data, size_t len );
+bool sink_flush( sink_t *s );
+
+
+/* inline functions */
+
+/**
+ * Returns where the next bytes can be written, making room for them if needed.
+ * The bytes written are added to the sink with \c sink_commit.
+ * @param  s   Sink.
+ * @param  len Number of bytes to write (up to the buffer size).
+ * @return     Pointer to \a len writable bytes, or \c NULL if there's no room for them.
+ */
+static inline byte *sink_reserve( sink_t *s, size_t len )
+{
+  if( s->size - s->len >= len )
+    return s->buffer + s->len;
+
+  return sink_make_room( s, len );
+}
+
+
+/**
+ * Adds to the sink the bytes written in the space returned by \c sink_reserve.
+ * @param s   Sink.
+ * @param len Number of bytes written.
+ */
+static inline void sink_commit( sink_t *s, size_t len )
+{
+  s->len += len;
+}
+
+
+#endif
@@ -0,0 +1,230 @@
+/* include area */
+#include "hash_chain.h"
+#include "math2.h"
+
+
+/** Constants */
+
+/** Value of an empty table entry. */
+#define NIL 0U
+
+/** Minimum and maximum number of bits of the hash values. */
+#define MIN_HASH_BITS 8U
+#define MAX_HASH_BITS 20U
+
+
+/**
+ * Converts a relative position from the tables into a stream offset.
+ * @param  hc  Hash chain.
+ * @param  rel Relative position (must not be \c NIL).
+ * @return     Stream offset.
+ */
+static inline uint64_t _to_offset( const hash_chain_t *hc, uint32_t rel )
+{
+  return hc->base + rel - 1;
+}
+
+
+/**
+ * Returns the entry of \c prev of a position.
+ * @param  hc  Hash chain.
+ * @param  pos Stream offset.
+ * @return     Index in \c prev.
+ */
+static inline size_t _prev_index( const hash_chain_t *hc, uint64_t pos )
+{
+  return ( hc->prev_mask != 0 ) ? pos & hc->prev_mask : pos % hc->window_size;
+}
+
+
+/**
+ * Drops the positions that are out of the window and moves the base so the relative positions
+ * fit again in 32 bits.
+ * @param hc  Hash chain.
+ * @param pos Position about to be inserted.
+ */
+static void _rebase( hash_chain_t *hc, uint64_t pos )
+{
+  uint64_t new_base = pos - hc->window_size;
+  uint32_t delta = new_base - hc->base;
+
+  for( size_t i = 0; i < ( ( size_t )1 << hc->hash_bits ); i++ )
+    hc->head[i] = ( hc->head[i] > delta ) ? hc->head[i] - delta : NIL;
+
+  for( size_t i = 0; i < hc->window_size; i++ )
+    hc->prev[i] = ( hc->prev[i] > delta ) ? hc->prev[i] - delta : NIL;
+
+  hc->base = new_base;
+}
+
+
+/**
+ * Links a position at the head of the chain of its hash value.
+ * @param hc  Hash chain.
+ * @param pos Stream offset to insert.
+ * @param h   Hash of the bytes at \a pos.
+ */
+static void _insert( hash_chain_t *hc, uint64_t pos, uint32_t h )
+{
+  if( pos - hc->base + 1 > HASH_CHAIN_REBASE_LIMIT )
+    _rebase( hc, pos );
+
+  hc->prev[_prev_index( hc, pos )] = hc->head[h];
+  hc->head[h] = ( uint32_t )( pos - hc->base + 1 );
+}
+
+
+/**
+ * Initializes a hash chain match finder.
+ * @param  hc          Hash chain to initialize.
+ * @param  window_size Maximum match distance.
+ * @param  hash_len    Number of bytes hashed at each position (the minimum match length).
+ * @param  max_chain   Maximum number of candidates checked per search.
+ * @return             \c true on success, \c false otherwise.
+ */
+bool hash_chain_init( hash_chain_t *hc, size_t window_size, size_t hash_len, size_t max_chain )
+{
+  /* the relative positions of a whole window must fit comfortably in 32 bits */
+  if( window_size == 0 || window_size > ( UINT32_MAX >> 1 ) || hash_len == 0 || max_chain == 0 )
+    return false;
+
+  hc->hash_bits = MIN( MAX( math_bits_in_n( window_size - 1 ), MIN_HASH_BITS ), MAX_HASH_BITS );
+  hc->hash_len = hash_len;
+  hc->window_size = window_size;
+  hc->prev_mask = ( ( window_size & ( window_size - 1 ) ) == 0 ) ? window_size - 1 : 0;
+  hc->max_chain = max_chain;
+  hc->base = 0;
+
+  hc->head = calloc( ( size_t )1 << hc->hash_bits, sizeof( uint32_t ) );
+  if( hc->head == NULL )
+    return false;
+
+  hc->prev = calloc( window_size, sizeof( uint32_t ) );
+  if( hc->prev == NULL )
+    goto error0;
+
+  return true;
+
+error0:
+  free( hc->head );
+  return false;
+}
+
+
+/**
+ * Releases all the resources taken by the hash chain.
+ * @param hc Hash chain.
+ */
+void hash_chain_release( hash_chain_t *hc )
+{
+  free( hc->head );
+  free( hc->prev );
+  hc->head = NULL;
+  hc->prev = NULL;
+}
+
+
+/**
+ * Inserts a position in the chains.
+ * The \c hash_len bytes starting at \a pos must be available in the window.
+ * @param hc  Hash chain.
+ * @param w   Window holding the data.
+ * @param pos Stream offset to insert.
+ */
+void hash_chain_insert( hash_chain_t *hc, const window_t *w, uint64_t pos )
+{
+  _insert( hc, pos, hash_chain_hash( w, pos, hc->hash_len, hc->hash_bits ) );
+}
+
+
+/**
+ * Same as \c hash_chain_find_all, reading the window as \a pow2 says (see \c window_byte).
+ * @param  hc          Hash chain.
+ * @param  w           Window holding the data.
+ * @param  pos         Stream offset of the string to match.
+ * @param  max_len     Maximum match length (at least \c hash_len bytes must be available).
+ * @param  matches     Matches found (the positions are relative to the byte preceding \a pos).
+ * @param  max_matches Capacity of \a matches (at least 1).
+ * @param  pow2        Whether the window's buffer is a power of two.
+ * @return             Number of matches stored.
+ */
+static WINDOW_INLINE size_t _find_all( hash_chain_t *hc,
+                                       const window_t *w,
+                                       uint64_t pos,
+                                       size_t max_len,
+                                       match_t *matches,
+                                       size_t max_matches,
+                                       bool pow2 )
+{
+  uint32_t h = hash_chain_hash( w, pos, hc->hash_len, hc->hash_bits );
+  uint32_t rel = hc->head[h];
+
+  size_t num_matches = 0;
+  size_t best_len = 0;
+
+  for( size_t chain = hc->max_chain; rel != NIL && chain > 0; chain-- )
+  {
+    uint64_t candidate = _to_offset( hc, rel );
+    uint64_t distance = pos - candidate;
+    if( distance > hc->window_size )
+      break;
+
+    /* the candidate can't improve the best match unless the byte after it matches too */
+    if( best_len == 0 ||
+        window_byte( w, candidate + best_len, pow2 ) == window_byte( w, pos + best_len, pow2 ) )
+    {
+      size_t len = window_match_length( w, candidate, pos, max_len );
+      if( len > best_len )
+      {
+        best_len = len;
+
+        if( num_matches < max_matches )
+          num_matches++;
+
+        matches[num_matches - 1].pos = distance - 1;
+        matches[num_matches - 1].len = len;
+
+        if( len == max_len )
+          break;
+      }
+    }
+
+    /* the chains only go back in time, anything else is a stale link */
+    uint32_t next = hc->prev[_prev_index( hc, candidate )];
+    if( next >= rel )
+      break;
+
+    rel = next;
+  }
+
+  _insert( hc, pos, h );
+
+  return num_matches;
+}
+
+
+/**
+ * Finds the matches for the string at \a pos and then inserts \a pos in the chains.
+ * Each match stored is longer than the previous one, and it's the closest with its length. If
+ * there are more matches than \a max_matches, the last one is replaced by the longer ones.
+ * @param  hc          Hash chain.
+ * @param  w           Window holding the data.
+ * @param  pos         Stream offset of the string to match.
+ * @param  max_len     Maximum match length (at least \c hash_len bytes must be available).
+ * @param  matches     Matches found (the positions are relative to the byte preceding \a pos).
+ * @param  max_matches Capacity of \a matches (at least 1).
+ * @return             Number of matches stored.
+ */
+size_t hash_chain_find_all( hash_chain_t *hc,
+                            const window_t *w,
+                            uint64_t pos,
+                            size_t max_len,
+                            match_t *matches,
+                            size_t max_matches )
+{
+  /* the window is mapped the same way all along the chain */
+  if( window_is_pow2( w ) )
+    return _find_all( hc, w, pos, max_len, matches, max_matches, true );
+
+  return _find_all( hc, w, pos, max_len, matches, max_matches, false );
+}
@@ -0,0 +1,107 @@
+#ifndef HASH_CHAIN_H
+#define HASH_CHAIN_H
+
+
+/* include area */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "match.h"
+#include "math2.h"
+#include "window.h"
+
+
+/* constants */
+
+/** Multiplier used to spread the hashed bytes (golden ratio). */
+#define HASH_CHAIN_MULTIPLIER UINT64_C( 0x9E3779B97F4A7C15 )
+
+/** Relative positions are rebased before reaching this value. */
+#define HASH_CHAIN_REBASE_LIMIT ( UINT32_MAX - 1 )
+
+
+/** Hash chain match finder.
+ *  Positions are stream offsets (see \c window_get_offset) stored as 32 bits values relative to
+ *  \c base, so the tables take 4 bytes per entry regardless of the stream length. */
+typedef struct
+{
+  /** Most recent position inserted for each hash value. */
+  uint32_t *head;
+
+  /** Previous position with the same hash, indexed by position modulo the window size. */
+  uint32_t *prev;
+
+  /** Number of bits of the hash values. */
+  size_t hash_bits;
+
+  /** Number of bytes hashed at each position. */
+  size_t hash_len;
+
+  /** Maximum distance of a match. */
+  size_t window_size;
+
+  /** Mask mapping a position into \c prev if the window size is a power of two (zero otherwise,
+   *  the position is divided instead). */
+  size_t prev_mask;
+
+  /** Maximum number of candidates checked per search. */
+  size_t max_chain;
+
+  /** Stream offset the stored positions are relative to. */
+  uint64_t base;
+
+} hash_chain_t;
+
+
+/* prototypes */
+bool hash_chain_init( hash_chain_t *hc, size_t window_size, size_t hash_len, size_t max_chain );
+void hash_chain_release( hash_chain_t *hc );
+
+void hash_chain_insert( hash_chain_t *hc, const window_t *w, uint64_t pos );
+size_t hash_chain_find_all( hash_chain_t *hc,
+                            const window_t *w,
+                            uint64_t pos,
+                            size_t max_len,
+                            match_t *matches,
+                            size_t max_matches );
+
+
+/* inline functions */
+
+/**
+ * Hashes the \a len bytes starting at stream offset \a pos (only the first 8 if there are more).
+ * The bytes are read with a single word load when they're contiguous in memory.
+ * @param  w    Window holding the bytes.
+ * @param  pos  Stream offset of the first byte.
+ * @param  len  Number of bytes to hash.
+ * @param  bits Number of bits of the result.
+ * @return      Hash value.
+ */
+static inline uint32_t hash_chain_hash( const window_t *w, uint64_t pos, size_t len, size_t bits )
+{
+  uint64_t value = 0;
+  len = MIN( len, sizeof( value ) );
+
+#if defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  /* the first byte in memory is the least significant one */
+  size_t run;
+  const byte *data = window_span_at( w, pos, &run );
+
+  if( run >= sizeof( value ) )
+    memcpy( &value, data, sizeof( value ) );
+  else
+#endif
+  {
+    for( size_t i = 0; i < len; i++ )
+      value |= ( uint64_t )( byte )window_at_mod( w, pos + i ) << ( 8 * i );
+  }
+
+  /* the bytes past \a len are shifted out */
+  value <<= 8 * ( sizeof( value ) - len );
+
+  return ( uint32_t )( ( value * HASH_CHAIN_MULTIPLIER ) >> ( 64 - bits ) );
+}
+
+
+#endif
@@ -1,31 +1,86 @@
 /* include area */
+#include <stdint.h>
+#include <string.h>
 #include "lzss.h"
+#include "codecs/binary.h"
+#include "math2.h"
 
 
-/* internal types */
+/** Constants */
 
-/** Match list update context. */
-typedef struct
-{
-  /** Window that buffered the previous bytes. */
-  const window_t *w;
+/** Capacity of the sequence store (the tokens are written to the codec when it gets full). */
+#define LZSS_MAX_SEQUENCES 4096
+#define LZSS_MAX_LITERALS 16384
+
+/** Maximum number of candidates (of different lengths) priced by the optimal parser. */
+#define LZSS_OPTIMAL_MAX_MATCHES 16
+
+/** Length from which a match repeating the position of a recent one is taken without searching
+ *  the window. */
+#define LZSS_REP_NICE_LEN 16
+
+/** Minimum length of a run of the last byte for the window finder to match it at once. */
+#define LZSS_MIN_RUN_LEN 64
+
+/** Creates the parameters of a compression level. */
+#define LEVEL( window, min, nice, f, depth, p, lazy, block ) \
+  {                                                           \
+    .window_size = ( window ),                                \
+    .pow2_window = true,                                      \
+    .min_match_len = ( min ),                                 \
+    .max_match_len = LZSS_LEVEL_MAX_MATCH_LEN,                \
+    .nice_match_len = ( nice ),                               \
+    .finder = lzss_finder_##f,                                \
+    .search_depth = ( depth ),                                \
+    .parser = lzss_parser_##p,                                \
+    .lazy_depth = ( lazy ),                                   \
+    .block_size = ( block )                                   \
+  }
+
+
+/** Parameters of each compression level, from \c LZSS_MIN_LEVEL to \c LZSS_MAX_LEVEL.
+ *  The speed and ratio are measured on 16MB of English text and C/Python sources with the binary
+ *  codec (-O2 build, one core). The finders only compare up to a short nice length, since the
+ *  codec spends the same bits on the usual lengths, and the matches reaching it are extended up
+ *  to \c LZSS_LEVEL_MAX_MATCH_LEN. The window only grows where the finder can make use of it. */
+static const lzss_params_t _levels[] = {
+  /* 1: fastest, 50 MB/s, ratio 4.15 */
+  LEVEL( 1 << 16, 5,  32, hash_chain,   4, greedy,  0, 0 ),
 
-  /** New character to match against. */
-  byte c;
+  /* 2: 50 MB/s, ratio 4.26 */
+  LEVEL( 1 << 16, 5,  32, hash_chain,   8, greedy,  0, 0 ),
 
-} ml_update_cb_ctx_t;
+  /* 3: 43 MB/s, ratio 4.83 */
+  LEVEL( 1 << 18, 5,  32, hash_chain,   8, greedy,  0, 0 ),
 
+  /* 4: 22 MB/s, ratio 5.10 */
+  LEVEL( 1 << 18, 5,  32, hash_chain,  16, lazy,    1, 0 ),
 
-static bool _find_match( size_t from, size_t *pos, const window_t *window, char c )
+  /* 5: default, 13 MB/s, ratio 5.21 */
+  LEVEL( 1 << 18, 5,  32, hash_chain,  64, lazy,    2, 0 ),
+
+  /* 6: 6 MB/s, ratio 5.26 */
+  LEVEL( 1 << 18, 5,  32, binary_tree, 32, lazy,    2, 0 ),
+
+  /* 7: 2.5 MB/s, ratio 5.58 */
+  LEVEL( 1 << 18, 4,  32, binary_tree, 16, optimal, 0, LZSS_DEFAULT_BLOCK_SIZE ),
+
+  /* 8: 2.2 MB/s, ratio 5.68, better on long repetitions */
+  LEVEL( 1 << 18, 4,  64, binary_tree, 32, optimal, 0, LZSS_DEFAULT_BLOCK_SIZE ),
+
+  /* 9: strongest, 1.8 MB/s, ratio 8.69, best on large inputs with distant repetitions */
+  LEVEL( 1 << 20, 4, 128, binary_tree, 64, optimal, 0, LZSS_DEFAULT_BLOCK_SIZE ),
+};
+
+
+static WINDOW_INLINE bool _find_match( size_t from, size_t *pos, const window_t *window, char c,
+                                       bool pow2 )
 {
-  for( size_t i = from; i < window_get_size( window ); i++ )
+  size_t size = window_get_size( window );
+  uint64_t last = window_get_offset( window ) - 1;
+  for( size_t i = from; i < size; i++ )
   {
-    char wchar;
-    if( !window_read( window, &wchar, i ) )
-      /* TODO: inform better about the error */
-      exit(1);
-
-    if( wchar == c )
+    if( window_byte( window, last - i, pow2 ) == c )
     {
       *pos = i;
       return true;
@@ -36,19 +91,18 @@ static bool _find_match( size_t from, size_t *pos, const window_t *window, char
 }
 
 
-static size_t _find_matches( const window_t *w, match_list_t *ml, char c )
+static WINDOW_INLINE size_t _find_matches( const window_t *w, match_list_t *ml, char c, bool pow2 )
 {
   match_t m;
   size_t wpos = 0, found_matches = 0;
-  while( _find_match( wpos, &wpos, w, c ) )
+  while( _find_match( wpos, &wpos, w, c, pow2 ) )
   {
     m.pos = wpos;
     m.len = 1;
 
-    /* adds a match into the list */
+    /* adds a match into the list (the farthest candidates are dropped if it's full) */
     if( !match_list_append( ml, &m ) )
-      /* TODO: inform better about the error */
-      exit(2);
+      break;
 
     found_matches++;
     wpos++;
@@ -58,44 +112,104 @@ static size_t _find_matches( const window_t *w, match_list_t *ml, char c )
 }
 
 
-static bool _ml_update_cb( match_t *m, void *cb_ctx )
+static size_t _update_matches( match_list_t *ml, const window_t *w, byte c, match_t *best_match )
 {
-  ml_update_cb_ctx_t *ctx = cb_ctx;
-
-  char wchar;
-  if( !window_read( ctx->w, &wchar, m->pos ) )
+  /* gets the first match in the list, in case there are no more matches left in the window */
+  if( !match_list_get( ml, 0, best_match ) )
     /* TODO: inform better about the error */
-    exit( 5 );
+    exit( 6 );
+
+  /* updates the list removing all matches that are not valid anymore */
+  return match_list_extend( ml, w, c );
+}
+
 
-  /* if it doesn't match anymore, removes the match from the list */
-  if( wchar != ctx->c )
-    return false;
+/**
+ * Writes the tokens of the sequence store to the codec, emptying it.
+ * @param  lz LZSS.
+ * @return    Error code.
+ */
+static lzss_error_t _flush_sequences( lzss_t *lz )
+{
+  sequence_store_close( &lz->seqs );
 
-  /* still matching at that position, increments the match length */
-  m->len += 1;
+  bool success = lz->codec->write_sequences( lz->codec, &lz->seqs );
+  sequence_store_reset( &lz->seqs );
 
-  return true;
+  return success ? lzss_error_no_error : lzss_error_io_error;
 }
 
 
-static size_t _update_matches( match_list_t *ml, const window_t *w, byte c, match_t *best_match )
+/**
+ * Adds a literal to the sequence store (writing the store first if it's full).
+ * @param  lz LZSS.
+ * @param  c  Literal.
+ * @return    Error code.
+ */
+static inline lzss_error_t _emit_literal( lzss_t *lz, byte c )
 {
-  ml_update_cb_ctx_t cb_ctx = {
-    .c = c,
-    .w = w
-  };
+  if( !sequence_store_add_literal( &lz->seqs, c ) )
+  {
+    lzss_error_t error = _flush_sequences( lz );
+    if( error != lzss_error_no_error )
+      return error;
 
-  /* gets the first match in the list, in case there are no more matches left in the window */
-  if( !match_list_get( ml, 0, best_match ) )
-    /* TODO: inform better about the error */
-    exit( 6 );
+    sequence_store_add_literal( &lz->seqs, c );
+  }
 
-  /* updates the list removing all matches that are not valid anymore */
-  return match_list_update( ml, _ml_update_cb, &cb_ctx );
+  return lzss_error_no_error;
+}
+
+
+/**
+ * Adds a match to the sequence store (writing the store first if it's full).
+ * @param  lz LZSS.
+ * @param  m  Match.
+ * @return    Error code.
+ */
+static inline lzss_error_t _emit_match( lzss_t *lz, match_t m )
+{
+  if( !sequence_store_add_match( &lz->seqs, m ) )
+  {
+    lzss_error_t error = _flush_sequences( lz );
+    if( error != lzss_error_no_error )
+      return error;
+
+    sequence_store_add_match( &lz->seqs, m );
+  }
+
+  codec_reps_update( lz->reps, m.pos );
+
+  return lzss_error_no_error;
+}
+
+
+/**
+ * Writes the bytes matched so far by the window finder: as a match if it's long enough, or as
+ * literals otherwise.
+ * @param  lz    LZSS.
+ * @param  match Match of the bytes in \c current_match.
+ * @return       Error code.
+ */
+static lzss_error_t _emit_current_match( lzss_t *lz, match_t match )
+{
+  lzss_error_t error = lzss_error_no_error;
+
+  if( match.len >= lz->min_match_len )
+    error = _emit_match( lz, match );
+  else
+  {
+    for( size_t i = 0; i < match.len && error == lzss_error_no_error; i++ )
+      error = _emit_literal( lz, lz->current_match[i] );
+  }
+
+  lz->current_match_len = 0;
+
+  return error;
 }
 
 
-static lzss_error_t _compress_one( lzss_t *lz, byte b )
+static WINDOW_INLINE lzss_error_t _compress_one( lzss_t *lz, byte b, bool pow2 )
 {
   /* if there are already matches in the window, updates them */
   if( match_list_length( &lz->ml ) > 0 )
@@ -105,36 +219,25 @@ static lzss_error_t _compress_one( lzss_t *lz, byte b )
     /* updates matches */
     if( _update_matches( &lz->ml, &lz->window, b, &match ) == 0 )
     {
-      /* no more matches
-       * if there was a valid match, it's written or else all matched bytes are outputted as
-       * literals */
-      if( match.len >= lz->min_match_len )
-      {
-        if( !lz->codec->write_match( lz->codec, match ) )
-          return lzss_error_io_error;
-
-        lz->current_match_len = 0;
-      }
-      else
-      {
-        /* outputs all buffered bytes as literals */
-        for( size_t i = 0; i < match.len; i++ )
-          if( !lz->codec->write_literal( lz->codec, lz->current_match[i] ) )
-            return lzss_error_io_error;
-
-        lz->current_match_len = 0;
-      }
+      /* no more matches */
+      lzss_error_t error = _emit_current_match( lz, match );
+      if( error != lzss_error_no_error )
+        return error;
     }
     else if( match.len < lz->min_match_len )
       lz->current_match[lz->current_match_len++] = b;
   }
 
   if( match_list_length( &lz->ml ) == 0 &&
-      _find_matches( &lz->window, &lz->ml, b ) > 0 &&
+      _find_matches( &lz->window, &lz->ml, b, pow2 ) > 0 &&
       ( lz->current_match_len < lz->min_match_len ) )
     lz->current_match[lz->current_match_len++] = b;
-  else if( match_list_length( &lz->ml ) == 0 && !lz->codec->write_literal( lz->codec, b ) )
-    return lzss_error_io_error;
+  else if( match_list_length( &lz->ml ) == 0 )
+  {
+    lzss_error_t error = _emit_literal( lz, b );
+    if( error != lzss_error_no_error )
+      return error;
+  }
 
   if( match_list_length( &lz->ml ) > 0 )
   {
@@ -146,8 +249,9 @@ static lzss_error_t _compress_one( lzss_t *lz, byte b )
 
     if( match.len == lz->max_match_len )
     {
-      if( !lz->codec->write_match( lz->codec, match ) )
-        return lzss_error_io_error;
+      lzss_error_t error = _emit_match( lz, match );
+      if( error != lzss_error_no_error )
+        return error;
 
       lz->current_match_len = 0;
       match_list_reset( &lz->ml );
@@ -162,128 +266,1328 @@ static lzss_error_t _compress_one( lzss_t *lz, byte b )
 
 
 /**
- * Initializes the LZSS to compress/decompress data.
- * @param  lz            LZSS to initialize.
- * @param  window_size   Size of the window to use.
- * @param  min_match_len Minimum size of bytes required to be encoded as match.
- * @param  max_match_len Maximum bytes allowed in a match.
- * @param  codec         Codec used to encode/decode the data.
- * @return               Error code.
+ * Counts the bytes at the start of a block equal to \a c, comparing a word at a time.
+ * @param  data Block.
+ * @param  len  Size of \a data.
+ * @param  c    Byte of the run.
+ * @return      Length of the run.
  */
-lzss_error_t lzss_init( lzss_t *lz,
-                        size_t window_size,
-                        size_t min_match_len,
-                        size_t max_match_len,
-                        codec_t *codec )
+static size_t _run_length( const byte *data, size_t len, byte c )
 {
-  /* initializes the internal window buffer */
-  if( !window_init( &lz->window, window_size ) )
-    return lzss_error_malloc_error;
+  uint64_t pattern = UINT64_C( 0x0101010101010101 ) * c;
+  size_t i = 0;
 
-  /* initializes the internal match buffer.
-   * this buffer holds the characters that are currently matching, but have not yet got to the
-   * minimum match length, so the may end up being encoded as literals */
-  lz->current_match_len = 0;
-  lz->current_match = malloc( min_match_len );
-  if( lz->current_match == NULL )
-    goto error0;
+  for( ; i + sizeof( uint64_t ) <= len; i += sizeof( uint64_t ) )
+  {
+    uint64_t word;
+    memcpy( &word, data + i, sizeof( word ) );
 
-  if( !match_list_init( &lz->ml, window_size ) )
-    goto error1;
+    uint64_t diff = word ^ pattern;
+    if( diff != 0 )
+    {
+#if defined( __GNUC__ ) && defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      /* the first byte in memory is the least significant one */
+      return i + ( __builtin_ctzll( diff ) >> 3 );
+#else
+      break;
+#endif
+    }
+  }
 
-  /* sets the other parameters */
-  lz->codec = codec;
-  lz->min_match_len = min_match_len;
-  lz->max_match_len = max_match_len;
-  lz->state = lzss_state_init;
+  while( i < len && data[i] == c )
+    i++;
 
-  return lzss_error_no_error;
+  return i;
+}
 
-error1:
-  free( lz->current_match );
 
-error0:
-  window_release( &lz->window );
+/**
+ * Writes the bytes of a run held back by \c _compress_run: as a match of the previous position if
+ * they're enough, or through the window finder otherwise.
+ * @param  lz   LZSS.
+ * @param  pow2 Whether the window's buffer is a power of two.
+ * @return      Error code.
+ */
+static lzss_error_t _end_run( lzss_t *lz, bool pow2 )
+{
+  size_t held = lz->run_len;
+  if( held == 0 )
+    return lzss_error_no_error;
 
-  return lzss_error_malloc_error;
+  byte c = window_byte( &lz->window, window_get_offset( &lz->window ) - 1, pow2 );
+  lz->run_len = 0;
+
+  if( held < lz->min_match_len )
+  {
+    for( size_t i = 0; i < held; i++ )
+    {
+      lzss_error_t error = _compress_one( lz, c, pow2 );
+      if( error != lzss_error_no_error )
+        return error;
+    }
+
+    return lzss_error_no_error;
+  }
+
+  match_t m = { .pos = 0, .len = held };
+  lzss_error_t error = _emit_match( lz, m );
+  if( error != lzss_error_no_error )
+    return error;
+
+  for( size_t i = 0; i < held; i++ )
+    window_append( &lz->window, c );
+
+  return lzss_error_no_error;
 }
 
 
 /**
- * Compress some data.
- * This function can be called many times to compress by chunks.
- * @param  lz   An already initialized LZSS.
- * @param  data Data to be compressed.
- * @param  size Size of \a data.
- * @return      Error code.
+ * Encodes the start of \a data if it's a long run of the last byte in the window, as matches of
+ * the previous position (the bytes matched by the window finder so far are written first).
+ * The window finder would otherwise track every earlier occurrence of the byte along the run.
+ * A run reaching the end of \a data may go on in the next block, so the bytes past its last match
+ * of the longest length are held back, and the run goes on from them in the next call.
+ * @param  lz       LZSS.
+ * @param  data     Bytes to compress.
+ * @param  len      Size of \a data.
+ * @param  consumed Number of bytes encoded or held back (zero if there's no such run).
+ * @param  pow2     Whether the window's buffer is a power of two (see \c window_byte).
+ * @return          Error code.
  */
-lzss_error_t lzss_compress( lzss_t *lz, const void *data, size_t size )
+static WINDOW_INLINE lzss_error_t _compress_run( lzss_t *lz,
+                                                 const byte *data,
+                                                 size_t len,
+                                                 size_t *consumed,
+                                                 bool pow2 )
 {
-  const byte *bytes = data;
+  *consumed = 0;
+
+  uint64_t end = window_get_offset( &lz->window );
+  if( end == 0 )
+    return lzss_error_no_error;
+
+  byte c = window_byte( &lz->window, end - 1, pow2 );
+  size_t held = lz->run_len;
+  size_t run = held + _run_length( data, len, c );
+  if( held == 0 && run < MAX( LZSS_MIN_RUN_LEN, lz->min_match_len ) )
+    return lzss_error_no_error;
+
   lzss_error_t error;
+  match_t m;
 
-  /* compresses byte by byte */
-  for( size_t i = 0; i < size; i++ )
+  if( match_list_get( &lz->ml, 0, &m ) )
   {
-    error = _compress_one( lz, bytes[i] );
+    error = _emit_current_match( lz, m );
     if( error != lzss_error_no_error )
       return error;
+
+    match_list_reset( &lz->ml );
   }
 
-  /* success */
+  /* only the matches of the longest length are written while the run may go on, and otherwise a
+   * tail too short to be a match is left for the window finder */
+  bool open = ( run - held == len );
+  size_t min_len = open ? lz->max_match_len : lz->min_match_len;
+  size_t matched = 0;
+
+  while( run - matched >= min_len )
+  {
+    m.pos = 0;
+    m.len = MIN( run - matched, lz->max_match_len );
+
+    error = _emit_match( lz, m );
+    if( error != lzss_error_no_error )
+      return error;
+
+    matched += m.len;
+  }
+
+  /* the run ended right after the bytes held back, too short to be a match */
+  if( matched == 0 && !open )
+    return _end_run( lz, pow2 );
+
+  /* the bytes held back come first (they're all the byte of the run, and all matched since they
+   * were fewer than a match of the longest length) */
+  if( matched > 0 )
+  {
+    for( size_t i = 0; i < held; i++ )
+      window_append( &lz->window, c );
+
+    window_append_block( &lz->window, data, matched - held );
+  }
+
+  lz->run_len = open ? run - matched : 0;
+  *consumed = open ? len : matched - held;
+
   return lzss_error_no_error;
 }
 
 
 /**
- * Ends the compression/decompression.
- * @param  lz An already initialized and fed LZSS.
- * @return    Error code.
+ * Inserts in the match finder all the positions preceding \a pos that were not inserted yet.
+ * @param lz   LZSS.
+ * @param pos  Stream offset up to which the positions are inserted (not included).
+ * @param pow2 Whether the window's buffer is a power of two (see \c window_byte).
  */
-lzss_error_t lzss_end( lzss_t *lz )
+static WINDOW_INLINE void _insert_until( lzss_t *lz, uint64_t pos, bool pow2 )
 {
-  /* checks if there's data left to be written */
-  if( match_list_length( &lz->ml ) > 0 )
+  /* the brute force scanner has no index */
+  if( lz->finder == lzss_finder_scan )
+    return;
+
+  uint64_t end = window_get_offset( &lz->window );
+
+  for( ; lz->next_insert < pos; lz->next_insert++ )
   {
-    match_t match;
+    /* positions too close to the end of the data can't start a match anyway */
+    size_t available = MIN( end - lz->next_insert, lz->nice_match_len );
+    if( available < lz->min_match_len )
+      continue;
 
-    /* gets the first match (any match will do since they share the length) */
-    if( !match_list_get( &lz->ml, 0, &match ) )
-      return lz_error_internal_error;
+    if( lz->finder == lzss_finder_hash_chain )
+      hash_chain_insert( &lz->hc, &lz->window, lz->next_insert );
+    else if( lz->finder == lzss_finder_binary_tree )
+      binary_tree_insert( &lz->bt, &lz->window, lz->next_insert, available );
 
-    if( match.len >= lz->min_match_len )
+    /* the positions inside a run of a single byte share their string up to the nice length, so
+     * only the first one and the last ones (which go past the run) are inserted */
+    uint64_t next = lz->next_insert + 1;
+    const window_t *w = &lz->window;
+    if( next < end && window_byte( w, lz->next_insert, pow2 ) == window_byte( w, next, pow2 ) )
     {
-      if( !lz->codec->write_match( lz->codec, match ) )
-        return lzss_error_io_error;
+      size_t max_len = MIN( end - next, pos - next + lz->nice_match_len );
+      size_t run = window_match_length( &lz->window, lz->next_insert, next, max_len );
+
+      if( run > lz->nice_match_len )
+        lz->next_insert += run - lz->nice_match_len;
     }
-    else
+  }
+}
+
+
+/**
+ * Finds the matches for the string at \a pos using the configured finder.
+ * Each match is longer than the previous one (so the last is the longest). The finder compares
+ * up to the nice length, and the longest match is extended from there.
+ * @param  lz          LZSS.
+ * @param  pos         Stream offset of the string to match.
+ * @param  max_len     Maximum match length (bytes available after \a pos).
+ * @param  matches     Matches found.
+ * @param  max_matches Capacity of \a matches.
+ * @param  pow2        Whether the window's buffer is a power of two (see \c window_byte).
+ * @return             Number of matches found.
+ */
+static WINDOW_INLINE size_t _search( lzss_t *lz,
+                                     uint64_t pos,
+                                     size_t max_len,
+                                     match_t *matches,
+                                     size_t max_matches,
+                                     bool pow2 )
+{
+  _insert_until( lz, pos, pow2 );
+  lz->next_insert = pos + 1;
+
+  if( max_len < lz->min_match_len )
+    return 0;
+
+  size_t nice_len = MIN( max_len, lz->nice_match_len );
+  const window_t *w = &lz->window;
+  size_t num_matches;
+
+  switch( lz->finder )
+  {
+    case lzss_finder_hash_chain:
+      num_matches = hash_chain_find_all( &lz->hc, w, pos, nice_len, matches, max_matches );
+      break;
+
+    case lzss_finder_binary_tree:
+      num_matches = binary_tree_find_all( &lz->bt, w, pos, nice_len, matches, max_matches );
+      break;
+
+    case lzss_finder_scan:
+      num_matches = scan_find_all( &lz->scan, w, pos, nice_len, matches, max_matches );
+      break;
+
+    default:
+      return 0;
+  }
+
+  /* the longest match may go on past the nice length */
+  if( num_matches > 0 && matches[num_matches - 1].len == nice_len && nice_len < max_len )
+  {
+    match_t *longest = &matches[num_matches - 1];
+    longest->len = window_match_length( w, pos - longest->pos - 1, pos, max_len );
+  }
+
+  return num_matches;
+}
+
+
+/**
+ * Finds the longest match at \a pos, reusing the result if that position was already searched.
+ * @param  lz   LZSS.
+ * @param  pos  Stream offset of the string to match (must not precede the last one searched).
+ * @param  m    Best match found.
+ * @param  pow2 Whether the window's buffer is a power of two (see \c window_byte).
+ * @return      Length of the match found (zero if none).
+ */
+static WINDOW_INLINE size_t _find_cached( lzss_t *lz, uint64_t pos, match_t *m, bool pow2 )
+{
+  lzss_found_t *found = &lz->found[pos % ( LZSS_MAX_LAZY_DEPTH + 1 )];
+
+  if( found->tag != pos + 1 )
+  {
+    uint64_t end = window_get_offset( &lz->window );
+
+    if( _search( lz, pos, MIN( end - pos, lz->max_match_len ), &found->match, 1, pow2 ) == 0 )
     {
-      for( size_t i = 0; i < match.len; i++ )
-        if( !lz->codec->write_literal( lz->codec, lz->current_match[i] ) )
-          return lzss_error_io_error;
+      found->match.pos = 0;
+      found->match.len = 0;
+    }
 
-      lz->current_match_len = 0;
+    found->tag = pos + 1;
+  }
+
+  *m = found->match;
+  return m->len;
+}
+
+
+/**
+ * Returns the length of the match at \a pos repeating a recent match position.
+ * @param  lz      LZSS.
+ * @param  pos     Stream offset of the string to match.
+ * @param  rep     Position of the recent match.
+ * @param  max_len Maximum match length (bytes available after \a pos).
+ * @param  pow2    Whether the window's buffer is a power of two (see \c window_byte).
+ * @return         Length of the match (zero if shorter than the minimum).
+ */
+static WINDOW_INLINE size_t _rep_length( const lzss_t *lz,
+                                         uint64_t pos,
+                                         size_t rep,
+                                         size_t max_len,
+                                         bool pow2 )
+{
+  /* the data may not reach that far back yet */
+  if( pos <= rep || max_len < lz->min_match_len )
+    return 0;
+
+  /* most of them fail on the first bytes, which are cheaper to check */
+  uint64_t candidate = pos - rep - 1;
+  size_t last = lz->min_match_len - 1;
+
+  const window_t *w = &lz->window;
+  if( window_byte( w, candidate, pow2 ) != window_byte( w, pos, pow2 ) ||
+      window_byte( w, candidate + last, pow2 ) != window_byte( w, pos + last, pow2 ) )
+    return 0;
+
+  return window_match_length( w, candidate, pos, max_len );
+}
+
+
+/**
+ * Finds the longest match at \a pos repeating the position of one of the last matches.
+ * They're checked before searching the window, since they're cheap to check and to encode.
+ * @param  lz      LZSS.
+ * @param  pos     Stream offset of the string to match.
+ * @param  max_len Maximum match length (bytes available after \a pos).
+ * @param  m       Longest match found (the most recent position on ties).
+ * @param  pow2    Whether the window's buffer is a power of two (see \c window_byte).
+ * @return         Length of the match found (zero if none).
+ */
+static WINDOW_INLINE size_t _find_rep( const lzss_t *lz,
+                                       uint64_t pos,
+                                       size_t max_len,
+                                       match_t *m,
+                                       bool pow2 )
+{
+  m->pos = 0;
+  m->len = 0;
+
+  for( size_t i = 0; i < CODEC_NUM_REPS && m->len < max_len; i++ )
+  {
+    if( i > 0 && lz->reps[i] == lz->reps[i - 1] )
+      continue;
+
+    size_t len = _rep_length( lz, pos, lz->reps[i], max_len, pow2 );
+    if( len > m->len )
+    {
+      m->pos = lz->reps[i];
+      m->len = len;
     }
   }
 
-  /* informs the codec there's no more data left to be processed */
-  if( !lz->codec->close( lz->codec ) )
-    return lzss_error_io_error;
+  return m->len;
+}
 
-  /* success */
-  return lzss_error_no_error;
+
+/**
+ * Returns the price of a match repeating the position of a recent one.
+ * @param  lz    LZSS.
+ * @param  rep   Index of the position in the last ones.
+ * @param  token The match.
+ * @param  pos   Stream offset of the match.
+ * @return       Price in bits.
+ */
+static inline size_t _price_rep( const lzss_t *lz, size_t rep, match_t token, uint64_t pos )
+{
+  if( lz->codec->price_rep == NULL )
+    return lz->codec->price_match( lz->codec, token, pos );
+
+  return lz->codec->price_rep( lz->codec, rep, token.len );
 }
 
 
 /**
- * Releases all resources.
- * The LZSS cannot be used unless initialized again.
- * @param lz An initialized LZSS.
+ * Checks whether it's worth to delay the match found at \a pos in favor of one starting at the
+ * next positions.
+ * @param  lz   LZSS.
+ * @param  pos  Stream offset of the match.
+ * @param  m    Match found at \a pos.
+ * @param  pow2 Whether the window's buffer is a power of two (see \c window_byte).
+ * @return      \c true if a literal should be emitted instead of the match.
  */
-void lzss_uninit( lzss_t *lz )
+static WINDOW_INLINE bool _is_lazy_better( lzss_t *lz, uint64_t pos, const match_t *m, bool pow2 )
 {
-  match_list_uninit( &lz->ml );
-  window_release( &lz->window );
-  free( lz->current_match );
-  lz->codec = NULL;
+  for( size_t k = 1; k <= lz->lazy_depth && k < lz->pending; k++ )
+  {
+    /* a match reaching the nice length is good enough */
+    if( m->len >= lz->nice_match_len )
+      return false;
+
+    /* the bytes emitted as literals must be paid with a longer match */
+    match_t next;
+    if( _find_cached( lz, pos + k, &next, pow2 ) > m->len + ( k - 1 ) )
+      return true;
+  }
+
+  return false;
+}
+
+
+/**
+ * Updates the price of a node if reaching it through \a token is cheaper.
+ * @param node  Node reached.
+ * @param price Price of the encoding through \a token.
+ * @param token Token leading to the node.
+ */
+static inline void _relax( lzss_node_t *node, size_t price, match_t token )
+{
+  if( price < node->price )
+  {
+    node->price = price;
+    node->token = token;
+  }
+}
+
+
+/**
+ * Encodes the next \a size pending bytes choosing the sequence of tokens with the lowest price.
+ * Every position is searched and all the match lengths of every candidate are priced with the
+ * codec, so the cheapest path from the start to the end of the block can be found in a single
+ * pass (all the tokens reaching a node come from previous positions). The positions of the last
+ * matches are tracked along the cheapest path to each node, so the matches repeating them are
+ * priced as such. A match reaching the nice length ends the block: it's taken after the cheapest
+ * path to its position, however long it is.
+ * @param  lz   LZSS.
+ * @param  size Number of bytes to encode (at most \c block_size).
+ * @param  pow2 Whether the window's buffer is a power of two (see \c window_byte).
+ * @return      Error code.
+ */
+static WINDOW_INLINE lzss_error_t _compress_block_optimal( lzss_t *lz, size_t size, bool pow2 )
+{
+  uint64_t end = window_get_offset( &lz->window );
+  uint64_t start = end - lz->pending;
+  lzss_node_t *nodes = lz->nodes;
+
+  /* match reaching the nice length that ends the block (if any) */
+  match_t nice = { .pos = 0, .len = 0 };
+
+  nodes[0].price = 0;
+  memcpy( nodes[0].reps, lz->reps, sizeof( lz->reps ) );
+  for( size_t i = 1; i <= size; i++ )
+    nodes[i].price = SIZE_MAX;
+
+  for( size_t i = 0; i < size; i++ )
+  {
+    uint64_t pos = start + i;
+    lzss_node_t *node = &nodes[i];
+
+    /* the cheapest path to the node is known by now */
+    if( i > 0 )
+    {
+      size_t from = i - ( ( node->token.len > 0 ) ? node->token.len : 1 );
+      memcpy( node->reps, nodes[from].reps, sizeof( node->reps ) );
+
+      if( node->token.len > 0 )
+        codec_reps_update( node->reps, node->token.pos );
+    }
+
+    char c;
+    if( !window_read_at( &lz->window, &c, pos ) )
+      return lz_error_internal_error;
+
+    match_t literal = { .pos = 0, .len = 0 };
+    _relax( &nodes[i + 1], node->price + lz->codec->price_literal( lz->codec, c ), literal );
+
+    /* the matches repeating the last positions (each one only once) */
+    size_t max_len = MIN( end - pos, lz->max_match_len );
+    size_t longest_rep = 0;
+    match_t best_rep = { .pos = 0, .len = 0 };
+
+    for( size_t r = 0; r < CODEC_NUM_REPS; r++ )
+    {
+      size_t k = 0;
+      while( k < r && node->reps[k] != node->reps[r] )
+        k++;
+      if( k < r )
+        continue;
+
+      size_t rep_len = _rep_length( lz, pos, node->reps[r], max_len, pow2 );
+      if( rep_len > longest_rep )
+      {
+        longest_rep = rep_len;
+        best_rep = ( match_t ){ .pos = node->reps[r], .len = rep_len };
+      }
+
+      for( size_t len = lz->min_match_len; len <= MIN( rep_len, size - i ); len++ )
+      {
+        match_t token = { .pos = node->reps[r], .len = len };
+        _relax( &nodes[i + len], node->price + _price_rep( lz, r, token, pos ), token );
+      }
+    }
+
+    if( longest_rep >= lz->nice_match_len )
+    {
+      nice = best_rep;
+      size = i;
+      break;
+    }
+
+    /* the window isn't searched if a repeat match is long enough */
+    if( longest_rep >= MIN( LZSS_REP_NICE_LEN, max_len ) )
+      continue;
+
+    /* every length up to the longest match is possible, and the cheapest candidate for a given
+     * length is the closest one that reaches it */
+    match_t matches[LZSS_OPTIMAL_MAX_MATCHES];
+    size_t num_matches = _search( lz, pos, max_len, matches, LZSS_OPTIMAL_MAX_MATCHES, pow2 );
+
+    if( num_matches > 0 && matches[num_matches - 1].len >= lz->nice_match_len )
+    {
+      nice = matches[num_matches - 1];
+      size = i;
+      break;
+    }
+
+    size_t len = lz->min_match_len;
+    for( size_t j = 0; j < num_matches; j++ )
+    {
+      /* the tokens can't go past the end of the block */
+      size_t max_len = MIN( matches[j].len, size - i );
+
+      for( ; len <= max_len; len++ )
+      {
+        match_t token = { .pos = matches[j].pos, .len = len };
+        _relax( &nodes[i + len],
+                node->price + lz->codec->price_match( lz->codec, token, pos ),
+                token );
+      }
+    }
+  }
+
+  /* walks the cheapest path backwards, after the match ending the block */
+  size_t num_tokens = 0;
+  if( nice.len > 0 )
+    lz->path[num_tokens++] = nice;
+
+  for( size_t i = size; i > 0; )
+  {
+    lz->path[num_tokens++] = nodes[i].token;
+    i -= ( nodes[i].token.len > 0 ) ? nodes[i].token.len : 1;
+  }
+
+  while( num_tokens > 0 )
+  {
+    match_t token = lz->path[--num_tokens];
+    uint64_t pos = end - lz->pending;
+
+    lzss_error_t error;
+
+    if( token.len > 0 )
+    {
+      error = _emit_match( lz, token );
+      if( error != lzss_error_no_error )
+        return error;
+
+      lz->pending -= token.len;
+    }
+    else
+    {
+      error = _emit_literal( lz, window_byte( &lz->window, pos, pow2 ) );
+      if( error != lzss_error_no_error )
+        return error;
+
+      lz->pending -= 1;
+    }
+  }
+
+  return lzss_error_no_error;
+}
+
+
+/**
+ * Returns the number of bytes that must be buffered ahead of the position being encoded.
+ * @param  lz LZSS.
+ * @return    Lookahead size.
+ */
+static size_t _lookahead( const lzss_t *lz )
+{
+  switch( lz->parser )
+  {
+    case lzss_parser_lazy:
+      return lz->max_match_len + lz->lazy_depth;
+
+    case lzss_parser_optimal:
+      return lz->block_size + lz->max_match_len;
+
+    default:
+      return lz->max_match_len;
+  }
+}
+
+
+/**
+ * Same as \c _compress_pending, reading the window as \a pow2 says (see \c window_byte).
+ * @param  lz          LZSS.
+ * @param  min_pending Minimum number of pending bytes required to encode the next token (the
+ *                     lookahead while streaming, or 1 to flush everything).
+ * @param  pow2        Whether the window's buffer is a power of two (see \c window_byte).
+ * @return             Error code.
+ */
+static WINDOW_INLINE lzss_error_t _parse( lzss_t *lz, size_t min_pending, bool pow2 )
+{
+  while( lz->pending > 0 && lz->pending >= min_pending )
+  {
+    uint64_t pos = window_get_offset( &lz->window ) - lz->pending;
+
+    if( lz->parser == lzss_parser_optimal )
+    {
+      lzss_error_t error = _compress_block_optimal( lz, MIN( lz->pending, lz->block_size ), pow2 );
+      if( error != lzss_error_no_error )
+        return error;
+
+      continue;
+    }
+
+    match_t m, rep;
+    lzss_error_t error;
+    bool take_match;
+
+    size_t max_len = MIN( lz->pending, lz->max_match_len );
+    size_t rep_len;
+
+    if( lz->parser == lzss_parser_greedy )
+    {
+      /* each position is searched once, and the codec still finds out whether the match repeats
+       * a recent position, so neither the cache nor the repeat matches are worth checking */
+      if( _search( lz, pos, max_len, &m, 1, pow2 ) == 0 )
+        m.len = 0;
+
+      take_match = m.len >= lz->min_match_len;
+    }
+    /* a long enough repeat match is taken without searching the window, and otherwise it wins the
+     * ties since it's cheaper */
+    else if( ( rep_len = _find_rep( lz, pos, max_len, &rep, pow2 ) ) >= lz->min_match_len &&
+             rep_len >= MIN( LZSS_REP_NICE_LEN, max_len ) )
+    {
+      m = rep;
+      take_match = true;
+    }
+    else
+    {
+      if( _find_cached( lz, pos, &m, pow2 ) <= rep_len )
+        m = rep;
+
+      take_match = m.len >= lz->min_match_len &&
+                   ( lz->parser != lzss_parser_lazy || !_is_lazy_better( lz, pos, &m, pow2 ) );
+    }
+
+    if( take_match )
+    {
+      error = _emit_match( lz, m );
+      if( error != lzss_error_no_error )
+        return error;
+
+      lz->pending -= m.len;
+    }
+    else
+    {
+      error = _emit_literal( lz, window_byte( &lz->window, pos, pow2 ) );
+      if( error != lzss_error_no_error )
+        return error;
+
+      lz->pending -= 1;
+    }
+  }
+
+  return lzss_error_no_error;
+}
+
+
+/**
+ * Encodes the bytes pending in the window while there are at least \a min_pending of them.
+ * @param  lz          LZSS.
+ * @param  min_pending Minimum number of pending bytes required to encode the next token (the
+ *                     lookahead while streaming, or 1 to flush everything).
+ * @return             Error code.
+ */
+static lzss_error_t _compress_pending( lzss_t *lz, size_t min_pending )
+{
+  /* the window is read the same way all along them */
+  if( window_is_pow2( &lz->window ) )
+    return _parse( lz, min_pending, true );
+
+  return _parse( lz, min_pending, false );
+}
+
+
+/**
+ * Initializes the LZSS to compress/decompress data.
+ * The match finders search up to \c LZSS_DEFAULT_SEARCH_DEPTH candidates and the tokens are
+ * chosen with the greedy parser (see \c lzss_init_params to change them).
+ * @param  lz            LZSS to initialize.
+ * @param  window_size   Size of the window to use.
+ * @param  min_match_len Minimum size of bytes required to be encoded as match.
+ * @param  max_match_len Maximum bytes allowed in a match.
+ * @param  finder        Match finder used to search the window.
+ * @param  codec         Codec used to encode/decode the data.
+ * @return               Error code.
+ */
+lzss_error_t lzss_init( lzss_t *lz,
+                        size_t window_size,
+                        size_t min_match_len,
+                        size_t max_match_len,
+                        lzss_finder_t finder,
+                        codec_t *codec )
+{
+  lzss_params_t params = {
+    .window_size = window_size,
+    .pow2_window = false,
+    .min_match_len = min_match_len,
+    .max_match_len = max_match_len,
+    .finder = finder,
+    .search_depth = LZSS_DEFAULT_SEARCH_DEPTH,
+    .parser = lzss_parser_greedy,
+    .lazy_depth = 0,
+    .block_size = 0
+  };
+
+  return lzss_init_params( lz, &params, codec );
+}
+
+
+/**
+ * Gets the parameters of a compression level.
+ * Since the codec must be created with the same window size and match lengths, this is used to
+ * create the codec before calling \c lzss_init_level (or \c lzss_init_params).
+ * @param  level  Compression level (\c LZSS_MIN_LEVEL to \c LZSS_MAX_LEVEL).
+ * @param  params Parameters of the level.
+ * @return        Error code.
+ */
+lzss_error_t lzss_level_params( int level, lzss_params_t *params )
+{
+  if( level < LZSS_MIN_LEVEL || level > LZSS_MAX_LEVEL )
+    return lzss_error_invalid_params;
+
+  *params = _levels[level - LZSS_MIN_LEVEL];
+  return lzss_error_no_error;
+}
+
+
+/**
+ * Returns the maximum size of the data compressed with the binary codec (created with the same
+ * match lengths and the window size as the maximum position), so the output can be preallocated.
+ * @param  input_len Size of the data to compress.
+ * @param  params    Compression parameters.
+ * @return           Maximum compressed size, or zero if the parameters are not valid.
+ */
+size_t lzss_compress_bound( size_t input_len, const lzss_params_t *params )
+{
+  return binary_codec_bound( input_len,
+                             params->min_match_len,
+                             params->max_match_len,
+                             params->window_size );
+}
+
+
+/**
+ * Initializes the LZSS to compress data with the parameters of a compression level.
+ * @param  lz    LZSS to initialize.
+ * @param  level Compression level (\c LZSS_MIN_LEVEL to \c LZSS_MAX_LEVEL).
+ * @param  codec Codec used to encode the data (created with the parameters of \a level).
+ * @return       Error code.
+ */
+lzss_error_t lzss_init_level( lzss_t *lz, int level, codec_t *codec )
+{
+  lzss_params_t params;
+
+  lzss_error_t error = lzss_level_params( level, &params );
+  if( error != lzss_error_no_error )
+    return error;
+
+  return lzss_init_params( lz, &params, codec );
+}
+
+
+/**
+ * Initializes the LZSS to compress/decompress data with the given parameters.
+ * @param  lz     LZSS to initialize.
+ * @param  params Compression parameters.
+ * @param  codec  Codec used to encode/decode the data.
+ * @return        Error code.
+ */
+lzss_error_t lzss_init_params( lzss_t *lz, const lzss_params_t *params, codec_t *codec )
+{
+  size_t window_size = params->window_size;
+  size_t min_match_len = params->min_match_len;
+
+  if( min_match_len == 0 || min_match_len > params->max_match_len )
+    return lzss_error_invalid_params;
+
+  if( params->nice_match_len > 0 && params->nice_match_len < min_match_len )
+    return lzss_error_invalid_params;
+
+  if( params->parser == lzss_parser_lazy &&
+      ( params->lazy_depth == 0 || params->lazy_depth > LZSS_MAX_LAZY_DEPTH ) )
+    return lzss_error_invalid_params;
+
+  if( params->parser == lzss_parser_optimal && params->block_size == 0 )
+    return lzss_error_invalid_params;
+
+  /* the window finder does its own parsing */
+  if( params->finder == lzss_finder_window && params->parser != lzss_parser_greedy )
+    return lzss_error_invalid_params;
+
+  /* the window finder stores the candidates in 32 and 16 bits */
+  if( params->finder == lzss_finder_window &&
+      ( window_size > UINT32_MAX || params->max_match_len > UINT16_MAX ) )
+    return lzss_error_invalid_params;
+
+  /* sets the other parameters */
+  lz->codec = codec;
+  lz->min_match_len = min_match_len;
+  lz->max_match_len = params->max_match_len;
+  lz->nice_match_len = ( params->nice_match_len > 0 ) ?
+                       MIN( params->nice_match_len, params->max_match_len ) :
+                       params->max_match_len;
+  lz->window_size = window_size;
+  lz->finder = params->finder;
+  lz->parser = params->parser;
+  lz->lazy_depth = params->lazy_depth;
+  lz->block_size = params->block_size;
+  lz->nodes = NULL;
+  lz->path = NULL;
+  lz->seqs.sequences = NULL;
+  lz->seqs.literals = NULL;
+  lz->pending = 0;
+  lz->next_insert = 0;
+  lz->state = lzss_state_init;
+  memset( lz->found, 0, sizeof( lz->found ) );
+  memset( lz->reps, 0, sizeof( lz->reps ) );
+
+  if( lz->finder != lzss_finder_window )
+  {
+    /* the window also buffers the lookahead, so a whole window of history is always available
+     * behind the position being encoded */
+    if( !window_init( &lz->window, window_size + _lookahead( lz ), params->pow2_window ) )
+      return lzss_error_malloc_error;
+
+    bool success;
+    switch( lz->finder )
+    {
+      case lzss_finder_hash_chain:
+        success = hash_chain_init( &lz->hc, window_size, min_match_len, params->search_depth );
+        break;
+
+      case lzss_finder_binary_tree:
+        success = binary_tree_init( &lz->bt, window_size, min_match_len, params->search_depth );
+        break;
+
+      case lzss_finder_scan:
+        success = scan_init( &lz->scan, window_size, min_match_len );
+        break;
+
+      default:
+        success = false;
+        break;
+    }
+
+    if( !success )
+    {
+      window_release( &lz->window );
+      return lzss_error_malloc_error;
+    }
+
+    if( lz->parser == lzss_parser_optimal )
+    {
+      lz->nodes = malloc( ( lz->block_size + 1 ) * sizeof( lzss_node_t ) );
+      lz->path = malloc( lz->block_size * sizeof( match_t ) );
+
+      if( lz->nodes == NULL || lz->path == NULL )
+      {
+        lzss_uninit( lz );
+        return lzss_error_malloc_error;
+      }
+    }
+
+    if( !sequence_store_init( &lz->seqs, LZSS_MAX_SEQUENCES, LZSS_MAX_LITERALS ) )
+    {
+      lzss_uninit( lz );
+      return lzss_error_malloc_error;
+    }
+
+    return lzss_error_no_error;
+  }
+
+  /* initializes the internal window buffer */
+  if( !window_init( &lz->window, window_size, params->pow2_window ) )
+    return lzss_error_malloc_error;
+
+  /* initializes the internal match buffer.
+   * this buffer holds the characters that are currently matching, but have not yet got to the
+   * minimum match length, so the may end up being encoded as literals */
+  lz->current_match_len = 0;
+  lz->run_len = 0;
+  lz->current_match = malloc( min_match_len );
+  if( lz->current_match == NULL )
+    goto error0;
+
+  size_t max_candidates = ( params->max_candidates > 0 ) ?
+                          MIN( params->max_candidates, window_size ) :
+                          window_size;
+
+  if( !match_list_init( &lz->ml, max_candidates ) )
+    goto error1;
+
+  if( !sequence_store_init( &lz->seqs, LZSS_MAX_SEQUENCES, LZSS_MAX_LITERALS ) )
+    goto error2;
+
+  return lzss_error_no_error;
+
+error2:
+  match_list_uninit( &lz->ml );
+
+error1:
+  free( lz->current_match );
+
+error0:
+  window_release( &lz->window );
+
+  return lzss_error_malloc_error;
+}
+
+
+/**
+ * Same as \c lzss_compress, reading the window as \a pow2 says (see \c window_byte).
+ * @param  lz   An already initialized LZSS.
+ * @param  data Data to be compressed.
+ * @param  size Size of \a data.
+ * @param  pow2 Whether the window's buffer is a power of two.
+ * @return      Error code.
+ */
+static WINDOW_INLINE lzss_error_t _compress( lzss_t *lz, const void *data, size_t size, bool pow2 )
+{
+  const byte *bytes = data;
+  lzss_error_t error;
+
+  if( lz->finder != lzss_finder_window )
+  {
+    /* buffers the data in the window and encodes it as soon as there's a full lookahead (the
+     * window can't take more without dropping history still needed by the pending bytes) */
+    size_t lookahead = _lookahead( lz );
+
+    while( size > 0 )
+    {
+      size_t len = MIN( size, lookahead - lz->pending );
+
+      window_append_block( &lz->window, bytes, len );
+      lz->pending += len;
+      bytes += len;
+      size -= len;
+
+      error = _compress_pending( lz, lookahead );
+      if( error != lzss_error_no_error )
+        return error;
+    }
+
+    return lzss_error_no_error;
+  }
+
+  /* compresses byte by byte, except the long runs */
+  for( size_t i = 0; i < size; )
+  {
+    size_t run;
+    error = _compress_run( lz, bytes + i, size - i, &run, pow2 );
+    if( error != lzss_error_no_error )
+      return error;
+
+    if( run > 0 )
+    {
+      i += run;
+      continue;
+    }
+
+    error = _compress_one( lz, bytes[i], pow2 );
+    if( error != lzss_error_no_error )
+      return error;
+
+    i++;
+  }
+
+  /* success */
+  return lzss_error_no_error;
+}
+
+
+/**
+ * Compress some data.
+ * This function can be called many times to compress by chunks.
+ * @param  lz   An already initialized LZSS.
+ * @param  data Data to be compressed.
+ * @param  size Size of \a data.
+ * @return      Error code.
+ */
+lzss_error_t lzss_compress( lzss_t *lz, const void *data, size_t size )
+{
+  /* the window is read the same way all along the data */
+  if( window_is_pow2( &lz->window ) )
+    return _compress( lz, data, size, true );
+
+  return _compress( lz, data, size, false );
+}
+
+
+/**
+ * Ends the compression/decompression.
+ * @param  lz An already initialized and fed LZSS.
+ * @return    Error code.
+ */
+lzss_error_t lzss_end( lzss_t *lz )
+{
+  /* encodes whatever is left in the lookahead */
+  if( lz->finder != lzss_finder_window )
+  {
+    lzss_error_t error = _compress_pending( lz, 1 );
+    if( error != lzss_error_no_error )
+      return error;
+  }
+
+  /* checks if there's data left to be written (the bytes of a run held back go first) */
+  else
+  {
+    lzss_error_t error = _end_run( lz, window_is_pow2( &lz->window ) );
+    if( error != lzss_error_no_error )
+      return error;
+
+    if( match_list_length( &lz->ml ) > 0 )
+    {
+      match_t match;
+
+      /* gets the first match (any match will do since they share the length) */
+      if( !match_list_get( &lz->ml, 0, &match ) )
+        return lz_error_internal_error;
+
+      error = _emit_current_match( lz, match );
+      if( error != lzss_error_no_error )
+        return error;
+    }
+  }
+
+  /* writes the tokens still in the sequence store */
+  lzss_error_t error = _flush_sequences( lz );
+  if( error != lzss_error_no_error )
+    return error;
+
+  /* informs the codec there's no more data left to be processed */
+  if( !lz->codec->close( lz->codec ) )
+    return lzss_error_io_error;
+
+  /* success */
+  return lzss_error_no_error;
+}
+
+
+/**
+ * Releases all resources.
+ * The LZSS cannot be used unless initialized again.
+ * @param lz An initialized LZSS.
+ */
+void lzss_uninit( lzss_t *lz )
+{
+  if( lz->finder == lzss_finder_window )
+  {
+    match_list_uninit( &lz->ml );
+    free( lz->current_match );
+  }
+  else if( lz->finder == lzss_finder_hash_chain )
+    hash_chain_release( &lz->hc );
+  else if( lz->finder == lzss_finder_binary_tree )
+    binary_tree_release( &lz->bt );
+
+  free( lz->nodes );
+  free( lz->path );
+  lz->nodes = NULL;
+  lz->path = NULL;
+
+  sequence_store_release( &lz->seqs );
+  window_release( &lz->window );
+  lz->codec = NULL;
+}
+
+
+/**
+ * Copies a match within the output, writing up to \c LZSS_WILD_COPY - 1 bytes past its end.
+ * @param dst  Where the match is copied.
+ * @param dist Distance to the source (the bytes before \a dst are the source).
+ * @param len  Match length.
+ */
+static inline void _wild_copy( byte *dst, size_t dist, size_t len )
+{
+  const byte *src = dst - dist;
+  byte *end = dst + len;
+
+  if( dist >= LZSS_WILD_COPY )
+  {
+    /* the chunks don't overlap, so they can be copied as whole blocks */
+    do
+    {
+      memcpy( dst, src, LZSS_WILD_COPY );
+      dst += LZSS_WILD_COPY;
+      src += LZSS_WILD_COPY;
+    }
+    while( dst < end );
+  }
+  else if( dist >= sizeof( uint64_t ) )
+  {
+    do
+    {
+      memcpy( dst, src, sizeof( uint64_t ) );
+      dst += sizeof( uint64_t );
+      src += sizeof( uint64_t );
+    }
+    while( dst < end );
+  }
+  else
+  {
+    /* the match repeats the last bytes, so it's filled with a word of the pattern advancing a
+     * multiple of the distance each time (a whole word for distances 1, 2 and 4) */
+    byte pattern[sizeof( uint64_t )];
+    for( size_t i = 0; i < sizeof( pattern ); i++ )
+      pattern[i] = src[i % dist];
+
+    size_t step = sizeof( pattern ) - sizeof( pattern ) % dist;
+    do
+    {
+      memcpy( dst, pattern, sizeof( pattern ) );
+      dst += step;
+    }
+    while( dst < end );
+  }
+}
+
+
+/**
+ * Copies (part of) a match to the output of the decompressor.
+ * The source can be in the bytes decoded by previous calls (the window) or in the output.
+ * @param lz      LZSS decompressing.
+ * @param out     Output buffer.
+ * @param out_len Number of bytes in \a out.
+ * @param out_cap Size of \a out.
+ * @param dist    Distance to the source (position plus one).
+ * @param len     Number of bytes to copy (they must fit in \a out).
+ */
+static void _copy_match( const lzss_t *lz,
+                         byte *out,
+                         size_t out_len,
+                         size_t out_cap,
+                         size_t dist,
+                         size_t len )
+{
+  if( dist > out_len )
+  {
+    size_t n = MIN( len, dist - out_len );
+
+    window_view_t view;
+    window_view( &lz->window, dist - out_len - 1, n, &view );
+
+    memcpy( out + out_len, view.data[0], view.len[0] );
+    if( view.len[1] > 0 )
+      memcpy( out + out_len + view.len[0], view.data[1], view.len[1] );
+
+    out_len += n;
+    len -= n;
+  }
+
+  if( len == 0 )
+    return;
+
+  /* wild copies only with enough room after the match, byte by byte near the end of the buffer */
+  if( out_cap - out_len - len >= LZSS_WILD_COPY )
+    _wild_copy( out + out_len, dist, len );
+  else
+  {
+    for( size_t i = out_len; i < out_len + len; i++ )
+      out[i] = out[i - dist];
+  }
+}
+
+
+/**
+ * Initializes an LZSS to decompress.
+ * Only the last \a window_size bytes decoded are kept, so the memory taken doesn't depend on the
+ * length of the stream.
+ * @param  lz            LZSS to initialize.
+ * @param  window_size   Size of the window used to compress the data.
+ * @param  min_match_len Minimum match length used to compress the data.
+ * @param  max_match_len Maximum match length used to compress the data.
+ * @param  codec         Codec used to decode the data.
+ * @return               Error code.
+ */
+lzss_error_t lzss_decompress_init( lzss_t *lz,
+                                   size_t window_size,
+                                   size_t min_match_len,
+                                   size_t max_match_len,
+                                   codec_t *codec )
+{
+  if( window_size == 0 || min_match_len == 0 || min_match_len > max_match_len )
+    return lzss_error_invalid_params;
+
+  /* the decoder copies whole spans, so it doesn't need a power of two */
+  if( !window_init( &lz->window, window_size, false ) )
+    return lzss_error_malloc_error;
+
+  lz->codec = codec;
+  lz->min_match_len = min_match_len;
+  lz->max_match_len = max_match_len;
+  lz->window_size = window_size;
+  lz->copy.pos = 0;
+  lz->copy.len = 0;
+  lz->state = lzss_state_decoding;
+
+  return lzss_error_no_error;
+}
+
+
+/**
+ * Decompresses some data.
+ * This function can be called many times to decompress by chunks. It stops when the whole input
+ * is consumed or the output is full, so the input not consumed must be passed again on the next
+ * call. Once there's no more input, it must be called with \a in_len zero (as many times as
+ * needed to get the whole output, until \a produced is zero).
+ * The matches are copied within \a out, and the output is added to the window once the call is
+ * over (see \c LZSS_WILD_COPY about its size). Nothing is written past \a out_cap, but up to
+ * \c LZSS_WILD_COPY - 1 bytes past \a produced may be overwritten if \a out has room for them.
+ * @param  lz       An LZSS initialized with \c lzss_decompress_init.
+ * @param  in       Compressed data.
+ * @param  in_len   Size of \a in (zero at the end of the compressed data).
+ * @param  out      Buffer for the decompressed data.
+ * @param  out_cap  Size of \a out.
+ * @param  consumed Number of bytes of \a in consumed.
+ * @param  produced Number of bytes written to \a out.
+ * @return          Error code.
+ */
+lzss_error_t lzss_decompress( lzss_t *lz,
+                              const void *in,
+                              size_t in_len,
+                              void *out,
+                              size_t out_cap,
+                              size_t *consumed,
+                              size_t *produced )
+{
+  codec_input_t input = { .data = in, .size = in_len, .pos = 0, .last = ( in_len == 0 ) };
+  byte *bytes = out;
+  size_t len = 0;
+  size_t history = window_get_size( &lz->window );
+  lzss_error_t error = lzss_error_no_error;
+
+  while( true )
+  {
+    /* copies the match as far as the output allows */
+    if( lz->copy.len > 0 )
+    {
+      size_t n = MIN( lz->copy.len, out_cap - len );
+      if( n == 0 )
+        break;
+
+      _copy_match( lz, bytes, len, out_cap, lz->copy.pos + 1, n );
+      len += n;
+      lz->copy.len -= n;
+      continue;
+    }
+
+    if( len == out_cap || lz->state != lzss_state_decoding )
+      break;
+
+    /* copies whole runs of literals if the codec can (the token after them is read next) */
+    if( lz->codec->read_literals != NULL )
+    {
+      len += lz->codec->read_literals( lz->codec, &input, bytes + len, out_cap - len );
+      if( len == out_cap )
+        break;
+    }
+
+    byte c;
+    match_t m;
+    codec_token_t token = lz->codec->read( lz->codec, &input, &c, &m );
+
+    if( token == codec_token_literal )
+      bytes[len++] = c;
+    else if( token == codec_token_match )
+    {
+      /* the match must be within the window and the data already decoded */
+      if( m.len < lz->min_match_len || m.len > lz->max_match_len || m.pos >= lz->window_size ||
+          m.pos >= history + len )
+      {
+        error = lzss_error_corrupt_data;
+        break;
+      }
+
+      lz->copy = m;
+    }
+    else if( token == codec_token_end )
+      lz->state = lzss_state_decoded;
+    else if( token == codec_token_need_input )
+      break;
+    else
+    {
+      error = lzss_error_corrupt_data;
+      break;
+    }
+  }
+
+  /* the output becomes the history of the next call */
+  window_append_block( &lz->window, bytes, len );
+
+  *consumed = input.pos;
+  *produced = len;
+
+  return error;
+}
+
+
+/**
+ * Ends the decompression, releasing all resources.
+ * The LZSS cannot be used unless initialized again.
+ * @param  lz An LZSS initialized with \c lzss_decompress_init.
+ * @return    Error code (\c lzss_error_corrupt_data if the stream was not completely decoded).
+ */
+lzss_error_t lzss_decompress_end( lzss_t *lz )
+{
+  bool complete = ( lz->state == lzss_state_decoded && lz->copy.len == 0 );
+
+  window_release( &lz->window );
+  lz->codec = NULL;
+
+  return complete ? lzss_error_no_error : lzss_error_corrupt_data;
 }
@@ -7,6 +7,37 @@
 #include "codecs/codec.h"
 #include "window.h"
 #include "match.h"
+#include "hash_chain.h"
+#include "binary_tree.h"
+#include "scan.h"
+#include "sequence.h"
+
+
+/* constants */
+
+/** Default maximum number of candidates checked by the match finders on each search. */
+#define LZSS_DEFAULT_SEARCH_DEPTH 32
+
+/** Maximum number of positions the lazy parser can look ahead. */
+#define LZSS_MAX_LAZY_DEPTH 2
+
+/** Default number of bytes parsed at once by the optimal parser. */
+#define LZSS_DEFAULT_BLOCK_SIZE 4096
+
+/** Room needed after a match in the output of \c lzss_decompress to copy it with wild copies (the
+ *  copy may write up to this many bytes past its end). Matches closer to the end of the output
+ *  buffer are copied byte by byte, so buffers of at least the maximum match length plus this keep
+ *  most copies on the fast path. */
+#define LZSS_WILD_COPY 16
+
+/** Maximum match length of the compression levels (the longest \c lzss_finder_window can track),
+ *  so long repetitions take a single token. */
+#define LZSS_LEVEL_MAX_MATCH_LEN 65535
+
+/** Compression levels accepted by \c lzss_init_level (faster to stronger). */
+#define LZSS_MIN_LEVEL 1
+#define LZSS_MAX_LEVEL 9
+#define LZSS_DEFAULT_LEVEL 5
 
 
 /* data types */
@@ -23,18 +54,135 @@ typedef enum
   /** Failed reading/writing through a codec. */
   lzss_error_io_error,
 
+  /** The parameters are not valid. */
+  lzss_error_invalid_params,
+
+  /** The compressed data is not valid (or it's truncated). */
+  lzss_error_corrupt_data,
+
   /** Something unexpected went wrong (probably a programmer's error). */
   lz_error_internal_error,
 
 } lzss_error_t;
 
 
+/** Match finders. */
+typedef enum
+{
+  /** Scans the whole window tracking every candidate (slow, mostly useful as reference). */
+  lzss_finder_window,
+
+  /** Follows chains of previous positions with the same hash. */
+  lzss_finder_hash_chain,
+
+  /** Keeps the positions sorted in binary trees (slower, but always finds the longest match). */
+  lzss_finder_binary_tree,
+
+  /** Scans the whole window with SIMD instructions (no index to update, for small windows). */
+  lzss_finder_scan,
+
+} lzss_finder_t;
+
+
+/** Parsers (how the tokens are chosen from the matches found). */
+typedef enum
+{
+  /** Takes the longest match found at each position. */
+  lzss_parser_greedy,
+
+  /** Before taking a match, checks whether a longer one starts at the next positions. */
+  lzss_parser_lazy,
+
+  /** Chooses the cheapest sequence of tokens of each block, using the prices of the codec. */
+  lzss_parser_optimal,
+
+} lzss_parser_t;
+
+
+/** Compression parameters. */
+typedef struct
+{
+  /** Size of the window (maximum match distance). */
+  size_t window_size;
+
+  /** Whether the window's buffer is rounded up to a power of two, so the finders index it with a
+   *  mask instead of a division. It takes up to twice the memory: the buffer of the indexed
+   *  finders also holds the lookahead, so a window of 1 << 18 bytes takes 512KB instead of
+   *  256KB plus the lookahead. */
+  bool pow2_window;
+
+  /** Minimum match length. */
+  size_t min_match_len;
+
+  /** Maximum match length. */
+  size_t max_match_len;
+
+  /** Length from which a match is good enough: the finders stop comparing there, and the match
+   *  is extended straight up to \c max_match_len (zero to compare up to \c max_match_len). */
+  size_t nice_match_len;
+
+  /** Match finder used to search the window. */
+  lzss_finder_t finder;
+
+  /** Maximum number of candidates checked per search (hash chain and binary tree finders). */
+  size_t search_depth;
+
+  /** Parser used to choose the tokens. */
+  lzss_parser_t parser;
+
+  /** Number of positions the lazy parser looks ahead (1 to \c LZSS_MAX_LAZY_DEPTH). */
+  size_t lazy_depth;
+
+  /** Number of bytes parsed at once by the optimal parser. */
+  size_t block_size;
+
+  /** Maximum number of candidates tracked by \c lzss_finder_window (zero to track every
+   *  position of the window). The farthest ones are dropped. */
+  size_t max_candidates;
+
+} lzss_params_t;
+
+
+/** Match found at a given position (used to avoid searching twice the same position). */
+typedef struct
+{
+  /** Stream offset plus one of the position searched (zero if the entry is empty). */
+  uint64_t tag;
+
+  /** Longest match found. */
+  match_t match;
+
+} lzss_found_t;
+
+
+/** Node of the optimal parser (a position of the block). */
+typedef struct
+{
+  /** Price (in bits) of the cheapest known encoding of the block up to this position. */
+  size_t price;
+
+  /** Last token of that encoding (a literal if its length is zero). */
+  match_t token;
+
+  /** Positions of the last matches of that encoding (set once the node is reached by the parser,
+   *  see \c codec_reps_update). */
+  size_t reps[CODEC_NUM_REPS];
+
+} lzss_node_t;
+
+
 /** Internal state. */
 typedef enum
 {
   /** First stage of the algorithm. */
   lzss_state_init,
 
+  /** Decoding the tokens of a compressed stream. */
+  lzss_state_decoding,
+
+  /** The whole compressed stream was decoded. */
+  lzss_state_decoded,
+
 } lzss_state_t;
 
 
@@ -50,6 +198,12 @@ typedef struct
   /** Maximum match length. */
   size_t max_match_len;
 
+  /** Length from which the finders stop comparing (see \c lzss_params_t). */
+  size_t nice_match_len;
+
+  /** Size of the window (maximum match distance). */
+  size_t window_size;
+
   /** Window buffer. */
   window_t window;
 
@@ -62,6 +216,56 @@ typedef struct
   /** List of window matches. */
   match_list_t ml;
 
+  /** Bytes of a run reaching the end of the last block, held back (out of the window) in case the
+   *  run goes on with the next one (see \c lzss_compress). */
+  size_t run_len;
+
+  /** Match finder used to search the window. */
+  lzss_finder_t finder;
+
+  /** Hash chains (used by \c lzss_finder_hash_chain). */
+  hash_chain_t hc;
+
+  /** Binary trees (used by \c lzss_finder_binary_tree). */
+  binary_tree_t bt;
+
+  /** Brute force scanner (used by \c lzss_finder_scan). */
+  scan_t scan;
+
+  /** Number of bytes in the window that have not been encoded yet. */
+  size_t pending;
+
+  /** Stream offset of the next position to insert in the match finder. */
+  uint64_t next_insert;
+
+  /** Parser used to choose the tokens. */
+  lzss_parser_t parser;
+
+  /** Number of positions the lazy parser looks ahead. */
+  size_t lazy_depth;
+
+  /** Matches found in the last positions searched. */
+  lzss_found_t found[LZSS_MAX_LAZY_DEPTH + 1];
+
+  /** Number of bytes parsed at once by the optimal parser. */
+  size_t block_size;
+
+  /** Nodes of the optimal parser (one per position of the block plus the end). */
+  lzss_node_t *nodes;
+
+  /** Tokens chosen by the optimal parser (in reverse order). */
+  match_t *path;
+
+  /** Tokens chosen but not written to the codec yet. */
+  sequence_store_t seqs;
+
+  /** Positions of the last matches chosen (the codec can encode them with repeat tokens, see
+   *  \c codec_reps_update). */
+  size_t reps[CODEC_NUM_REPS];
+
+  /** Match being copied to the output by the decompressor (\c len is the number of bytes left). */
+  match_t copy;
+
   /** Current state. */
   lzss_state_t state;
 
@@ -73,10 +277,29 @@ lzss_error_t lzss_init( lzss_t *lz,
                         size_t window_size,
                         size_t min_match_len,
                         size_t max_match_len,
+                        lzss_finder_t finder,
                         codec_t *codec );
+lzss_error_t lzss_init_params( lzss_t *lz, const lzss_params_t *params, codec_t *codec );
+lzss_error_t lzss_level_params( int level, lzss_params_t *params );
+lzss_error_t lzss_init_level( lzss_t *lz, int level, codec_t *codec );
+size_t lzss_compress_bound( size_t input_len, const lzss_params_t *params );
 lzss_error_t lzss_compress( lzss_t *lz, const void *data, size_t size );
 lzss_error_t lzss_end( lzss_t *lz );
 void lzss_uninit( lzss_t *lz );
 
+lzss_error_t lzss_decompress_init( lzss_t *lz,
+                                   size_t window_size,
+                                   size_t min_match_len,
+                                   size_t max_match_len,
+                                   codec_t *codec );
+lzss_error_t lzss_decompress( lzss_t *lz,
+                              const void *in,
+                              size_t in_len,
+                              void *out,
+                              size_t out_cap,
+                              size_t *consumed,
+                              size_t *produced );
+lzss_error_t lzss_decompress_end( lzss_t *lz );
+
 
 #endif
@@ -1,7 +1,11 @@
 /* include area */
 #include <argp.h>
+#include "codecs/ans.h"
 #include "codecs/ascii.h"
 #include "codecs/binary.h"
+#include "codecs/fast.h"
+#include "codecs/huffman.h"
+#include "codecs/range.h"
 #include "lzss.h"
 
 
@@ -24,11 +28,31 @@
   } while(0)
 
 
+/* Codecs the data can be encoded with. */
+typedef enum
+{
+  codec_binary,
+  codec_ascii,
+  codec_fast,
+  codec_huffman,
+  codec_ans,
+  codec_range,
+
+} codec_kind_t;
+
+
+/* Names of the codecs, indexed by their kind. */
+static const char *codec_names[] = { "binary", "ascii", "fast", "huffman", "ans", "range" };
+
+
 /* Used by main to communicate with parse_opt. */
 typedef struct
 {
   /* flags */
-  bool verbose, ascii;
+  bool verbose, decompress;
+
+  /* codec used to encode/decode the data */
+  codec_kind_t codec;
 
   /* file where the output is stored */
   char *output_file;
@@ -36,11 +60,12 @@ typedef struct
   /* file to read data from */
   char *input_file;
 
-  /* window size */
-  size_t window;
+  /* compression level */
+  int level;
 
-  /* minimum match length */
-  size_t min_match;
+  /* match finder (overrides the one of the level if set) */
+  bool custom_finder;
+  lzss_finder_t finder;
 
 } args_t;
 
@@ -54,9 +79,13 @@ static char doc[] = "LZSS compressor";
 /* Accepted options. */
 static struct argp_option options[] = {
   { "verbose",  'v', 0,      0,  "Produce verbose output" },
-  { "ascii",    'a', 0,      0,  "Output in ASCII format instead of binary" },
+  { "ascii",    'a', 0,      0,  "Same as --codec=ascii" },
+  { "codec",    'c', "NAME", 0,  "Codec: binary (default), ascii, fast, huffman, ans or range" },
+  { "decompress", 'd', 0,    0,  "Decompress (with the same level and format used to compress)" },
   { "input",    'i', "FILE", 0,  "Compress from FILE instead of stdin" },
   { "output",   'o', "FILE", 0,  "Output to FILE instead of standard output" },
+  { "level",    'l', "N",    0,  "Compression level from 1 (fastest) to 9 (strongest), 5 by default" },
+  { "finder",   'f', "NAME", 0,  "Match finder: window, hash, tree or scan (overrides the level's)" },
   { 0 }
 };
 
@@ -75,7 +104,25 @@ static error_t parse_opt( int key, char *arg, struct argp_state *state )
       break;
 
     case 'a':
-      arguments->ascii = true;
+      arguments->codec = codec_ascii;
+      break;
+
+    case 'c':
+    {
+      size_t i = 0;
+      while( i < sizeof( codec_names ) / sizeof( codec_names[0] ) &&
+             strcmp( arg, codec_names[i] ) != 0 )
+        i++;
+
+      if( i == sizeof( codec_names ) / sizeof( codec_names[0] ) )
+        argp_error( state, "invalid codec '%s'", arg );
+
+      arguments->codec = i;
+      break;
+    }
+
+    case 'd':
+      arguments->decompress = true;
       break;
 
     case 'o':
@@ -86,6 +133,31 @@ static error_t parse_opt( int key, char *arg, struct argp_state *state )
       arguments->input_file = arg;
       break;
 
+    case 'l':
+    {
+      char *end;
+      long level = strtol( arg, &end, 10 );
+      if( *end != '\0' || level < LZSS_MIN_LEVEL || level > LZSS_MAX_LEVEL )
+        argp_error( state, "invalid compression level '%s'", arg );
+
+      arguments->level = level;
+      break;
+    }
+
+    case 'f':
+      arguments->custom_finder = true;
+      if( strcmp( arg, "window" ) == 0 )
+        arguments->finder = lzss_finder_window;
+      else if( strcmp( arg, "hash" ) == 0 )
+        arguments->finder = lzss_finder_hash_chain;
+      else if( strcmp( arg, "tree" ) == 0 )
+        arguments->finder = lzss_finder_binary_tree;
+      else if( strcmp( arg, "scan" ) == 0 )
+        arguments->finder = lzss_finder_scan;
+      else
+        argp_error( state, "invalid match finder '%s'", arg );
+      break;
+
     case ARGP_KEY_ARG:
       if( state->arg_num >= 0 )
         /* Too many arguments. */
@@ -124,32 +196,80 @@ static bool _codec_out_cb( const void *buffer, size_t buffer_size, void *ctx )
 }
 
 
+/** Creates a codec.
+ *
+ *  \param kind Kind of codec.
+ *  \param output File where the encoded data is written (\c NULL if only used to decode).
+ *  \param params Compression parameters.
+ *  \return The codec or \c NULL on error.
+ */
+static codec_t *_create_codec( codec_kind_t kind, FILE *output, const lzss_params_t *params )
+{
+  codec_out_cb_t cb = ( output != NULL ) ? _codec_out_cb : NULL;
+
+  switch( kind )
+  {
+    case codec_ascii:
+      return ascii_codec_create( cb,
+                                 output,
+                                 params->min_match_len,
+                                 params->max_match_len,
+                                 params->window_size );
+
+    case codec_fast:
+      return fast_codec_create( cb,
+                                output,
+                                params->min_match_len,
+                                params->max_match_len,
+                                params->window_size );
+
+    case codec_huffman:
+      return huffman_codec_create( cb,
+                                   output,
+                                   params->min_match_len,
+                                   params->max_match_len,
+                                   params->window_size );
+
+    case codec_ans:
+      return ans_codec_create( cb,
+                               output,
+                               params->min_match_len,
+                               params->max_match_len,
+                               params->window_size );
+
+    case codec_range:
+      return range_codec_create( cb,
+                                 output,
+                                 params->min_match_len,
+                                 params->max_match_len,
+                                 params->window_size );
+
+    default:
+      return binary_codec_create( cb,
+                                  output,
+                                  params->min_match_len,
+                                  params->max_match_len,
+                                  params->window_size );
+  }
+}
+
+
 /** Compress the file \a input and save it in \a output.
  *
  *  \param output File where the output is written.
  *  \param input File to compress.
- *  \param wsize Window size.
- *  \param min_match Minimum match length.
- *  \param min_match Maximum match length.
+ *  \param params Compression parameters.
+ *  \param kind Codec used to encode the data.
  */
-void compress( FILE *output, FILE *input, size_t wsize, size_t min_match, size_t max_match, bool ascii )
+void compress( FILE *output, FILE *input, const lzss_params_t *params, codec_kind_t kind )
 {
   /* sets the appropriate codec */
-  codec_t *codec = ascii ? ascii_codec_create( _codec_out_cb,
-                                               output,
-                                               min_match,
-                                               max_match,
-                                               wsize ) :
-                           binary_codec_create( _codec_out_cb,
-                                                output,
-                                                min_match,
-                                                max_match,
-                                                wsize );
+  codec_t *codec = _create_codec( kind, output, params );
   if( !codec )
     ABORT( "Codec init error" );
 
   lzss_t lz;
-  lzss_error_t error = lzss_init( &lz, wsize, min_match, max_match, codec );
+  lzss_error_t error = lzss_init_params( &lz, params, codec );
   if( error != lzss_error_no_error )
     ABORT( "Init error." );
 
@@ -176,6 +296,70 @@ void compress( FILE *output, FILE *input, size_t wsize, size_t min_match, size_t
 }
 
 
+/** Decompress the file \a input and save it in \a output.
+ *
+ *  \param output File where the output is written.
+ *  \param input File to decompress.
+ *  \param params Parameters used to compress the file.
+ *  \param kind Codec used to encode the file.
+ */
+void decompress( FILE *output, FILE *input, const lzss_params_t *params, codec_kind_t kind )
+{
+  /* sets the appropriate codec (nothing is output through it) */
+  codec_t *codec = _create_codec( kind, NULL, params );
+  if( !codec )
+    ABORT( "Codec init error" );
+
+  lzss_t lz;
+  lzss_error_t error = lzss_decompress_init( &lz,
+                                             params->window_size,
+                                             params->min_match_len,
+                                             params->max_match_len,
+                                             codec );
+  if( error != lzss_error_no_error )
+    ABORT( "Init error." );
+
+  static byte input_buffer[65536];
+  static byte output_buffer[1 << 20];
+  size_t bytes_read = 0;
+
+  /* runs the LZ algorithm, until the input is over and there's no more output */
+  do
+  {
+    bytes_read = fread( input_buffer, sizeof( byte ), sizeof( input_buffer ), input );
+
+    size_t consumed = 0, produced;
+    do
+    {
+      size_t in_consumed;
+      error = lzss_decompress( &lz,
+                               input_buffer + consumed,
+                               bytes_read - consumed,
+                               output_buffer,
+                               sizeof( output_buffer ),
+                               &in_consumed,
+                               &produced );
+      if( error != lzss_error_no_error )
+        ABORT( "Decompress error." );
+
+      if( fwrite( output_buffer, 1, produced, output ) != produced )
+        ABORT( "Write error." );
+
+      consumed += in_consumed;
+    }
+    while( consumed < bytes_read || ( bytes_read == 0 && produced > 0 ) );
+  }
+  while( bytes_read > 0 );
+
+  /* releases all resources */
+  error = lzss_decompress_end( &lz );
+  if( error != lzss_error_no_error )
+    ABORT( "The compressed data is truncated." );
+
+  codec->destroy( codec );
+}
+
+
 #ifdef __TESTS__
 int _fake_main( int argc, char **argv )
 #else
@@ -185,22 +369,23 @@ int main( int argc, char **argv )
   /* initializes the arguments with the default values */
   args_t arguments = {
     .verbose = false,
-    .ascii = false,
+    .codec = codec_binary,
+    .decompress = false,
     .input_file = "stdin",
     .output_file = "stdout",
-    .window = 10 << 20,
-    .min_match = 8
+    .level = LZSS_DEFAULT_LEVEL,
+    .custom_finder = false
   };
 
   /* parses the user arguments */
   argp_parse( &argp, argc, argv, 0, 0, &arguments );
 
   if( arguments.verbose )
-    printf( "INPUT FILE = %s\nOUTPUT_FILE = %s\nVERBOSE = %s\nASCII = %s\n",
+    printf( "INPUT FILE = %s\nOUTPUT_FILE = %s\nVERBOSE = %s\nCODEC = %s\n",
             arguments.input_file,
             arguments.output_file,
             arguments.verbose ? "yes" : "no",
-            arguments.ascii ? "yes" : "no" );
+            codec_names[arguments.codec] );
 
   FILE *input = stdin;
   if( strcmp( arguments.input_file, "stdin" ) != 0 )
@@ -225,7 +410,23 @@ int main( int argc, char **argv )
     }
   }
 
-  compress( output, input, arguments.window, arguments.min_match, 100, arguments.ascii );
+  lzss_params_t params;
+  if( lzss_level_params( arguments.level, &params ) != lzss_error_no_error )
+    ABORT( "Invalid compression level." );
+
+  if( arguments.custom_finder )
+  {
+    params.finder = arguments.finder;
+
+    /* the window finder only supports the greedy parser */
+    if( params.finder == lzss_finder_window )
+      params.parser = lzss_parser_greedy;
+  }
+
+  if( arguments.decompress )
+    decompress( output, input, &params, arguments.codec );
+  else
+    compress( output, input, &params, arguments.codec );
 
   fclose( input );
   fclose( output );
@@ -1,112 +1,150 @@
 #include "match.h"
 
 
-/** Gets the match from the list at a given (logical) position. */
-#define MATCH_AT( ml, pos )  ( ( ml )->matches[ml->match_idx[pos]] )
-
-
+/**
+ * Initializes a list of matches.
+ * @param  ml   List to initialize.
+ * @param  size Maximum number of matches the list can hold.
+ * @return      \c true on success, \c false otherwise.
+ */
 bool match_list_init( match_list_t *ml, size_t size )
 {
   ml->num_elems = 0;
   ml->list_size = size;
 
-  /* initializes the array of pointers */
-  ml->match_idx = calloc( size, sizeof( match_t * ) );
-  if( ml->match_idx == NULL )
+  ml->pos = malloc( size * sizeof( uint32_t ) );
+  if( ml->pos == NULL )
     return false;
 
-  /* initializes the array of matches */
-  ml->matches = calloc( size, sizeof( match_t ) );
-  if( ml->match_idx == NULL )
+  ml->len = malloc( size * sizeof( uint16_t ) );
+  if( ml->len == NULL )
     goto error0;
 
   return true;
 
 error0:
-  free( ml->match_idx );
+  free( ml->pos );
   return false;
 }
 
 
+/**
+ * Releases the resources taken by the list.
+ * @param ml List of matches.
+ */
 void match_list_uninit( match_list_t *ml )
 {
   ml->list_size = 0;
-  free( ml->match_idx );
-  free( ml->matches );
+  free( ml->pos );
+  free( ml->len );
+  ml->pos = NULL;
+  ml->len = NULL;
 }
 
 
+/**
+ * Appends a match at the end of the list.
+ * @param  ml List of matches.
+ * @param  m  Match to append (its position and length must fit in 32 and 16 bits).
+ * @return    \c true on success, \c false if the list is full.
+ */
 bool match_list_append( match_list_t *ml, const match_t *m )
 {
   /* checks if the list is full */
   if( ml->num_elems >= ml->list_size )
     return false;
 
-  /* FIXME: assumes position not used!!! */
-  match_t *e = &ml->matches[ml->num_elems];
-
-  e->pos = m->pos;
-  e->len = m->len;
-
-  /* sets the pointer to the match */
-  ml->match_idx[ml->num_elems] = e;
-
+  ml->pos[ml->num_elems] = ( uint32_t )m->pos;
+  ml->len[ml->num_elems] = ( uint16_t )m->len;
   ml->num_elems += 1;
 
   return true;
 }
 
 
-size_t match_list_update( match_list_t *ml, ml_update_cb_t cb, void *cb_ctx )
+/**
+ * Same as \c match_list_extend, reading the window as \a pow2 says (see \c window_byte).
+ * @param  ml   List of matches.
+ * @param  w    Window (the positions of the matches must be in it).
+ * @param  c    Next character.
+ * @param  pow2 Whether the window's buffer is a power of two.
+ * @return      Number of matches left.
+ */
+static WINDOW_INLINE size_t _extend( match_list_t *ml, const window_t *w, char c, bool pow2 )
 {
-  size_t index = 0;
-  while( ml->match_idx[index] != NULL )
+  uint64_t end = window_get_offset( w );
+  size_t kept = 0;
+
+  /* compacts the list without branches, so the loop can be vectorized */
+  for( size_t i = 0; i < ml->num_elems; i++ )
   {
-    if( !cb( ml->match_idx[index], cb_ctx ) )
-    {
-      /* reduces the number of elements held in the list */
-      ml->num_elems -= 1;
+    uint32_t pos = ml->pos[i];
+    bool keep = ( window_byte( w, end - pos - 1, pow2 ) == c );
 
-      /* swaps the last element with the element in the current position */
-      ml->match_idx[index] = ml->match_idx[ml->num_elems];
+    ml->pos[kept] = pos;
+    ml->len[kept] = ml->len[i] + 1;
+    kept += keep;
+  }
 
-      /* deletes the last element */
-      ml->match_idx[ml->num_elems] = NULL;
+  ml->num_elems = kept;
+  return kept;
+}
 
-      /* reduces the index because the same position now contains a new element so it must be
-       * checked again */
-      index--;
-    }
 
-    index++;
-  }
+/**
+ * Extends the matches with the next character to be appended into the window.
+ * The matches followed by \a c grow one character, and the rest are removed from the list
+ * (keeping the order of the remaining ones).
+ * Since the window shifts a position with every character appended, the window position of a
+ * match points to its next character until the character is appended.
+ * @param  ml List of matches.
+ * @param  w  Window (the positions of the matches must be in it).
+ * @param  c  Next character.
+ * @return    Number of matches left.
+ */
+size_t match_list_extend( match_list_t *ml, const window_t *w, char c )
+{
+  if( window_is_pow2( w ) )
+    return _extend( ml, w, c, true );
 
-  return ml->num_elems;
+  return _extend( ml, w, c, false );
 }
 
 
+/**
+ * Gets a match from the list.
+ * @param  ml  List of matches.
+ * @param  pos Index of the match in the list.
+ * @param  m   Match (output).
+ * @return     \c true on success, \c false if there's no such match.
+ */
 bool match_list_get( const match_list_t *ml, size_t pos, match_t *m )
 {
   if( pos >= ml->num_elems )
     return false;
 
-  /* gets a pointer to the corresponding match instance */
-  match_t *e = ml->match_idx[pos];
-
-  /* clones the match into the output parameter */
-  m->pos = e->pos;
-  m->len = e->len;
+  m->pos = ml->pos[pos];
+  m->len = ml->len[pos];
 
   return true;
 }
 
 
+/**
+ * Removes all the matches from the list.
+ * @param ml List of matches.
+ */
 void match_list_reset( match_list_t *ml )
 {
   ml->num_elems = 0;
 }
 
 
+/**
+ * Returns the number of matches in the list.
+ * @param  ml List of matches.
+ * @return    Number of matches.
+ */
 size_t match_list_length( const match_list_t *ml )
 {
   return ml->num_elems;
@@ -4,7 +4,9 @@
 
 /* include area */
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include "window.h"
 
 
 /** Patter match type. */
@@ -19,37 +21,32 @@ typedef struct
 } match_t;
 
 
-/** List of matches. */
+/** List of candidate matches, all growing together as new characters arrive.
+ *  The candidates are stored as a structure of arrays (window positions in 32 bits and lengths
+ *  in 16 bits), in the order they were appended. */
 typedef struct
 {
   /** Number of matches in the list. */
   size_t num_elems;
 
-  /** Number of elements in the list. */
+  /** Maximum number of matches the list can hold. */
   size_t list_size;
 
-  /** A list of pointers to each match in the list. */
-  match_t **match_idx;
+  /** Window position of each match. */
+  uint32_t *pos;
 
-  /** The actual list of matches. */
-  match_t *matches;
+  /** Length of each match. */
+  uint16_t *len;
 
 } match_list_t;
 
 
-/** Update callback type.
- *  The callback is called for every match element in the list.
- *  If the return value id \c false, the element is removed from the list.
- *  Otherwise, nothing is done with that element. */
-typedef bool ( *ml_update_cb_t )( match_t *m, void *cb_ctx );
-
-
 /** Prototypes. */
 bool match_list_init( match_list_t *ml, size_t size );
 void match_list_uninit( match_list_t *ml );
 
 bool match_list_append( match_list_t *ml, const match_t *m );
-size_t match_list_update( match_list_t *ml, ml_update_cb_t cb, void *cb_ctx );
+size_t match_list_extend( match_list_t *ml, const window_t *w, char c );
 bool match_list_get( const match_list_t *ml, size_t pos, match_t *m );
 void match_list_reset( match_list_t *ml );
 size_t match_list_length( const match_list_t *ml );
@@ -20,3 +20,14 @@ size_t math_bits_in_n( size_t n )
 
   return num_bits;
 }
+
+
+/**
+ * Calculates the smallest power of two greater than or equal to \a n.
+ * @param  n Number to round up (must be greater than zero).
+ * @return   Power of two.
+ */
+size_t math_next_pow2( size_t n )
+{
+  return ( size_t )1 << math_bits_in_n( n - 1 );
+}
@@ -15,5 +15,6 @@
 /** prototypes  */
 double log2( double n );
 size_t math_bits_in_n( size_t n );
+size_t math_next_pow2( size_t n );
 
 #endif
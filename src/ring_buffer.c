@@ -1,26 +1,62 @@
+/* memfd_create needs the GNU extensions */
+#if defined( __linux__ ) && !defined( LZSS_NO_MIRROR )
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#define RING_BUFFER_MIRROR
+#endif
+
+
 /* include area */
+#include <string.h>
 #include "ring_buffer.h"
 #include "math2.h"
 
+#ifdef RING_BUFFER_MIRROR
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 
 /* implementations */
 
+/**
+ * Sets the capacity of the internal buffer, and the mask mapping the positions into it if it's a
+ * power of two.
+ * @param rb       Ring buffer.
+ * @param capacity Capacity of the internal buffer.
+ */
+static void _set_capacity( ring_buffer_t *rb, size_t capacity )
+{
+  rb->capacity = capacity;
+  rb->mask = ( capacity > 1 && ( capacity & ( capacity - 1 ) ) == 0 ) ? capacity - 1 : 0;
+}
+
+
 /**
  * Initializes a ring buffer with the given size.
+ * Only the last \a size bytes can be read. The internal buffer takes exactly \a size bytes,
+ * unless \a pow2 is set: then it's rounded up to a power of two, so the positions are mapped into
+ * it with a mask instead of a division, at the cost of up to twice the memory.
  * @param  rb   Ring buffer to initialize.
  * @param  size Size of the ring buffer.
+ * @param  pow2 Whether the internal buffer is rounded up to a power of two.
  * @return      \c true on success, \c false otherwise.
  */
-bool ring_buffer_init( ring_buffer_t *rb, size_t size )
+bool ring_buffer_init( ring_buffer_t *rb, size_t size, bool pow2 )
 {
-  if( size == 0 )
+  if( size == 0 || size > ( SIZE_MAX >> 1 ) + 1 )
     return false;
 
-  rb->buffer = malloc( size );
+  size_t capacity = pow2 ? math_next_pow2( size ) : size;
+
+  rb->buffer = malloc( capacity );
   if( rb->buffer == NULL )
     return false;
 
   rb->size = size;
+  _set_capacity( rb, capacity );
+  rb->mirrored = false;
   ring_buffer_reset( rb );
 
   /* success */
@@ -28,13 +64,105 @@ bool ring_buffer_init( ring_buffer_t *rb, size_t size )
 }
 
 
+#ifdef RING_BUFFER_MIRROR
+/**
+ * Maps the same memory twice in a row.
+ * @param  capacity Size of the memory (a multiple of the page size).
+ * @return          Address of the first mapping, or \c NULL on error.
+ */
+static byte *_map_mirrored( size_t capacity )
+{
+  int fd = memfd_create( "lzss_ring_buffer", MFD_CLOEXEC );
+  if( fd < 0 )
+    return NULL;
+
+  if( ftruncate( fd, capacity ) != 0 )
+    goto error0;
+
+  /* reserves the address space for both mappings */
+  byte *addr = mmap( NULL, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if( addr == MAP_FAILED )
+    goto error0;
+
+  if( mmap( addr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) == MAP_FAILED )
+    goto error1;
+
+  if( mmap( addr + capacity,
+            capacity,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED,
+            fd,
+            0 ) == MAP_FAILED )
+    goto error1;
+
+  /* the mappings keep the memory alive */
+  close( fd );
+  return addr;
+
+error1:
+  munmap( addr, 2 * capacity );
+
+error0:
+  close( fd );
+  return NULL;
+}
+#endif
+
+
+/**
+ * Initializes a ring buffer whose memory is mapped twice in a row, so any \a size bytes are
+ * contiguous in memory regardless of where they start (see \c ring_buffer_contiguous).
+ * The internal buffer is rounded up to a whole number of pages (and to a power of two if \a pow2
+ * is set, see \c ring_buffer_init). If the memory can't be mapped (or it's not supported by the
+ * platform), this is the same as \c ring_buffer_init.
+ * @param  rb   Ring buffer to initialize.
+ * @param  size Size of the ring buffer.
+ * @param  pow2 Whether the internal buffer is rounded up to a power of two.
+ * @return      \c true on success, \c false otherwise.
+ */
+bool ring_buffer_init_mirrored( ring_buffer_t *rb, size_t size, bool pow2 )
+{
+#ifdef RING_BUFFER_MIRROR
+  if( size == 0 || size > ( SIZE_MAX >> 2 ) + 1 )
+    return false;
+
+  long page_size = sysconf( _SC_PAGESIZE );
+  size_t capacity = pow2 ? math_next_pow2( size ) : size;
+
+  /* the page size is also a power of two, so a rounded capacity stays one */
+  if( page_size > 0 )
+    capacity = ( capacity + page_size - 1 ) / page_size * page_size;
+
+  byte *buffer = _map_mirrored( capacity );
+  if( buffer != NULL )
+  {
+    rb->buffer = buffer;
+    rb->size = size;
+    _set_capacity( rb, capacity );
+    rb->mirrored = true;
+    ring_buffer_reset( rb );
+
+    return true;
+  }
+#endif
+
+  return ring_buffer_init( rb, size, pow2 );
+}
+
+
 /**
  * Releases resources taken by the ring buffer initialization.
  * @param rb Ring buffer to release.
  */
 void ring_buffer_release( ring_buffer_t *rb )
 {
-  free( rb->buffer );
+#ifdef RING_BUFFER_MIRROR
+  if( rb->mirrored )
+    munmap( rb->buffer, 2 * rb->capacity );
+  else
+#endif
+    free( rb->buffer );
+
   rb->buffer = NULL;
 }
 
@@ -47,11 +175,39 @@ void ring_buffer_release( ring_buffer_t *rb )
  */
 void ring_buffer_append( ring_buffer_t *rb, byte b )
 {
-  rb->buffer[rb->bytes_count % rb->size] = b;
+  rb->buffer[ring_buffer_index( rb, rb->bytes_count )] = b;
   rb->bytes_count += 1;
 }
 
 
+/**
+ * Appends a block of bytes to the ring buffer.
+ * The result is the same as appending the bytes one by one, but they are copied with at most two
+ * \c memcpy (one if the buffer is mirrored).
+ * @param rb   Ring buffer to append the bytes to.
+ * @param data Bytes to append.
+ * @param len  Number of bytes to append.
+ */
+void ring_buffer_append_block( ring_buffer_t *rb, const byte *data, size_t len )
+{
+  size_t capacity = rb->capacity;
+
+  /* the bytes that would be overwritten in the same call are skipped */
+  size_t skip = ( len > capacity ) ? len - capacity : 0;
+  rb->bytes_count += skip;
+  data += skip;
+  len -= skip;
+
+  size_t index = ring_buffer_index( rb, rb->bytes_count );
+  size_t first = MIN( len, ring_buffer_contiguous( rb, rb->bytes_count ) );
+
+  memcpy( rb->buffer + index, data, first );
+  memcpy( rb->buffer, data + first, len - first );
+
+  rb->bytes_count += len;
+}
+
+
 /**
  * Gets a byte at a determined position from the ring buffer.
  * @param  rb  Ring buffer to get the byte from.
@@ -60,16 +216,17 @@ void ring_buffer_append( ring_buffer_t *rb, byte b )
  * @return     \c true is the byte was correctly read, \c false otherwise.
  *
  * \note if the position trying to be read was discarded (or not added yet), the return value will
- *       be \c false.
+ *       be \c false. The check is a single unsigned comparison, so \a pos must be a real
+ *       stream offset: one wrapped around from a negative value would pass it.
  */
 bool ring_buffer_get( const ring_buffer_t *rb, byte *b, uint64_t pos )
 {
-  if( pos >= rb->bytes_count )
-    return false;
-  else if ( rb->bytes_count > rb->size && pos < ( rb->bytes_count - rb->size ) )
+  /* a single comparison: the distance back from the last byte wraps around if \a pos wasn't
+   * written yet */
+  if( rb->bytes_count - 1 - pos >= rb->size )
     return false;
 
-  *b = rb->buffer[pos % rb->size];
+  *b = rb->buffer[ring_buffer_index( rb, pos )];
   return true;
 }
 
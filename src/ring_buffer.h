@@ -15,9 +15,19 @@ typedef struct
   /** Pointer to the internal buffer. */
   byte *buffer;
 
-  /** Ring buffer size. */
+  /** Ring buffer size (number of bytes that can be read back). */
   size_t size;
 
+  /** Capacity of the internal buffer (at least \c size, see \c ring_buffer_init). */
+  size_t capacity;
+
+  /** Capacity minus one if it's a power of two, so the positions are mapped into the buffer with
+   *  a mask, or zero to map them with a division. */
+  size_t mask;
+
+  /** Whether the internal buffer is mapped twice in a row (see \c ring_buffer_init_mirrored). */
+  bool mirrored;
+
   /** Pointer to the oldest byte. */
   byte *start;
 
@@ -28,11 +38,13 @@ typedef struct
 
 
 /* prototypes */
-bool ring_buffer_init( ring_buffer_t *rb, size_t size );
+bool ring_buffer_init( ring_buffer_t *rb, size_t size, bool pow2 );
+bool ring_buffer_init_mirrored( ring_buffer_t *rb, size_t size, bool pow2 );
 void ring_buffer_release( ring_buffer_t *rb );
 
 /* IO */
 void ring_buffer_append( ring_buffer_t *rb, byte b );
+void ring_buffer_append_block( ring_buffer_t *rb, const byte *data, size_t len );
 bool ring_buffer_get( const ring_buffer_t *rb, byte *b, uint64_t pos );
 
 /* misc */
@@ -40,4 +52,60 @@ uint64_t ring_buffer_first_pos( const ring_buffer_t *rb );
 void ring_buffer_reset( ring_buffer_t *rb );
 
 
+/* inline functions */
+
+/**
+ * Maps a position into the internal buffer, whatever its capacity (for the paths mapping a
+ * position once per block, see \c ring_buffer_at for the reads).
+ * @param  rb  Ring buffer.
+ * @param  pos Position.
+ * @return     Index in the internal buffer.
+ */
+static inline size_t ring_buffer_index( const ring_buffer_t *rb, uint64_t pos )
+{
+  return ( rb->mask != 0 ) ? pos & rb->mask : pos % rb->capacity;
+}
+
+
+/**
+ * Gets a byte from the ring buffer without checking whether it is available.
+ * The position is mapped with the mask, so the capacity must be a power of two (\c mask isn't
+ * zero, see \c ring_buffer_at_mod otherwise).
+ * @param  rb  Ring buffer.
+ * @param  pos Position to read from (between \c ring_buffer_first_pos and the number of bytes
+ *             written).
+ * @return     Byte read.
+ */
+static inline byte ring_buffer_at( const ring_buffer_t *rb, uint64_t pos )
+{
+  return rb->buffer[pos & rb->mask];
+}
+
+
+/**
+ * Same as \c ring_buffer_at for any capacity, mapping the position with a division.
+ * @param  rb  Ring buffer.
+ * @param  pos Position to read from (between \c ring_buffer_first_pos and the number of bytes
+ *             written).
+ * @return     Byte read.
+ */
+static inline byte ring_buffer_at_mod( const ring_buffer_t *rb, uint64_t pos )
+{
+  return rb->buffer[pos % rb->capacity];
+}
+
+
+/**
+ * Returns the number of bytes stored contiguously in memory starting at a given position (not
+ * all of them written yet). In a mirrored ring buffer, it's always the whole capacity.
+ * @param  rb  Ring buffer.
+ * @param  pos Position.
+ * @return     Number of contiguous bytes.
+ */
+static inline size_t ring_buffer_contiguous( const ring_buffer_t *rb, uint64_t pos )
+{
+  return rb->mirrored ? rb->capacity : rb->capacity - ring_buffer_index( rb, pos );
+}
+
+
 #endif
@@ -0,0 +1,365 @@
+/* include area */
+#include <string.h>
+#include "scan.h"
+#include "math2.h"
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+
+/**
+ * Scans a block one position at a time.
+ * @see scan_kernel_t
+ */
+static size_t _scan_scalar( const byte *data, size_t size, const byte *prefix, size_t len )
+{
+  for( size_t i = size; i > 0; i-- )
+  {
+    size_t j = 0;
+    while( j < len && data[i - 1 + j] == prefix[j] )
+      j++;
+
+    if( j == len )
+      return i;
+  }
+
+  return 0;
+}
+
+
+#ifdef SCAN_X86
+
+/**
+ * Scans a block 16 positions at a time.
+ * @see scan_kernel_t
+ */
+__attribute__(( target( "sse2" ) ))
+static size_t _scan_sse2( const byte *data, size_t size, const byte *prefix, size_t len )
+{
+  size_t i = size;
+
+  for( ; i >= 16; i -= 16 )
+  {
+    const byte *block = data + i - 16;
+    unsigned int mask = 0xFFFF;
+
+    for( size_t j = 0; j < len && mask != 0; j++ )
+    {
+      __m128i bytes = _mm_loadu_si128( ( const __m128i * )( block + j ) );
+      mask &= ( unsigned int )_mm_movemask_epi8( _mm_cmpeq_epi8( bytes, _mm_set1_epi8( prefix[j] ) ) );
+    }
+
+    if( mask != 0 )
+      return i - 16 + ( 31 - __builtin_clz( mask ) ) + 1;
+  }
+
+  return _scan_scalar( data, i, prefix, len );
+}
+
+
+/**
+ * Scans a block 32 positions at a time.
+ * @see scan_kernel_t
+ */
+__attribute__(( target( "avx2" ) ))
+static size_t _scan_avx2( const byte *data, size_t size, const byte *prefix, size_t len )
+{
+  size_t i = size;
+
+  for( ; i >= 32; i -= 32 )
+  {
+    const byte *block = data + i - 32;
+    uint32_t mask = UINT32_MAX;
+
+    for( size_t j = 0; j < len && mask != 0; j++ )
+    {
+      __m256i bytes = _mm256_loadu_si256( ( const __m256i * )( block + j ) );
+      mask &= ( uint32_t )_mm256_movemask_epi8( _mm256_cmpeq_epi8( bytes,
+                                                                   _mm256_set1_epi8( prefix[j] ) ) );
+    }
+
+    if( mask != 0 )
+      return i - 32 + ( 31 - __builtin_clz( mask ) ) + 1;
+  }
+
+  return _scan_sse2( data, i, prefix, len );
+}
+
+
+/**
+ * Scans a block 64 positions at a time.
+ * @see scan_kernel_t
+ */
+__attribute__(( target( "avx512f,avx512bw" ) ))
+static size_t _scan_avx512( const byte *data, size_t size, const byte *prefix, size_t len )
+{
+  size_t i = size;
+
+  for( ; i >= 64; i -= 64 )
+  {
+    const byte *block = data + i - 64;
+    uint64_t mask = UINT64_MAX;
+
+    for( size_t j = 0; j < len && mask != 0; j++ )
+    {
+      __m512i bytes = _mm512_loadu_si512( ( const void * )( block + j ) );
+      mask &= _mm512_cmpeq_epi8_mask( bytes, _mm512_set1_epi8( prefix[j] ) );
+    }
+
+    if( mask != 0 )
+      return i - 64 + ( 63 - __builtin_clzll( mask ) ) + 1;
+  }
+
+  return _scan_avx2( data, i, prefix, len );
+}
+
+#endif
+
+
+/** Available kernels, from the fastest. */
+static const struct
+{
+  /** Kernel name. */
+  const char *name;
+
+  /** Kernel function. */
+  scan_kernel_t kernel;
+
+} _kernels[] = {
+#ifdef SCAN_X86
+  { "avx512", _scan_avx512 },
+  { "avx2",   _scan_avx2 },
+  { "sse2",   _scan_sse2 },
+#endif
+  { "scalar", _scan_scalar },
+};
+
+
+/**
+ * Checks whether the CPU can run a kernel.
+ * @param  kernel Kernel.
+ * @return        \c true if it's supported, \c false otherwise.
+ */
+static bool _is_supported( scan_kernel_t kernel )
+{
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+
+  if( kernel == _scan_avx512 )
+    return __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" );
+
+  if( kernel == _scan_avx2 )
+    return __builtin_cpu_supports( "avx2" );
+
+  if( kernel == _scan_sse2 )
+    return __builtin_cpu_supports( "sse2" );
+#endif
+
+  return kernel == _scan_scalar;
+}
+
+
+/**
+ * Initializes a brute force match finder, selecting the fastest kernel supported by the CPU.
+ * @param  s             Finder to initialize.
+ * @param  window_size   Maximum match distance.
+ * @param  min_match_len Minimum match length (only this many bytes are compared by the kernels).
+ * @return               \c true on success, \c false otherwise.
+ */
+bool scan_init( scan_t *s, size_t window_size, size_t min_match_len )
+{
+  if( window_size == 0 || min_match_len == 0 )
+    return false;
+
+  s->window_size = window_size;
+  s->prefix_len = MIN( min_match_len, SCAN_MAX_PREFIX );
+  s->kernel = _scan_scalar;
+
+  for( size_t i = 0; i < sizeof( _kernels ) / sizeof( _kernels[0] ); i++ )
+  {
+    if( _is_supported( _kernels[i].kernel ) )
+    {
+      s->kernel = _kernels[i].kernel;
+      break;
+    }
+  }
+
+  return true;
+}
+
+
+/**
+ * Replaces the kernel selected by \c scan_init (e.g. to compare the kernels with each other).
+ * @param  s    Finder.
+ * @param  name Kernel name (see \c scan_kernel_name).
+ * @return      \c true on success, \c false if there's no such kernel or the CPU can't run it.
+ */
+bool scan_set_kernel( scan_t *s, const char *name )
+{
+  for( size_t i = 0; i < sizeof( _kernels ) / sizeof( _kernels[0] ); i++ )
+  {
+    if( strcmp( _kernels[i].name, name ) == 0 && _is_supported( _kernels[i].kernel ) )
+    {
+      s->kernel = _kernels[i].kernel;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+/**
+ * Returns the name of the kernel selected for the CPU.
+ * @param  s Finder.
+ * @return   Kernel name.
+ */
+const char *scan_kernel_name( const scan_t *s )
+{
+  for( size_t i = 0; i < sizeof( _kernels ) / sizeof( _kernels[0] ); i++ )
+  {
+    if( _kernels[i].kernel == s->kernel )
+      return _kernels[i].name;
+  }
+
+  return NULL;
+}
+
+
+/**
+ * Checks a candidate, storing it if it's longer than the previous ones.
+ * @param  w           Window holding the data.
+ * @param  candidate   Stream offset of the candidate.
+ * @param  pos         Stream offset of the string to match.
+ * @param  max_len     Maximum match length.
+ * @param  matches     Matches found.
+ * @param  max_matches Capacity of \a matches.
+ * @param  num_matches Number of matches stored (updated).
+ * @param  pow2        Whether the window's buffer is a power of two (see \c window_byte).
+ * @return             \c true if the search is over (the match can't get longer).
+ */
+static WINDOW_INLINE bool _check( const window_t *w,
+                                  uint64_t candidate,
+                                  uint64_t pos,
+                                  size_t max_len,
+                                  match_t *matches,
+                                  size_t max_matches,
+                                  size_t *num_matches,
+                                  bool pow2 )
+{
+  size_t best_len = ( *num_matches > 0 ) ? matches[*num_matches - 1].len : 0;
+
+  /* the candidate can't improve the best match unless the byte after it matches too */
+  if( best_len > 0 &&
+      window_byte( w, candidate + best_len, pow2 ) != window_byte( w, pos + best_len, pow2 ) )
+    return false;
+
+  size_t len = window_match_length( w, candidate, pos, max_len );
+  if( len > best_len )
+  {
+    if( *num_matches < max_matches )
+      ( *num_matches )++;
+
+    matches[*num_matches - 1].pos = pos - candidate - 1;
+    matches[*num_matches - 1].len = len;
+  }
+
+  return len == max_len;
+}
+
+
+/**
+ * Same as \c scan_find_all, reading the window as \a pow2 says (see \c window_byte).
+ * @param  s           Finder.
+ * @param  w           Window holding the data.
+ * @param  pos         Stream offset of the string to match.
+ * @param  max_len     Maximum match length (at least \c prefix_len bytes must be available).
+ * @param  matches     Matches found (the positions are relative to the byte preceding \a pos).
+ * @param  max_matches Capacity of \a matches (at least 1).
+ * @param  pow2        Whether the window's buffer is a power of two.
+ * @return             Number of matches stored.
+ */
+static WINDOW_INLINE size_t _find_all( const scan_t *s,
+                                       const window_t *w,
+                                       uint64_t pos,
+                                       size_t max_len,
+                                       match_t *matches,
+                                       size_t max_matches,
+                                       bool pow2 )
+{
+  size_t num_matches = 0;
+  size_t len = s->prefix_len;
+
+  byte prefix[SCAN_MAX_PREFIX];
+  for( size_t i = 0; i < len; i++ )
+    prefix[i] = window_byte( w, pos + i, pow2 );
+
+  uint64_t first = ( pos > s->window_size ) ? pos - s->window_size : 0;
+
+  /* the window wraps around at most once, so the candidates are in up to two contiguous blocks */
+  size_t run = 0;
+  if( pos == 0 || window_data_at( w, first, &run ) == NULL )
+    return 0;
+
+  uint64_t starts[2] = { first, first + run };
+  size_t num_blocks = ( starts[1] < pos ) ? 2 : 1;
+
+  /* scans the closest block first */
+  for( size_t b = num_blocks; b > 0; b-- )
+  {
+    uint64_t start = starts[b - 1];
+    uint64_t end = ( b == num_blocks ) ? pos : starts[b];
+    const byte *data = window_data_at( w, start, &run );
+
+    /* the kernels read the whole prefix, so the candidates near the end of the block are checked
+     * one by one */
+    uint64_t vector_end = MIN( end, start + ( ( run >= len ) ? run - len + 1 : 0 ) );
+
+    for( uint64_t c = end; c > vector_end; c-- )
+    {
+      if( _check( w, c - 1, pos, max_len, matches, max_matches, &num_matches, pow2 ) )
+        return num_matches;
+    }
+
+    for( size_t n = vector_end - start; n > 0; n-- )
+    {
+      n = s->kernel( data, n, prefix, len );
+      if( n == 0 )
+        break;
+
+      if( _check( w, start + n - 1, pos, max_len, matches, max_matches, &num_matches, pow2 ) )
+        return num_matches;
+    }
+  }
+
+  return num_matches;
+}
+
+
+/**
+ * Finds the matches for the string at \a pos, scanning the window from the closest position.
+ * Each match stored is longer than the previous one, and it's the closest with its length. If
+ * there are more matches than \a max_matches, the last one is replaced by the longer ones.
+ * @param  s           Finder.
+ * @param  w           Window holding the data.
+ * @param  pos         Stream offset of the string to match.
+ * @param  max_len     Maximum match length (at least \c prefix_len bytes must be available).
+ * @param  matches     Matches found (the positions are relative to the byte preceding \a pos).
+ * @param  max_matches Capacity of \a matches (at least 1).
+ * @return             Number of matches stored.
+ */
+size_t scan_find_all( const scan_t *s,
+                      const window_t *w,
+                      uint64_t pos,
+                      size_t max_len,
+                      match_t *matches,
+                      size_t max_matches )
+{
+  /* the candidates are checked the same way all along the window */
+  if( window_is_pow2( w ) )
+    return _find_all( s, w, pos, max_len, matches, max_matches, true );
+
+  return _find_all( s, w, pos, max_len, matches, max_matches, false );
+}
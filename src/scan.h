@@ -0,0 +1,65 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+
+/* include area */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "datatype.h"
+#include "match.h"
+#include "window.h"
+
+
+/* data types */
+
+/**
+ * Finds the last position of a block where a prefix starts.
+ * @param  data   Block to search (\a prefix_len - 1 bytes past its end must be readable too).
+ * @param  size   Number of positions to check.
+ * @param  prefix Bytes to find.
+ * @param  len    Number of bytes of \a prefix (1 to \c SCAN_MAX_PREFIX).
+ * @return        Position after the last match, or zero if there is none.
+ */
+typedef size_t ( *scan_kernel_t )( const byte *data, size_t size, const byte *prefix, size_t len );
+
+
+/** Brute force match finder.
+ *  Instead of indexing the positions, the whole window is scanned for the first bytes of the
+ *  string with SIMD instructions (the widest ones supported by the CPU, checked at runtime), and
+ *  only the positions where they match are compared further. Meant for small windows, where
+ *  keeping the index up to date costs more than the scan. */
+typedef struct
+{
+  /** Function scanning a contiguous block. */
+  scan_kernel_t kernel;
+
+  /** Number of bytes compared by the kernel. */
+  size_t prefix_len;
+
+  /** Maximum distance of a match. */
+  size_t window_size;
+
+} scan_t;
+
+
+/* constants */
+
+/** Maximum number of bytes compared by the kernels. */
+#define SCAN_MAX_PREFIX 4
+
+
+/* prototypes */
+bool scan_init( scan_t *s, size_t window_size, size_t min_match_len );
+bool scan_set_kernel( scan_t *s, const char *name );
+const char *scan_kernel_name( const scan_t *s );
+
+size_t scan_find_all( const scan_t *s,
+                      const window_t *w,
+                      uint64_t pos,
+                      size_t max_len,
+                      match_t *matches,
+                      size_t max_matches );
+
+
+#endif
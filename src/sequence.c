@@ -0,0 +1,76 @@
+#include "sequence.h"
+
+
+/**
+ * Initializes an empty sequence store.
+ * @param  s             Store to initialize.
+ * @param  max_sequences Maximum number of sequences ending in a match.
+ * @param  max_literals  Maximum number of literals.
+ * @return               \c true on success, \c false otherwise.
+ */
+bool sequence_store_init( sequence_store_t *s, size_t max_sequences, size_t max_literals )
+{
+  if( max_sequences == 0 || max_literals == 0 )
+    return false;
+
+  s->max_sequences = max_sequences;
+  s->max_literals = max_literals;
+  sequence_store_reset( s );
+
+  s->sequences = malloc( ( max_sequences + 1 ) * sizeof( sequence_t ) );
+  if( s->sequences == NULL )
+    return false;
+
+  s->literals = malloc( max_literals );
+  if( s->literals == NULL )
+    goto error0;
+
+  return true;
+
+error0:
+  free( s->sequences );
+  s->sequences = NULL;
+  return false;
+}
+
+
+/**
+ * Releases the resources taken by the store.
+ * @param s Sequence store.
+ */
+void sequence_store_release( sequence_store_t *s )
+{
+  free( s->sequences );
+  free( s->literals );
+  s->sequences = NULL;
+  s->literals = NULL;
+}
+
+
+/**
+ * Puts the last literals stored in a sequence without a match, so every token is in a sequence.
+ * @param s Sequence store.
+ */
+void sequence_store_close( sequence_store_t *s )
+{
+  if( s->run_len == 0 )
+    return;
+
+  sequence_t *seq = &s->sequences[s->num_sequences++];
+  seq->literals_len = s->run_len;
+  seq->match.pos = 0;
+  seq->match.len = 0;
+  s->run_len = 0;
+}
+
+
+/**
+ * Removes all the sequences and literals.
+ * @param s Sequence store.
+ */
+void sequence_store_reset( sequence_store_t *s )
+{
+  s->num_sequences = 0;
+  s->num_literals = 0;
+  s->run_len = 0;
+}
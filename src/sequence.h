@@ -0,0 +1,100 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+
+/* include area */
+#include <stdbool.h>
+#include <stdlib.h>
+#include "datatype.h"
+#include "match.h"
+
+
+/** Sequence of tokens: a run of literals followed by a match. */
+typedef struct
+{
+  /** Number of literals before the match. */
+  size_t literals_len;
+
+  /** Match after the literals (its length is zero if the sequence is only literals, which can
+   *  happen only in the last sequence of a store). */
+  match_t match;
+
+} sequence_t;
+
+
+/** Tokens chosen by the parser, stored until they are encoded all at once.
+ *  The literals of all the sequences are stored together, in order. */
+typedef struct
+{
+  /** Sequences (with room for one more, so the last literals can always be closed). */
+  sequence_t *sequences;
+
+  /** Number of sequences stored. */
+  size_t num_sequences;
+
+  /** Maximum number of sequences ending in a match. */
+  size_t max_sequences;
+
+  /** Literals of all the sequences. */
+  byte *literals;
+
+  /** Number of literals stored. */
+  size_t num_literals;
+
+  /** Maximum number of literals. */
+  size_t max_literals;
+
+  /** Number of literals not in a sequence yet (the last ones stored). */
+  size_t run_len;
+
+} sequence_store_t;
+
+
+/* prototypes */
+bool sequence_store_init( sequence_store_t *s, size_t max_sequences, size_t max_literals );
+void sequence_store_release( sequence_store_t *s );
+void sequence_store_close( sequence_store_t *s );
+void sequence_store_reset( sequence_store_t *s );
+
+
+/* inline functions */
+
+/**
+ * Adds a literal to the current sequence.
+ * @param  s Sequence store.
+ * @param  c Literal.
+ * @return   \c true on success, \c false if the store is full.
+ */
+static inline bool sequence_store_add_literal( sequence_store_t *s, byte c )
+{
+  if( s->num_literals == s->max_literals )
+    return false;
+
+  s->literals[s->num_literals++] = c;
+  s->run_len++;
+
+  return true;
+}
+
+
+/**
+ * Ends the current sequence with a match.
+ * @param  s Sequence store.
+ * @param  m Match.
+ * @return   \c true on success, \c false if the store is full.
+ */
+static inline bool sequence_store_add_match( sequence_store_t *s, match_t m )
+{
+  if( s->num_sequences == s->max_sequences )
+    return false;
+
+  sequence_t *seq = &s->sequences[s->num_sequences++];
+  seq->literals_len = s->run_len;
+  seq->match = m;
+  s->run_len = 0;
+
+  return true;
+}
+
+
+#endif
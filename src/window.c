@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <string.h>
 #include "math2.h"
 #include "window.h"
@@ -5,14 +6,17 @@
 
 /**
  * Initializes a window.
+ * The memory is mirrored when possible, so the strings in the window never wrap around.
  *
  * @param  w           Window to initialize.
  * @param  size        Size of the window.
+ * @param  pow2        Whether the memory is rounded up to a power of two (faster to index, see
+ *                     \c ring_buffer_init).
  * @return             On success \c true, \c false otherwise.
  */
-bool window_init( window_t *w, size_t size )
+bool window_init( window_t *w, size_t size, bool pow2 )
 {
-  if( !ring_buffer_init( &w->rb, size ) )
+  if( !ring_buffer_init_mirrored( &w->rb, size, pow2 ) )
     return false;
 
   w->buffer_size = size;
@@ -47,6 +51,21 @@ void window_append( window_t *w, char c )
 }
 
 
+/**
+ * Appends a block of characters into the window.
+ * The result is the same as appending them one by one with \c window_append.
+ *
+ * @param  w    Window.
+ * @param  data Characters to append.
+ * @param  len  Number of characters to append.
+ */
+void window_append_block( window_t *w, const void *data, size_t len )
+{
+  w->data_size += len;
+  ring_buffer_append_block( &w->rb, data, len );
+}
+
+
 /**
  * Reads a character from the window at a given position.
  *
@@ -57,11 +76,174 @@ void window_append( window_t *w, char c )
  */
 bool window_read( const window_t *w, char *c, size_t pos )
 {
+  /* the stream offset would wrap around */
+  if( pos >= w->data_size )
+    return false;
+
   uint64_t rb_pos = ( w->data_size - pos ) - 1;
   return ring_buffer_get( &w->rb, ( byte * )c, rb_pos );
 }
 
 
+/**
+ * Reads a character from the window given its stream offset (the number of characters appended
+ * before it).
+ *
+ * @param  w      Window.
+ * @param  c      Output character.
+ * @param  offset Stream offset of the character to read.
+ * @return        On success \c true, or \c false if the character is not in the window.
+ */
+bool window_read_at( const window_t *w, char *c, uint64_t offset )
+{
+  return ring_buffer_get( &w->rb, ( byte * )c, offset );
+}
+
+
+/**
+ * Calculates the length of the common prefix of two contiguous memory blocks, comparing a word
+ * at a time.
+ *
+ * @param  a   First block.
+ * @param  b   Second block.
+ * @param  len Size of the blocks.
+ * @return     Number of equal bytes.
+ */
+static size_t _common_prefix( const byte *a, const byte *b, size_t len )
+{
+  size_t i = 0;
+
+  for( ; i + sizeof( uint64_t ) <= len; i += sizeof( uint64_t ) )
+  {
+    uint64_t wa, wb;
+    memcpy( &wa, a + i, sizeof( wa ) );
+    memcpy( &wb, b + i, sizeof( wb ) );
+
+    uint64_t diff = wa ^ wb;
+    if( diff != 0 )
+    {
+#if defined( __GNUC__ ) && defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      /* the first byte in memory is the least significant one */
+      return i + ( __builtin_ctzll( diff ) >> 3 );
+#else
+      break;
+#endif
+    }
+  }
+
+  while( i < len && a[i] == b[i] )
+    i++;
+
+  return i;
+}
+
+
+/**
+ * Calculates the length of the common prefix of the strings starting at the stream offsets \a a
+ * and \a b.
+ * The strings are compared directly in the buffer of the window, in the longest runs that don't
+ * wrap around its end.
+ *
+ * @param  w       Window.
+ * @param  a       Stream offset of the first string.
+ * @param  b       Stream offset of the second string.
+ * @param  max_len Maximum length to compare (both strings must have these bytes available).
+ * @return         Number of equal characters.
+ */
+size_t window_match_length( const window_t *w, uint64_t a, uint64_t b, size_t max_len )
+{
+  const ring_buffer_t *rb = &w->rb;
+  uint64_t first = ring_buffer_first_pos( rb );
+
+  /* only the bytes still in the window can be compared */
+  if( a < first || b < first )
+    return 0;
+
+  uint64_t last = MAX( a, b );
+  if( last >= rb->bytes_count )
+    return 0;
+
+  max_len = MIN( max_len, rb->bytes_count - last );
+
+  size_t len = 0;
+  while( len < max_len )
+  {
+    size_t ia = ring_buffer_index( rb, a + len );
+    size_t ib = ring_buffer_index( rb, b + len );
+    size_t run = MIN( ring_buffer_contiguous( rb, a + len ), ring_buffer_contiguous( rb, b + len ) );
+    run = MIN( run, max_len - len );
+
+    size_t equal = _common_prefix( rb->buffer + ia, rb->buffer + ib, run );
+    len += equal;
+
+    if( equal < run )
+      break;
+  }
+
+  return len;
+}
+
+
+/**
+ * Gets the memory holding the character at a given stream offset.
+ * The characters after it are stored contiguously until the end of the internal buffer (where
+ * the window wraps around, unless its memory is mirrored) or the end of the data.
+ *
+ * @param  w      Window.
+ * @param  offset Stream offset of the character.
+ * @param  run    Number of characters stored contiguously from \a offset (output).
+ * @return        Pointer to the character, or \c NULL if it is not in the window.
+ */
+const byte *window_data_at( const window_t *w, uint64_t offset, size_t *run )
+{
+  const ring_buffer_t *rb = &w->rb;
+
+  if( offset < ring_buffer_first_pos( rb ) || offset >= rb->bytes_count )
+    return NULL;
+
+  size_t index = ring_buffer_index( rb, offset );
+  *run = MIN( ring_buffer_contiguous( rb, offset ), rb->bytes_count - offset );
+
+  return rb->buffer + index;
+}
+
+
+/**
+ * Gets the memory holding \a len characters of the window, starting at a given position and
+ * going towards the most recent one.
+ *
+ * @param  w    Window.
+ * @param  pos  Position in the window of the first character (0 is the most recent one).
+ * @param  len  Number of characters (at most \a pos + 1).
+ * @param  view Contiguous spans holding the characters (output).
+ * @return      On success \c true, or \c false if the characters are not in the window.
+ */
+bool window_view( const window_t *w, size_t pos, size_t len, window_view_t *view )
+{
+  if( len == 0 || len > pos + 1 || pos >= window_get_size( w ) )
+    return false;
+
+  uint64_t offset = ( w->data_size - pos ) - 1;
+
+  size_t run;
+  view->data[0] = window_data_at( w, offset, &run );
+  view->len[0] = MIN( run, len );
+
+  if( view->len[0] < len )
+  {
+    view->data[1] = window_data_at( w, offset + run, &run );
+    view->len[1] = len - view->len[0];
+  }
+  else
+  {
+    view->data[1] = NULL;
+    view->len[1] = 0;
+  }
+
+  return true;
+}
+
+
 /**
  * Returns the number of bytes contained in the window.
  * @param  w Window.
@@ -73,6 +255,18 @@ size_t window_get_size( const window_t *w )
 }
 
 
+/**
+ * Returns the stream offset of the next character to append (that is, the total number of
+ * characters appended since the window was initialized or cleared).
+ * @param  w Window.
+ * @return   Stream offset.
+ */
+uint64_t window_get_offset( const window_t *w )
+{
+  return w->data_size;
+}
+
+
 /**
  * Removes all characters stored in the window.
  * @param w Window.
@@ -8,6 +8,15 @@
 #include "ring_buffer.h"
 
 
+/** Inlines the functions reading the window with a mapping given as a parameter (see
+ *  \c window_byte), so the copy called with each constant maps the offsets one way only. */
+#if defined( __GNUC__ )
+#define WINDOW_INLINE inline __attribute__(( always_inline ))
+#else
+#define WINDOW_INLINE inline
+#endif
+
+
 /** Library data types. */
 
 /** Window type.  */
@@ -25,17 +34,108 @@ typedef struct
 } window_t;
 
 
+/** Characters of the window, in up to two contiguous spans (when they wrap around the end of the
+ *  internal buffer). */
+typedef struct
+{
+  /** First character of each span. */
+  const byte *data[2];
+
+  /** Number of characters of each span (the second one is zero if not needed). */
+  size_t len[2];
+
+} window_view_t;
+
+
 /** Prototypes */
-bool window_init( window_t *w, size_t size );
+bool window_init( window_t *w, size_t size, bool pow2 );
 void window_release( window_t *w );
 
 /* IO */
 void window_append( window_t *w, char c );
+void window_append_block( window_t *w, const void *data, size_t len );
 bool window_read( const window_t *w, char *c, size_t pos );
+bool window_read_at( const window_t *w, char *c, uint64_t offset );
+size_t window_match_length( const window_t *w, uint64_t a, uint64_t b, size_t max_len );
+const byte *window_data_at( const window_t *w, uint64_t offset, size_t *run );
+bool window_view( const window_t *w, size_t pos, size_t len, window_view_t *view );
 
 /* misc */
 size_t window_get_size( const window_t *w );
+uint64_t window_get_offset( const window_t *w );
 void window_clear( window_t *w );
 
 
+/* inline functions */
+
+/**
+ * Returns whether the window's buffer is a power of two, so its offsets can be mapped with a mask
+ * (see \c window_at).
+ * @param  w Window.
+ * @return   \c true if the buffer is a power of two, \c false otherwise.
+ */
+static inline bool window_is_pow2( const window_t *w )
+{
+  return w->rb.mask != 0;
+}
+
+
+/**
+ * Reads a character from the window given its stream offset, without checking whether it is
+ * still in the window (see \c window_read_at for the checked version).
+ * The offset is mapped with a mask, so the window's buffer must be a power of two (see
+ * \c window_is_pow2, and \c window_at_mod otherwise).
+ * @param  w      Window.
+ * @param  offset Stream offset of the character to read (must be in the window).
+ * @return        Character read.
+ */
+static inline char window_at( const window_t *w, uint64_t offset )
+{
+  return ring_buffer_at( &w->rb, offset );
+}
+
+
+/**
+ * Same as \c window_at for a buffer of any size, mapping the offset with a division.
+ * @param  w      Window.
+ * @param  offset Stream offset of the character to read (must be in the window).
+ * @return        Character read.
+ */
+static inline char window_at_mod( const window_t *w, uint64_t offset )
+{
+  return ring_buffer_at_mod( &w->rb, offset );
+}
+
+
+/**
+ * Reads a character with \c window_at if \a pow2, or with \c window_at_mod otherwise.
+ * The finders check \c window_is_pow2 once per search and pass it down as a constant, so their
+ * loops are compiled with a single way of mapping the offsets.
+ * @param  w      Window.
+ * @param  offset Stream offset of the character to read (must be in the window).
+ * @param  pow2   Whether the window's buffer is a power of two.
+ * @return        Character read.
+ */
+static inline char window_byte( const window_t *w, uint64_t offset, bool pow2 )
+{
+  return pow2 ? window_at( w, offset ) : window_at_mod( w, offset );
+}
+
+
+/**
+ * Gets the memory holding the character at a given stream offset, without checking whether it is
+ * still in the window (see \c window_data_at for the checked version).
+ * @param  w      Window.
+ * @param  offset Stream offset of the character (must be in the window).
+ * @param  run    Number of bytes stored contiguously in memory from \a offset, including the ones
+ *                not written yet (output).
+ * @return        Pointer to the character.
+ */
+static inline const byte *window_span_at( const window_t *w, uint64_t offset, size_t *run )
+{
+  *run = ring_buffer_contiguous( &w->rb, offset );
+  return w->rb.buffer + ring_buffer_index( &w->rb, offset );
+}
+
+
 #endif
@@ -0,0 +1,137 @@
+#include "scunit.h"
+#include "codecs/ans.h"
+#include "codec_round_trip.h"
+
+
+/** Shape of a test stream. */
+struct stream
+{
+  /** Every how many tokens there's a match (zero for only literals). */
+  size_t match_every;
+
+  /** Number of distinct literals (the tokens cycle over them). */
+  size_t num_literals;
+};
+
+
+/**
+ * Returns the i-th token of a stream shaped by a \c struct \c stream.
+ * @param  i   Token index.
+ * @param  m   Match (if the token is a match).
+ * @param  ctx Shape of the stream.
+ * @return     The literal, or -1 if the token is a match.
+ */
+static int _shaped_token( size_t i, match_t *m, const void *ctx )
+{
+  const struct stream *s = ctx;
+
+  if( s->match_every > 0 && i % s->match_every == s->match_every - 1 )
+  {
+    m->pos = ( i * 7919 ) % ROUND_TRIP_MAX_POS;
+    m->len = ROUND_TRIP_MIN_MATCH + i % 40;
+    return -1;
+  }
+
+  return 'a' + i % s->num_literals;
+}
+
+
+/**
+ * Returns the i-th token of a stream where a single literal takes nearly the whole block, and
+ * every other literal and a few matches appear once, so their frequencies are the lowest (one) and
+ * the frequency of the common literal is close to the whole scale.
+ * @param  i   Token index.
+ * @param  m   Match (if the token is a match).
+ * @param  ctx Unused.
+ * @return     The literal, or -1 if the token is a match.
+ */
+static int _skewed_token( size_t i, match_t *m, const void *ctx )
+{
+  ( void )ctx;
+
+  /* the rare tokens come in a row every now and then, so they go to every state */
+  size_t rare = i % 1000;
+  if( rare < 6 && i / 1000 < 45 )
+  {
+    size_t index = i / 1000 * 6 + rare;
+    if( index < 255 )
+      return ( index == 'z' ) ? 255 : index;
+
+    m->pos = ROUND_TRIP_MAX_POS - 1 - index;
+    m->len = ROUND_TRIP_MAX_MATCH - index % 8;
+    return -1;
+  }
+
+  return 'z';
+}
+
+
+TEST( AnsBlocks )
+{
+  static struct round_trip_buffer encoded;
+  const size_t num_tokens = 2 * ANS_CODEC_BLOCK_SIZE + 100;
+
+  ASSERT_TRUE( round_trip( ans_codec_create, round_trip_token, NULL, num_tokens, &encoded ) );
+}
+
+
+TEST( AnsStateBoundaries )
+{
+  static struct round_trip_buffer encoded;
+
+  /* the symbols are spread over the states in turn: streams ending at every state, with and
+   * without the offset symbols of the matches after the literal/length ones */
+  const struct stream shapes[] = { { 0, 3 }, { 3, 3 }, { 2, 1 }, { 5, 100 } };
+
+  for( size_t k = 0; k < sizeof( shapes ) / sizeof( shapes[0] ); k++ )
+  {
+    for( size_t n = 0; n <= 2 * 4 + 1; n++ )
+      ASSERT_TRUE( round_trip( ans_codec_create, _shaped_token, &shapes[k], n, &encoded ) );
+
+    /* and around the end of the blocks */
+    for( size_t n = ANS_CODEC_BLOCK_SIZE - 4; n <= ANS_CODEC_BLOCK_SIZE + 4; n++ )
+      ASSERT_TRUE( round_trip( ans_codec_create, _shaped_token, &shapes[k], n, &encoded ) );
+  }
+}
+
+
+TEST( AnsFlush )
+{
+  static struct round_trip_buffer encoded;
+  const struct stream same = { 0, 1 };
+
+  /* an empty stream is a block with just its end, whose frequency is the whole scale (the
+   * header, the tables and the 4 states) */
+  ASSERT_TRUE( round_trip( ans_codec_create, _shaped_token, &same, 0, &encoded ) );
+  ASSERT_TRUE( encoded.size < 48 );
+
+  /* a single token, and a block of a single literal */
+  ASSERT_TRUE( round_trip( ans_codec_create, _shaped_token, &same, 1, &encoded ) );
+  ASSERT_TRUE( round_trip( ans_codec_create, _shaped_token, &same, 1000, &encoded ) );
+  ASSERT_TRUE( encoded.size < 48 );
+
+  /* a full block leaves an empty one to be flushed on close */
+  ASSERT_TRUE( round_trip( ans_codec_create,
+                           _shaped_token,
+                           &same,
+                           ANS_CODEC_BLOCK_SIZE,
+                           &encoded ) );
+  ASSERT_TRUE( encoded.size < 48 );
+}
+
+
+TEST( AnsRenormalization )
+{
+  static struct round_trip_buffer encoded;
+
+  /* the states take a few bytes out for each rare symbol, and none for most of the common ones */
+  ASSERT_TRUE( round_trip( ans_codec_create, _skewed_token, NULL, ANS_CODEC_BLOCK_SIZE, &encoded ) );
+  ASSERT_TRUE( encoded.size < 2048 );
+
+  /* and the same over several blocks */
+  ASSERT_TRUE( round_trip( ans_codec_create,
+                           _skewed_token,
+                           NULL,
+                           3 * ANS_CODEC_BLOCK_SIZE + 17,
+                           &encoded ) );
+}
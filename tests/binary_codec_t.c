@@ -119,10 +119,10 @@ TEST( Matches )
     /* buffer to store the encoded data */
     struct buffer obtained = { { 0 } };
 
-    /* 1 bit as match prefix, 10 zero bits for the position and 4 bits for the match length plus
-       1 bits padding.
+    /* after a single literal the previous byte is the only position, so the match takes just
+       the 2 bits of its prefix and 4 bits for the match length, plus the padding.
        the match length is the min length, so it's encoded as zero */
-    byte expected[] = { 0x80, 0x01 };
+    byte expected[] = { 0x30, 0xc1 };
 
     match_t m = {
       .pos = 0,
@@ -132,12 +132,328 @@ TEST( Matches )
     codec_t *bc = binary_codec_create( _out_cb, &obtained, 2, 10, 1024 );
     ASSERT_NE( NULL, bc );
 
-    bc->write_match( bc, m );
-    bc->close( bc );
+    /* a match can't precede the bytes it repeats */
+    ASSERT_FALSE( bc->write_match( bc, m ) );
+
+    ASSERT_TRUE( bc->write_literal( bc, 'a' ) );
+    ASSERT_EQ( bc->price_match( bc, m, 1 ), 6 );
+    ASSERT_TRUE( bc->write_match( bc, m ) );
+    ASSERT_TRUE( bc->close( bc ) );
 
     ASSERT_EQ( obtained.size, ASIZE( expected ) );
     ASSERT_EQ( memcmp( obtained.b, expected, sizeof( expected ) ), 0 );
 
     bc->destroy( bc );
   }
+
+  /* the parser prices matches before the tokens ahead of them are written: the bucket code of the
+     position is as wide as the bytes before the match make it, not the ones written so far */
+  {
+    struct buffer obtained = { { 0 } };
+
+    match_t m = {
+      .pos = 0,
+      .len = 2
+    };
+
+    codec_t *bc = binary_codec_create( _out_cb, &obtained, 2, 10, 1024 );
+    ASSERT_NE( NULL, bc );
+
+    ASSERT_TRUE( bc->write_literal( bc, 'a' ) );
+    size_t price = bc->price_match( bc, m, 300 );
+
+    /* 5 bits of bucket code for the positions up to 299 */
+    ASSERT_EQ( price, 2 + 5 + 4 );
+
+    for( size_t i = 1; i < 300; i++ )
+      ASSERT_TRUE( bc->write_literal( bc, 'a' ) );
+    ASSERT_EQ( bc->price_match( bc, m, 300 ), price );
+
+    /* and only 2 bits for the positions up to 3 */
+    ASSERT_EQ( bc->price_match( bc, m, 4 ), 2 + 2 + 4 );
+
+    bc->destroy( bc );
+  }
+}
+
+
+TEST( BufferedOutput )
+{
+  struct buffer expected = { { 0 } };
+  struct buffer obtained = { { 0 } };
+
+  codec_t *bc = binary_codec_create( _out_cb, &expected, 2, 10, 1024 );
+  codec_t *small = binary_codec_create_buffered( _out_cb, &obtained, 2, 10, 1024, 8 );
+  ASSERT_NE( NULL, bc );
+  ASSERT_NE( NULL, small );
+  ASSERT_EQ( NULL, binary_codec_create_buffered( _out_cb, &obtained, 2, 10, 1024, 7 ) );
+
+  size_t num_bits = 0;
+  size_t pos = 0;
+
+  for( size_t i = 0; i < 100; i++ )
+  {
+    match_t m = { .pos = i * 3, .len = 2 + i % 9 };
+
+    num_bits += bc->price_literal( bc, i );
+    ASSERT_TRUE( bc->write_literal( bc, i ) );
+    num_bits += bc->price_match( bc, m, pos + 1 );
+    pos += 1 + m.len;
+    ASSERT_TRUE( bc->write_match( bc, m ) );
+    ASSERT_TRUE( small->write_literal( small, i ) );
+    ASSERT_TRUE( small->write_match( small, m ) );
+
+    /* nothing is output until the buffer gets full (the small one holds less than a word) */
+    ASSERT_EQ( expected.size, 0 );
+    ASSERT_TRUE( obtained.size + 8 >= num_bits / 8 );
+  }
+
+  ASSERT_TRUE( bc->close( bc ) );
+  ASSERT_TRUE( small->close( small ) );
+
+  /* the buffer size doesn't change the encoded data (and the prices are exact, since no position
+   * repeats) */
+  ASSERT_EQ( expected.size, num_bits / 8 + 1 );
+  ASSERT_EQ( obtained.size, expected.size );
+  ASSERT_EQ( memcmp( expected.b, obtained.b, expected.size ), 0 );
+
+  bc->destroy( bc );
+  small->destroy( small );
+}
+
+
+TEST( Read )
+{
+  /* buffer to store the encoded data */
+  struct buffer obtained = { { 0 } };
+
+  /* the lengths take 5 bits (the longest ones escaped), and the positions up to 5 bits of bucket
+   * code and 6 extra bits */
+  codec_t *bc = binary_codec_create( _out_cb, &obtained, 3, 257, 65536 );
+  ASSERT_NE( NULL, bc );
+
+  match_t matches[] = { { .pos = 0, .len = 3 }, { .pos = 2, .len = 257 }, { .pos = 0xab, .len = 40 },
+                        { .pos = 2, .len = 4 } };
+
+  ASSERT_TRUE( bc->write_literal( bc, 'x' ) );
+  for( size_t i = 0; i < ASIZE( matches ); i++ )
+    ASSERT_TRUE( bc->write_match( bc, matches[i] ) );
+  ASSERT_TRUE( bc->write_literal( bc, 0xff ) );
+  ASSERT_TRUE( bc->close( bc ) );
+
+  /* 9 + 7 + 19 + 23 + 9 + 9 bits plus the padding (the positions widen with the bytes written, the
+   * two longest lengths are escaped and the last match repeats the second last position) */
+  ASSERT_EQ( obtained.size, 10 );
+  ASSERT_EQ( obtained.b[0], 0x3c );
+  ASSERT_EQ( obtained.b[1], 0x40 );
+  bc->destroy( bc );
+
+  /* reads it back one byte at a time */
+  bc = binary_codec_create( NULL, NULL, 3, 257, 65536 );
+  ASSERT_NE( NULL, bc );
+
+  codec_input_t in = { .data = obtained.b, .size = 0, .pos = 0, .last = false };
+  byte c;
+  match_t m;
+  codec_token_t token;
+
+  while( ( token = bc->read( bc, &in, &c, &m ) ) == codec_token_need_input )
+    in.size++;
+  ASSERT_EQ( token, codec_token_literal );
+  ASSERT_EQ( c, 'x' );
+
+  for( size_t i = 0; i < ASIZE( matches ); i++ )
+  {
+    while( ( token = bc->read( bc, &in, &c, &m ) ) == codec_token_need_input )
+      in.size++;
+    ASSERT_EQ( token, codec_token_match );
+    ASSERT_EQ( m.pos, matches[i].pos );
+    ASSERT_EQ( m.len, matches[i].len );
+  }
+
+  /* the last byte is held back until the end of the input is known */
+  while( ( token = bc->read( bc, &in, &c, &m ) ) == codec_token_need_input && in.size < obtained.size )
+    in.size++;
+  ASSERT_EQ( token, codec_token_need_input );
+
+  in.last = true;
+  ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_literal );
+  ASSERT_EQ( c, 0xff );
+  ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_end );
+  ASSERT_EQ( in.pos, obtained.size );
+
+  bc->destroy( bc );
+
+  /* reads it back at once (refilling 8 bytes at a time) */
+  bc = binary_codec_create( NULL, NULL, 3, 257, 65536 );
+  ASSERT_NE( NULL, bc );
+
+  in = ( codec_input_t ){ .data = obtained.b, .size = obtained.size, .pos = 0, .last = true };
+
+  ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_literal );
+  ASSERT_EQ( c, 'x' );
+
+  for( size_t i = 0; i < ASIZE( matches ); i++ )
+  {
+    ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_match );
+    ASSERT_EQ( m.pos, matches[i].pos );
+    ASSERT_EQ( m.len, matches[i].len );
+  }
+
+  ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_literal );
+  ASSERT_EQ( c, 0xff );
+  ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_end );
+
+  bc->destroy( bc );
+}
+
+
+TEST( WriteSequences )
+{
+  struct buffer expected = { { 0 } };
+  struct buffer obtained = { { 0 } };
+
+  codec_t *bc = binary_codec_create( _out_cb, &expected, 2, 10, 1024 );
+  codec_t *seq = binary_codec_create( _out_cb, &obtained, 2, 10, 1024 );
+  ASSERT_NE( NULL, bc );
+  ASSERT_NE( NULL, seq );
+
+  sequence_store_t s;
+  ASSERT_TRUE( sequence_store_init( &s, 64, 256 ) );
+
+  /* sequences with 1 to 5 literals, the last one without a match */
+  for( size_t i = 0; i < 50; i++ )
+  {
+    match_t m = { .pos = i * 3, .len = 2 + i % 9 };
+
+    for( size_t j = 0; j <= i % 5; j++ )
+    {
+      ASSERT_TRUE( bc->write_literal( bc, i + j ) );
+      ASSERT_TRUE( sequence_store_add_literal( &s, i + j ) );
+    }
+
+    ASSERT_TRUE( bc->write_match( bc, m ) );
+    ASSERT_TRUE( sequence_store_add_match( &s, m ) );
+  }
+
+  ASSERT_TRUE( bc->write_literal( bc, 'z' ) );
+  ASSERT_TRUE( sequence_store_add_literal( &s, 'z' ) );
+  sequence_store_close( &s );
+  ASSERT_EQ( s.num_sequences, 51 );
+
+  ASSERT_TRUE( seq->write_sequences( seq, &s ) );
+  ASSERT_TRUE( bc->close( bc ) );
+  ASSERT_TRUE( seq->close( seq ) );
+
+  /* the same stream as writing the tokens one by one */
+  ASSERT_EQ( obtained.size, expected.size );
+  ASSERT_EQ( memcmp( expected.b, obtained.b, expected.size ), 0 );
+
+  sequence_store_release( &s );
+  bc->destroy( bc );
+  seq->destroy( seq );
+}
+
+
+TEST( RepeatMatches )
+{
+  struct buffer obtained = { { 0 } };
+
+  /* the length takes 4 bits, and the position 5 bits of bucket code and its extra bits once there
+   * are 400 bytes to repeat */
+  codec_t *bc = binary_codec_create( _out_cb, &obtained, 3, 10, 1024 );
+  ASSERT_NE( NULL, bc );
+
+  for( size_t i = 0; i < 400; i++ )
+    ASSERT_TRUE( bc->write_literal( bc, i ) );
+
+  /* new positions, and the ones repeating each of the last 4 positions */
+  match_t matches[] = { { .pos = 100, .len = 5 }, { .pos = 7, .len = 3 }, { .pos = 100, .len = 4 },
+                        { .pos = 100, .len = 10 }, { .pos = 300, .len = 3 }, { .pos = 7, .len = 6 },
+                        { .pos = 0, .len = 3 } };
+
+  ASSERT_TRUE( bc->price_rep( bc, 0, 3 ) < bc->price_match( bc, matches[0], 400 ) );
+
+  for( size_t i = 0; i < ASIZE( matches ); i++ )
+    ASSERT_TRUE( bc->write_match( bc, matches[i] ) );
+  ASSERT_TRUE( bc->close( bc ) );
+
+  /* the literals, the new positions (16, 12 and 18 bits) and 4 repeats of 8 bits, plus the
+   * padding */
+  ASSERT_EQ( obtained.size, ( 400 * 9 + 16 + 12 + 18 + 4 * 8 ) / 8 + 1 );
+  bc->destroy( bc );
+
+  bc = binary_codec_create( NULL, NULL, 3, 10, 1024 );
+  ASSERT_NE( NULL, bc );
+
+  codec_input_t in = { .data = obtained.b, .size = obtained.size, .pos = 0, .last = true };
+  byte c;
+  match_t m;
+
+  for( size_t i = 0; i < 400; i++ )
+  {
+    ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_literal );
+    ASSERT_EQ( c, ( byte )i );
+  }
+
+  for( size_t i = 0; i < ASIZE( matches ); i++ )
+  {
+    ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_match );
+    ASSERT_EQ( m.pos, matches[i].pos );
+    ASSERT_EQ( m.len, matches[i].len );
+  }
+
+  ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_end );
+
+  bc->destroy( bc );
+}
+
+
+TEST( LongMatches )
+{
+  struct buffer obtained = { { 0 } };
+
+  /* the lengths from 4 to 34 take 5 bits, and the longer ones escape to 5 bits of bucket code and
+   * its extra bits */
+  codec_t *bc = binary_codec_create( _out_cb, &obtained, 4, 65535, 1 << 20 );
+  ASSERT_NE( NULL, bc );
+  ASSERT_EQ( bc->price_rep( bc, 0, 34 ), 2 + 2 + 5 );
+  ASSERT_EQ( bc->price_rep( bc, 0, 35 ), 2 + 2 + 5 + 5 );
+  ASSERT_EQ( bc->price_rep( bc, 0, 65535 ), 2 + 2 + 5 + 5 + 14 );
+
+  /* a run of the same byte */
+  match_t matches[] = { { .pos = 0, .len = 4 }, { .pos = 0, .len = 34 }, { .pos = 0, .len = 35 },
+                        { .pos = 0, .len = 36 }, { .pos = 0, .len = 1000 },
+                        { .pos = 0, .len = 65535 } };
+
+  ASSERT_TRUE( bc->write_literal( bc, 'z' ) );
+  for( size_t i = 0; i < ASIZE( matches ); i++ )
+    ASSERT_TRUE( bc->write_match( bc, matches[i] ) );
+  ASSERT_TRUE( bc->close( bc ) );
+
+  /* the literal, the first match (when the position takes no bits) and the repeats, plus the
+   * padding */
+  ASSERT_EQ( obtained.size, ( 9 + 7 + 9 + 14 + 14 + 22 + 28 ) / 8 + 1 );
+  bc->destroy( bc );
+
+  bc = binary_codec_create( NULL, NULL, 4, 65535, 1 << 20 );
+  ASSERT_NE( NULL, bc );
+
+  codec_input_t in = { .data = obtained.b, .size = obtained.size, .pos = 0, .last = true };
+  byte c;
+  match_t m;
+
+  ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_literal );
+  ASSERT_EQ( c, 'z' );
+
+  for( size_t i = 0; i < ASIZE( matches ); i++ )
+  {
+    ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_match );
+    ASSERT_EQ( m.pos, matches[i].pos );
+    ASSERT_EQ( m.len, matches[i].len );
+  }
+
+  ASSERT_EQ( bc->read( bc, &in, &c, &m ), codec_token_end );
+
+  bc->destroy( bc );
 }
@@ -0,0 +1,211 @@
+#ifndef CODEC_ROUND_TRIP_H
+#define CODEC_ROUND_TRIP_H
+
+
+/* include area */
+#include <stdbool.h>
+#include <string.h>
+#include "codecs/codec.h"
+
+
+/* constants */
+
+/** Parameters the codecs under test are created with. */
+#define ROUND_TRIP_MIN_MATCH 3
+#define ROUND_TRIP_MAX_MATCH 302
+#define ROUND_TRIP_MAX_POS 70000
+
+
+/** Encoded data. */
+struct round_trip_buffer
+{
+  byte b[1 << 18];
+
+  size_t size;
+};
+
+
+/** Function creating a codec (like \c huffman_codec_create). */
+typedef codec_t *round_trip_create_t( codec_out_cb_t cb,
+                                      void *cb_ctx,
+                                      size_t min_match_len,
+                                      size_t max_match_len,
+                                      size_t max_pos );
+
+/** Function returning the i-th token of a stream: the literal, or -1 if it's the match \a m. */
+typedef int round_trip_token_t( size_t i, match_t *m, const void *ctx );
+
+
+/* inline functions */
+
+/**
+ * Output callback storing the encoded data.
+ * @param  buffer Encoded data.
+ * @param  size   \a buffer size.
+ * @param  ctx    Buffer where the encoded data is stored.
+ * @return        \c true on success, \c false if it doesn't fit.
+ */
+static inline bool round_trip_out_cb( const void *buffer, size_t size, void *ctx )
+{
+  struct round_trip_buffer *output = ctx;
+
+  if( output->size + size > sizeof( output->b ) )
+    return false;
+
+  memcpy( output->b + output->size, buffer, size );
+  output->size += size;
+
+  return true;
+}
+
+
+/**
+ * Returns the i-th token of the usual test stream: mostly a few literals, with matches of all the
+ * bucket sizes now and then.
+ * @param  i   Token index.
+ * @param  m   Match (if the token is a match).
+ * @param  ctx Unused.
+ * @return     The literal, or -1 if the token is a match.
+ */
+static inline int round_trip_token( size_t i, match_t *m, const void *ctx )
+{
+  ( void )ctx;
+
+  if( i % 7 == 6 )
+  {
+    m->pos = ( i * 2654435761U ) % ROUND_TRIP_MAX_POS;
+    m->len = ROUND_TRIP_MIN_MATCH + ( i / 7 ) % 300;
+    return -1;
+  }
+
+  return "eeeeeetttaaoinshrdlu"[( i * i ) % 20];
+}
+
+
+/**
+ * Encodes a stream of tokens.
+ * @param  create     Function creating the codec.
+ * @param  token      Function returning the tokens.
+ * @param  ctx        Context of \a token.
+ * @param  num_tokens Number of tokens of the stream.
+ * @param  out        Encoded data (output).
+ * @return            \c true on success, \c false otherwise.
+ */
+static inline bool round_trip_encode( round_trip_create_t *create,
+                                      round_trip_token_t *token,
+                                      const void *ctx,
+                                      size_t num_tokens,
+                                      struct round_trip_buffer *out )
+{
+  out->size = 0;
+
+  codec_t *codec = create( round_trip_out_cb,
+                           out,
+                           ROUND_TRIP_MIN_MATCH,
+                           ROUND_TRIP_MAX_MATCH,
+                           ROUND_TRIP_MAX_POS );
+  if( codec == NULL )
+    return false;
+
+  bool success = true;
+  for( size_t i = 0; i < num_tokens && success; i++ )
+  {
+    match_t m;
+    int c = token( i, &m, ctx );
+    success = ( c < 0 ) ? codec->write_match( codec, m ) : codec->write_literal( codec, c );
+  }
+
+  success = success && codec->close( codec );
+  codec->destroy( codec );
+
+  return success;
+}
+
+
+/**
+ * Decodes a stream of tokens and checks it's the expected one, followed by the end of the stream.
+ * @param  create     Function creating the codec.
+ * @param  token      Function returning the expected tokens.
+ * @param  ctx        Context of \a token.
+ * @param  num_tokens Number of tokens of the stream.
+ * @param  in         Encoded data.
+ * @param  at_once    Whether the whole data is given at once (or else a byte at a time).
+ * @return            \c true if the stream is the expected one, \c false otherwise.
+ */
+static inline bool round_trip_decode( round_trip_create_t *create,
+                                      round_trip_token_t *token,
+                                      const void *ctx,
+                                      size_t num_tokens,
+                                      const struct round_trip_buffer *in,
+                                      bool at_once )
+{
+  codec_t *codec = create( NULL,
+                           NULL,
+                           ROUND_TRIP_MIN_MATCH,
+                           ROUND_TRIP_MAX_MATCH,
+                           ROUND_TRIP_MAX_POS );
+  if( codec == NULL )
+    return false;
+
+  codec_input_t input = {
+    .data = in->b,
+    .size = at_once ? in->size : 0,
+    .pos = 0,
+    .last = at_once
+  };
+
+  bool success = true;
+  for( size_t i = 0; i <= num_tokens && success; i++ )
+  {
+    codec_token_t read;
+    byte c;
+    match_t m;
+
+    while( ( read = codec->read( codec, &input, &c, &m ) ) == codec_token_need_input &&
+           input.size < in->size )
+    {
+      input.size++;
+      input.last = ( input.size == in->size );
+    }
+
+    /* the tokens, and then the end */
+    match_t expected_m;
+    int expected = ( i < num_tokens ) ? token( i, &expected_m, ctx ) : 0;
+
+    if( i == num_tokens )
+      success = ( read == codec_token_end && input.pos == in->size );
+    else if( expected < 0 )
+      success = ( read == codec_token_match && m.pos == expected_m.pos &&
+                  m.len == expected_m.len );
+    else
+      success = ( read == codec_token_literal && c == expected );
+  }
+
+  codec->destroy( codec );
+
+  return success;
+}
+
+
+/**
+ * Encodes a stream of tokens, and decodes it back both at once and a byte at a time.
+ * @param  create     Function creating the codec.
+ * @param  token      Function returning the tokens.
+ * @param  ctx        Context of \a token.
+ * @param  num_tokens Number of tokens of the stream.
+ * @param  encoded    Encoded data (output).
+ * @return            \c true if the decoded streams are the same as the encoded one.
+ */
+static inline bool round_trip( round_trip_create_t *create,
+                               round_trip_token_t *token,
+                               const void *ctx,
+                               size_t num_tokens,
+                               struct round_trip_buffer *encoded )
+{
+  return round_trip_encode( create, token, ctx, num_tokens, encoded ) &&
+         round_trip_decode( create, token, ctx, num_tokens, encoded, true ) &&
+         round_trip_decode( create, token, ctx, num_tokens, encoded, false );
+}
+
+
+#endif
@@ -0,0 +1,272 @@
+#include <string.h>
+#include "scunit.h"
+#include "codecs/fast.h"
+#include "codec_round_trip.h"
+#include "sequence.h"
+
+
+#define ASIZE( array )  ( sizeof( array ) / sizeof( array[0] ) )
+
+
+/* buffer with size struct */
+struct buffer
+{
+  byte b[1024];
+
+  size_t size;
+};
+
+
+/**
+ * Output callback used to test the fast codec.
+ * @param  buffer Encoded data.
+ * @param  size   \a buffer size.
+ * @param  ctx    Pointer where the decoded data is stored.
+ * @return        Always \c true.
+ */
+static bool _out_cb( const void *buffer, size_t size, void *ctx )
+{
+  struct buffer *output = ctx;
+
+  memcpy( output->b + output->size, buffer, size );
+  output->size += size;
+
+  return true;
+}
+
+
+/** Tokens of a test stream: some literals followed by a match. */
+struct step
+{
+  /** Number of literals. */
+  size_t num_literals;
+
+  /** Match (zero length if there's none). */
+  match_t match;
+
+  /** Whether the store of sequences is written after the tokens. */
+  bool end_store;
+};
+
+
+/**
+ * Returns the i-th literal of a stream.
+ * @param  i Literal index.
+ * @return   The literal.
+ */
+static byte _literal( size_t i )
+{
+  return i * 31 + i / 7;
+}
+
+
+TEST( FastSequences )
+{
+  struct buffer obtained = { { 0 } };
+
+  codec_t *fc = fast_codec_create( _out_cb, &obtained, 3, 300, 1024 );
+  ASSERT_NE( NULL, fc );
+
+  /* a short sequence, a long match without literals and 20 literals left */
+  ASSERT_TRUE( fc->write_literal( fc, 'a' ) );
+  ASSERT_TRUE( fc->write_literal( fc, 'b' ) );
+  ASSERT_TRUE( fc->write_match( fc, ( match_t ){ .pos = 0x123, .len = 7 } ) );
+  ASSERT_TRUE( fc->write_match( fc, ( match_t ){ .pos = 1, .len = 3 + 15 + 255 + 2 } ) );
+  for( size_t i = 0; i < 20; i++ )
+    ASSERT_TRUE( fc->write_literal( fc, i ) );
+  ASSERT_TRUE( fc->close( fc ) );
+
+  const byte expected[] = { 0x24, 'a', 'b', 0x24, 0x01,
+                            0x0f, 0x02, 0x00, 0xff, 0x02,
+                            0xf0, 0x05 };
+
+  ASSERT_EQ( obtained.size, sizeof( expected ) + 20 + 2 + 3 );
+  ASSERT_EQ( memcmp( expected, obtained.b, sizeof( expected ) ), 0 );
+
+  /* the literals are followed by a zero offset, and the stream ends with an empty sequence */
+  for( size_t i = 0; i < 20; i++ )
+    ASSERT_EQ( obtained.b[sizeof( expected ) + i], i );
+  ASSERT_EQ( obtained.b[obtained.size - 5], 0 );
+  ASSERT_EQ( obtained.b[obtained.size - 4], 0 );
+  ASSERT_EQ( obtained.b[obtained.size - 3], 0 );
+  ASSERT_EQ( obtained.b[obtained.size - 2], 0 );
+  ASSERT_EQ( obtained.b[obtained.size - 1], 0 );
+
+  fc->destroy( fc );
+}
+
+
+TEST( FastRead )
+{
+  struct buffer obtained = { { 0 } };
+
+  /* the offsets take 3 bytes */
+  codec_t *fc = fast_codec_create( _out_cb, &obtained, 2, 1000, 1 << 20 );
+  ASSERT_NE( NULL, fc );
+
+  match_t matches[] = { { .pos = 0xabcde, .len = 2 }, { .pos = 0, .len = 1000 }, { .pos = 7, .len = 40 } };
+
+  for( size_t i = 0; i < ASIZE( matches ); i++ )
+  {
+    for( size_t j = 0; j < i * 10; j++ )
+      ASSERT_TRUE( fc->write_literal( fc, 'a' + j ) );
+    ASSERT_TRUE( fc->write_match( fc, matches[i] ) );
+  }
+
+  ASSERT_TRUE( fc->write_literal( fc, 0xff ) );
+  ASSERT_TRUE( fc->close( fc ) );
+  fc->destroy( fc );
+
+  /* reads it back one byte at a time, and then at once with the literals in runs */
+  for( size_t at_once = 0; at_once < 2; at_once++ )
+  {
+    fc = fast_codec_create( NULL, NULL, 2, 1000, 1 << 20 );
+    ASSERT_NE( NULL, fc );
+
+    codec_input_t in = { .data = obtained.b, .size = at_once ? obtained.size : 0, .pos = 0, .last = false };
+    byte c;
+    match_t m;
+    codec_token_t token;
+
+    for( size_t i = 0; i < ASIZE( matches ); i++ )
+    {
+      byte literals[32];
+      size_t num_literals = 0;
+
+      while( num_literals < i * 10 )
+      {
+        /* the literals after the first one of the run are read at once */
+        size_t n = 0;
+        if( at_once )
+          n = fc->read_literals( fc, &in, literals + num_literals, i * 10 - num_literals );
+
+        if( n > 0 )
+          num_literals += n;
+        else if( ( token = fc->read( fc, &in, &c, &m ) ) == codec_token_need_input )
+          in.size++;
+        else
+        {
+          ASSERT_EQ( token, codec_token_literal );
+          literals[num_literals++] = c;
+        }
+      }
+
+      ASSERT_EQ( num_literals, i * 10 );
+
+      for( size_t j = 0; j < num_literals; j++ )
+        ASSERT_EQ( literals[j], 'a' + j );
+
+      ASSERT_EQ( fc->read_literals( fc, &in, literals, sizeof( literals ) ), 0 );
+      while( ( token = fc->read( fc, &in, &c, &m ) ) == codec_token_need_input )
+        in.size++;
+      ASSERT_EQ( token, codec_token_match );
+      ASSERT_EQ( m.pos, matches[i].pos );
+      ASSERT_EQ( m.len, matches[i].len );
+    }
+
+    while( ( token = fc->read( fc, &in, &c, &m ) ) == codec_token_need_input )
+      in.size++;
+    ASSERT_EQ( token, codec_token_literal );
+    ASSERT_EQ( c, 0xff );
+
+    /* a truncated stream is an error */
+    in.last = true;
+    if( !at_once )
+      ASSERT_EQ( fc->read( fc, &in, &c, &m ), codec_token_error );
+    else
+    {
+      ASSERT_EQ( fc->read( fc, &in, &c, &m ), codec_token_end );
+      ASSERT_EQ( in.pos, obtained.size );
+    }
+
+    fc->destroy( fc );
+  }
+}
+
+
+TEST( FastWriteSequences )
+{
+  static struct round_trip_buffer expected, obtained;
+  sequence_store_t store;
+
+  /* the stores end with literals (the only sequences without a match), which go with the match
+   * opening the next store: first in a sequence of their own, and then buffered before a run
+   * longer than the buffer */
+  const struct step steps[] = {
+    { 2, { .pos = 0x123, .len = 7 }, false },
+    { 0, { .pos = 1, .len = 300 }, false },
+    { 10, { .pos = 0, .len = 0 }, true },
+    { FAST_CODEC_MAX_LITERALS + 100, { .pos = 1000, .len = 3 }, false },
+    { 5, { .pos = 0, .len = 0 }, true },
+    { 0, { .pos = 2, .len = 4 }, true },
+  };
+
+  ASSERT_TRUE( sequence_store_init( &store, ASIZE( steps ), FAST_CODEC_MAX_LITERALS + 200 ) );
+
+  /* the same tokens, one at a time and in stores */
+  codec_t *fc = fast_codec_create( round_trip_out_cb, &expected, 3, 300, 1 << 16 );
+  codec_t *sfc = fast_codec_create( round_trip_out_cb, &obtained, 3, 300, 1 << 16 );
+  ASSERT_NE( NULL, fc );
+  ASSERT_NE( NULL, sfc );
+
+  size_t num_literals = 0;
+  for( size_t i = 0; i < ASIZE( steps ); i++ )
+  {
+    for( size_t j = 0; j < steps[i].num_literals; j++, num_literals++ )
+    {
+      ASSERT_TRUE( fc->write_literal( fc, _literal( num_literals ) ) );
+      ASSERT_TRUE( sequence_store_add_literal( &store, _literal( num_literals ) ) );
+    }
+
+    if( steps[i].match.len > 0 )
+    {
+      ASSERT_TRUE( fc->write_match( fc, steps[i].match ) );
+      ASSERT_TRUE( sequence_store_add_match( &store, steps[i].match ) );
+    }
+
+    if( steps[i].end_store )
+    {
+      sequence_store_close( &store );
+      ASSERT_TRUE( sfc->write_sequences( sfc, &store ) );
+      sequence_store_reset( &store );
+    }
+  }
+
+  ASSERT_TRUE( fc->close( fc ) );
+  ASSERT_TRUE( sfc->close( sfc ) );
+  fc->destroy( fc );
+  sfc->destroy( sfc );
+  sequence_store_release( &store );
+
+  ASSERT_EQ( expected.size, obtained.size );
+  ASSERT_EQ( 0, memcmp( expected.b, obtained.b, obtained.size ) );
+
+  /* reads it back */
+  fc = fast_codec_create( NULL, NULL, 3, 300, 1 << 16 );
+  ASSERT_NE( NULL, fc );
+
+  codec_input_t in = { .data = obtained.b, .size = obtained.size, .pos = 0, .last = true };
+  byte c;
+  match_t m;
+
+  num_literals = 0;
+  for( size_t i = 0; i < ASIZE( steps ); i++ )
+  {
+    for( size_t j = 0; j < steps[i].num_literals; j++, num_literals++ )
+    {
+      ASSERT_EQ( codec_token_literal, fc->read( fc, &in, &c, &m ) );
+      ASSERT_EQ( _literal( num_literals ), c );
+    }
+
+    if( steps[i].match.len > 0 )
+    {
+      ASSERT_EQ( codec_token_match, fc->read( fc, &in, &c, &m ) );
+      ASSERT_EQ( steps[i].match.pos, m.pos );
+      ASSERT_EQ( steps[i].match.len, m.len );
+    }
+  }
+
+  ASSERT_EQ( codec_token_end, fc->read( fc, &in, &c, &m ) );
+  ASSERT_EQ( obtained.size, in.pos );
+  fc->destroy( fc );
+}
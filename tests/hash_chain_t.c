@@ -0,0 +1,131 @@
+#include <string.h>
+#include "hash_chain.h"
+#include "scunit.h"
+
+
+/**
+ * Fills a block with bytes from a small alphabet, so the chains are long.
+ * @param data Block.
+ * @param size Size of \a data.
+ */
+static void _fill( byte *data, size_t size )
+{
+  unsigned int seed = 7;
+  for( size_t i = 0; i < size; i++ )
+  {
+    seed = seed * 1103515245U + 12345U;
+    data[i] = 'a' + ( seed >> 16 ) % 4;
+  }
+}
+
+
+/**
+ * Checks that a position stored in a hash chain is in its window.
+ * @param  hc  Hash chain.
+ * @param  rel Relative position stored.
+ * @param  pos Last position inserted.
+ * @return     \c true if \a rel is empty or in the window, \c false otherwise.
+ */
+static bool _is_in_window( const hash_chain_t *hc, uint32_t rel, uint64_t pos )
+{
+  uint64_t offset = hc->base + rel - 1;
+
+  return rel == 0 || ( offset >= pos - hc->window_size && offset <= pos );
+}
+
+
+/**
+ * Checks that the stored positions of a hash chain are all in its window.
+ * @param  hc  Hash chain.
+ * @param  pos Last position inserted.
+ * @return     \c true if there are no other positions, \c false otherwise.
+ */
+static bool _in_window( const hash_chain_t *hc, uint64_t pos )
+{
+  for( size_t i = 0; i < ( ( size_t )1 << hc->hash_bits ); i++ )
+    if( !_is_in_window( hc, hc->head[i], pos ) )
+      return false;
+
+  for( size_t i = 0; i < hc->window_size; i++ )
+    if( !_is_in_window( hc, hc->prev[i], pos ) )
+      return false;
+
+  return true;
+}
+
+
+TEST( HashChainRebase )
+{
+  #define DATA_SIZE 3000
+  #define HC_WINDOW_SIZE 200
+  #define HASH_LEN 3
+  #define MAX_LEN 32
+  #define MAX_MATCHES 8
+
+  /* the relative positions reach the limit after this many positions */
+  #define FIRST_REBASE 500
+
+  byte data[DATA_SIZE];
+  _fill( data, sizeof( data ) );
+
+  for( int pow2 = 0; pow2 < 2; pow2++ )
+  {
+    window_t w;
+    hash_chain_t reference, hc;
+
+    ASSERT_TRUE( window_init( &w, DATA_SIZE, pow2 ) );
+    window_append_block( &w, data, sizeof( data ) );
+
+    ASSERT_TRUE( hash_chain_init( &reference, HC_WINDOW_SIZE, HASH_LEN, 1000 ) );
+    ASSERT_TRUE( hash_chain_init( &hc, HC_WINDOW_SIZE, HASH_LEN, 1000 ) );
+
+    /* the offsets wrap around, so the positions are the same relative to a base "before" zero */
+    hc.base = UINT64_C( 0 ) - ( HASH_CHAIN_REBASE_LIMIT - FIRST_REBASE );
+
+    for( uint64_t pos = 0; pos + HASH_LEN <= DATA_SIZE; pos++ )
+    {
+      match_t expected[MAX_MATCHES], obtained[MAX_MATCHES];
+      size_t max_len = MIN( MAX_LEN, DATA_SIZE - pos );
+      uint64_t base = hc.base;
+
+      size_t num_expected = hash_chain_find_all( &reference,
+                                                 &w,
+                                                 pos,
+                                                 max_len,
+                                                 expected,
+                                                 MAX_MATCHES );
+      size_t num_obtained = hash_chain_find_all( &hc, &w, pos, max_len, obtained, MAX_MATCHES );
+
+      /* the same matches, before and after rebasing */
+      ASSERT_EQ( num_expected, num_obtained );
+      for( size_t i = 0; i < num_obtained; i++ )
+      {
+        ASSERT_EQ( expected[i].pos, obtained[i].pos );
+        ASSERT_EQ( expected[i].len, obtained[i].len );
+      }
+
+      /* rebased once, dropping the positions out of the window (which are still linked in the
+       * reference) */
+      if( pos == FIRST_REBASE )
+      {
+        ASSERT_NE( base, hc.base );
+        ASSERT_EQ( pos - HC_WINDOW_SIZE, hc.base );
+        ASSERT_TRUE( _in_window( &hc, pos ) );
+        ASSERT_FALSE( _in_window( &reference, pos ) );
+      }
+      else
+        ASSERT_EQ( base, hc.base );
+    }
+
+    hash_chain_release( &reference );
+    hash_chain_release( &hc );
+    window_release( &w );
+  }
+
+  #undef DATA_SIZE
+  #undef HC_WINDOW_SIZE
+  #undef HASH_LEN
+  #undef MAX_LEN
+  #undef MAX_MATCHES
+  #undef FIRST_REBASE
+}
@@ -0,0 +1,360 @@
+#include "scunit.h"
+#include "codecs/bucket.h"
+#include "codecs/huffman.h"
+#include "math2.h"
+#include "codec_round_trip.h"
+
+
+/* Layout of the block headers (see huffman.c). */
+#define LITLEN_COUNT_BITS 9U
+#define OFFSET_COUNT_BITS 7U
+#define CODE_LEN_BITS 4U
+#define ZERO_RUN_BITS 5U
+
+/** Number of literals of \c _fibonacci_token. */
+#define FIBONACCI_LITERALS 20U
+
+
+/**
+ * Returns the i-th token of a stream where the frequencies of the literals are the Fibonacci
+ * numbers from 1, 2 on (the end of block is the first 1), so each symbol is as frequent as the two
+ * before it together and the Huffman tree is a chain as deep as the number of literals (all of
+ * them are in a row).
+ * @param  i   Token index.
+ * @param  m   Unused.
+ * @param  ctx Unused.
+ * @return     The literal.
+ */
+static int _fibonacci_token( size_t i, match_t *m, const void *ctx )
+{
+  ( void )m;
+  ( void )ctx;
+
+  size_t prev = 1, freq = 1, k = 0;
+  while( i >= freq && k < FIBONACCI_LITERALS - 1 )
+  {
+    i -= freq;
+    freq += prev;
+    prev = freq - prev;
+    k++;
+  }
+
+  return 'a' + k;
+}
+
+
+/**
+ * Returns the only token of a stream.
+ * @param  i   Token index (zero).
+ * @param  m   Match (if the token is a match).
+ * @param  ctx Token (a literal if its length is zero, with the literal as its position).
+ * @return     The literal, or -1 if the token is a match.
+ */
+static int _single_token( size_t i, match_t *m, const void *ctx )
+{
+  const match_t *token = ctx;
+  ( void )i;
+
+  if( token->len == 0 )
+    return token->pos;
+
+  *m = *token;
+  return -1;
+}
+
+
+/**
+ * Reads bits of a block header (most significant bit first).
+ * @param  data     Encoded data.
+ * @param  bit      Position of the first bit (updated).
+ * @param  num_bits Number of bits.
+ * @return          Bits read.
+ */
+static size_t _get_bits( const byte *data, size_t *bit, size_t num_bits )
+{
+  size_t bits = 0;
+  for( size_t i = 0; i < num_bits; i++, ( *bit )++ )
+    bits = ( bits << 1 ) | ( ( data[*bit / 8] >> ( 7 - *bit % 8 ) ) & 1 );
+
+  return bits;
+}
+
+
+/**
+ * Writes bits of a block header (most significant bit first) into a zeroed buffer.
+ * @param data     Buffer.
+ * @param bit      Position of the first bit (updated).
+ * @param bits     Bits (the least significant \a num_bits).
+ * @param num_bits Number of bits.
+ */
+static void _put_bits( byte *data, size_t *bit, size_t bits, size_t num_bits )
+{
+  for( size_t i = num_bits; i-- > 0; ( *bit )++ )
+    data[*bit / 8] |= ( ( bits >> i ) & 1 ) << ( 7 - *bit % 8 );
+}
+
+
+/**
+ * Reads the code lengths of the literal/length alphabet of the first block.
+ * @param  data    Encoded data.
+ * @param  lengths Code lengths (as many as symbols).
+ * @return         Number of symbols.
+ */
+static size_t _read_litlen_lengths( const byte *data, byte *lengths )
+{
+  size_t bit = 1;
+  size_t num_symbols = _get_bits( data, &bit, LITLEN_COUNT_BITS );
+
+  for( size_t i = 0; i < num_symbols; )
+  {
+    size_t len = _get_bits( data, &bit, CODE_LEN_BITS );
+    size_t run = ( len == 0 ) ? 1 + _get_bits( data, &bit, ZERO_RUN_BITS ) : 1;
+
+    while( run-- > 0 && i < num_symbols )
+      lengths[i++] = len;
+  }
+
+  return num_symbols;
+}
+
+
+/**
+ * Decodes the first token of some encoded data.
+ * @param  data Encoded data.
+ * @param  size \a data size.
+ * @param  last Whether it's all the data.
+ * @return      The kind of token read, or why none could be read (\c codec_token_end if the
+ *              codec couldn't be created).
+ */
+static codec_token_t _read_first( const byte *data, size_t size, bool last )
+{
+  codec_t *codec = huffman_codec_create( NULL,
+                                         NULL,
+                                         ROUND_TRIP_MIN_MATCH,
+                                         ROUND_TRIP_MAX_MATCH,
+                                         ROUND_TRIP_MAX_POS );
+  if( codec == NULL )
+    return codec_token_end;
+
+  codec_input_t input = { .data = data, .size = size, .pos = 0, .last = last };
+  byte c;
+  match_t m;
+
+  codec_token_t read = codec->read( codec, &input, &c, &m );
+  codec->destroy( codec );
+
+  return read;
+}
+
+
+/**
+ * Encodes the usual test stream into a sink.
+ * @param  sink       Sink.
+ * @param  num_tokens Number of tokens of the stream.
+ * @return            \c true on success, \c false otherwise.
+ */
+static bool _encode_sink( sink_t *sink, size_t num_tokens )
+{
+  codec_t *codec = huffman_codec_create_sink( sink,
+                                              ROUND_TRIP_MIN_MATCH,
+                                              ROUND_TRIP_MAX_MATCH,
+                                              ROUND_TRIP_MAX_POS );
+  if( codec == NULL )
+    return false;
+
+  bool success = true;
+  for( size_t i = 0; i < num_tokens && success; i++ )
+  {
+    match_t m;
+    int c = round_trip_token( i, &m, NULL );
+    success = ( c < 0 ) ? codec->write_match( codec, m ) : codec->write_literal( codec, c );
+  }
+
+  success = success && codec->close( codec );
+  codec->destroy( codec );
+
+  return success;
+}
+
+
+TEST( Buckets )
+{
+  for( size_t value = 0; value < 100000; value++ )
+  {
+    size_t code = bucket_code( value );
+
+    ASSERT_TRUE( code < BUCKET_MAX_CODES );
+    ASSERT_TRUE( value >= bucket_base( code ) );
+    ASSERT_TRUE( value - bucket_base( code ) < ( ( size_t )1 << bucket_extra_bits( code ) ) );
+  }
+
+  ASSERT_EQ( bucket_code( 0xffffffffU ), BUCKET_MAX_CODES - 1 );
+}
+
+
+TEST( HuffmanBlocks )
+{
+  static struct round_trip_buffer encoded;
+  const size_t num_tokens = 2 * HUFFMAN_CODEC_BLOCK_SIZE + 100;
+
+  /* reads it back feeding a byte at a time, and then at once */
+  ASSERT_TRUE( round_trip( huffman_codec_create, round_trip_token, NULL, num_tokens, &encoded ) );
+
+  /* smaller than with the binary codec (9 bits per literal and 1 + 17 + 9 bits per match) */
+  size_t num_matches = num_tokens / 7;
+  ASSERT_TRUE( encoded.size * 8 < ( num_tokens - num_matches ) * 9 + num_matches * 27 );
+}
+
+
+TEST( HuffmanLongCodes )
+{
+  static struct round_trip_buffer encoded;
+  const size_t num_tokens = 28655; /* the Fibonacci numbers from 1, 2 to 10946 */
+  byte lengths[1 << LITLEN_COUNT_BITS];
+
+  ASSERT_TRUE( round_trip( huffman_codec_create, _fibonacci_token, NULL, num_tokens, &encoded ) );
+
+  /* the chain would be 20 deep: the deepest codes are cut down to the limit, and the lengths are
+   * still a prefix code */
+  size_t num_symbols = _read_litlen_lengths( encoded.b, lengths );
+  size_t max_len = 0, kraft = 0;
+
+  ASSERT_EQ( 257U, num_symbols );
+  for( size_t i = 0; i < num_symbols; i++ )
+  {
+    if( lengths[i] == 0 )
+      continue;
+
+    ASSERT_TRUE( lengths[i] <= HUFFMAN_CODEC_MAX_CODE_BITS );
+    max_len = MAX( max_len, lengths[i] );
+    kraft += ( size_t )1 << ( HUFFMAN_CODEC_MAX_CODE_BITS - lengths[i] );
+  }
+
+  ASSERT_EQ( HUFFMAN_CODEC_MAX_CODE_BITS, max_len );
+  ASSERT_TRUE( kraft <= ( ( size_t )1 << HUFFMAN_CODEC_MAX_CODE_BITS ) );
+
+  /* the most frequent literal keeps its code of a bit */
+  ASSERT_EQ( 1, lengths['a' + FIBONACCI_LITERALS - 1] );
+}
+
+
+TEST( HuffmanSingleSymbol )
+{
+  static struct round_trip_buffer encoded;
+  const match_t literal = { .pos = 'x', .len = 0 };
+  const match_t match = { .pos = 1000, .len = ROUND_TRIP_MIN_MATCH };
+
+  /* an empty stream has only the end of block, and a match the only offset, with a code of a
+   * bit */
+  ASSERT_TRUE( round_trip( huffman_codec_create, _single_token, &literal, 0, &encoded ) );
+  ASSERT_TRUE( round_trip( huffman_codec_create, _single_token, &literal, 1, &encoded ) );
+  ASSERT_TRUE( round_trip( huffman_codec_create, _single_token, &match, 1, &encoded ) );
+}
+
+
+TEST( HuffmanSink )
+{
+  static struct round_trip_buffer expected;
+  static byte buffer[sizeof( expected.b )];
+  const size_t num_tokens = 2 * HUFFMAN_CODEC_BLOCK_SIZE + 100;
+  sink_t sink;
+
+  ASSERT_TRUE( round_trip_encode( huffman_codec_create,
+                                  round_trip_token,
+                                  NULL,
+                                  num_tokens,
+                                  &expected ) );
+
+  /* a buffer of the exact size takes the last bytes one at a time */
+  sink_init_buffer( &sink, buffer, expected.size );
+  ASSERT_TRUE( _encode_sink( &sink, num_tokens ) );
+  ASSERT_EQ( expected.size, sink.len );
+  ASSERT_EQ( 0, memcmp( expected.b, buffer, expected.size ) );
+
+  /* and a byte less fails */
+  sink_init_buffer( &sink, buffer, expected.size - 1 );
+  ASSERT_FALSE( _encode_sink( &sink, num_tokens ) );
+  ASSERT_TRUE( sink.len < expected.size );
+}
+
+
+TEST( HuffmanBadHeaders )
+{
+  static struct round_trip_buffer encoded;
+  byte header[256];
+  size_t bit;
+
+  /* a header cut short is an error at the end of the input, and needs more input otherwise */
+  ASSERT_TRUE( round_trip_encode( huffman_codec_create, round_trip_token, NULL, 1000, &encoded ) );
+  for( size_t size = 0; size < 8; size++ )
+  {
+    ASSERT_EQ( codec_token_error, _read_first( encoded.b, size, true ) );
+    ASSERT_EQ( codec_token_need_input, _read_first( encoded.b, size, false ) );
+  }
+
+  /* no end of block */
+  memset( header, 0, sizeof( header ) );
+  bit = 0;
+  _put_bits( header, &bit, 1, 1 );
+  _put_bits( header, &bit, 256, LITLEN_COUNT_BITS );
+  ASSERT_EQ( codec_token_error, _read_first( header, sizeof( header ), true ) );
+
+  /* more length symbols than the longest match needs */
+  memset( header, 0, sizeof( header ) );
+  bit = 0;
+  _put_bits( header, &bit, 1, 1 );
+  _put_bits( header, &bit, ( 1U << LITLEN_COUNT_BITS ) - 1, LITLEN_COUNT_BITS );
+  ASSERT_EQ( codec_token_error, _read_first( header, sizeof( header ), true ) );
+
+  /* a code longer than the limit */
+  memset( header, 0, sizeof( header ) );
+  bit = 0;
+  _put_bits( header, &bit, 1, 1 );
+  _put_bits( header, &bit, 257, LITLEN_COUNT_BITS );
+  _put_bits( header, &bit, HUFFMAN_CODEC_MAX_CODE_BITS + 1, CODE_LEN_BITS );
+  ASSERT_EQ( codec_token_error, _read_first( header, sizeof( header ), true ) );
+
+  /* zero lengths past the last symbol (8 runs of 32, and then 2 more for the last one) */
+  memset( header, 0, sizeof( header ) );
+  bit = 0;
+  _put_bits( header, &bit, 1, 1 );
+  _put_bits( header, &bit, 257, LITLEN_COUNT_BITS );
+  for( size_t i = 0; i < 8; i++ )
+    _put_bits( header, &bit, ( 1U << ZERO_RUN_BITS ) - 1, CODE_LEN_BITS + ZERO_RUN_BITS );
+  _put_bits( header, &bit, 1, CODE_LEN_BITS + ZERO_RUN_BITS );
+  ASSERT_EQ( codec_token_error, _read_first( header, sizeof( header ), true ) );
+
+  /* too many offset symbols */
+  memset( header, 0, sizeof( header ) );
+  bit = 0;
+  _put_bits( header, &bit, 1, 1 );
+  _put_bits( header, &bit, 257, LITLEN_COUNT_BITS );
+  for( size_t i = 0; i < 8; i++ )
+    _put_bits( header, &bit, ( 1U << ZERO_RUN_BITS ) - 1, CODE_LEN_BITS + ZERO_RUN_BITS );
+  _put_bits( header, &bit, 1, CODE_LEN_BITS );
+  _put_bits( header, &bit, ( 1U << OFFSET_COUNT_BITS ) - 1, OFFSET_COUNT_BITS );
+  ASSERT_EQ( codec_token_error, _read_first( header, sizeof( header ), true ) );
+
+  /* more codes than fit in their lengths (every symbol a bit long) */
+  memset( header, 0, sizeof( header ) );
+  bit = 0;
+  _put_bits( header, &bit, 1, 1 );
+  _put_bits( header, &bit, 257, LITLEN_COUNT_BITS );
+  for( size_t i = 0; i < 257; i++ )
+    _put_bits( header, &bit, 1, CODE_LEN_BITS );
+  _put_bits( header, &bit, 0, OFFSET_COUNT_BITS );
+  ASSERT_TRUE( bit < 8 * sizeof( header ) );
+  ASSERT_EQ( codec_token_error, _read_first( header, sizeof( header ), true ) );
+
+  /* and a valid header with the end of block as the only symbol is the end of the stream */
+  memset( header, 0, sizeof( header ) );
+  bit = 0;
+  _put_bits( header, &bit, 1, 1 );
+  _put_bits( header, &bit, 257, LITLEN_COUNT_BITS );
+  for( size_t i = 0; i < 8; i++ )
+    _put_bits( header, &bit, ( 1U << ZERO_RUN_BITS ) - 1, CODE_LEN_BITS + ZERO_RUN_BITS );
+  _put_bits( header, &bit, 1, CODE_LEN_BITS );
+  _put_bits( header, &bit, 0, OFFSET_COUNT_BITS );
+  _put_bits( header, &bit, 0, 1 );
+  ASSERT_EQ( codec_token_end, _read_first( header, ( bit + 7 ) / 8, true ) );
+}
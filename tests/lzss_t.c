@@ -1,6 +1,12 @@
 #include <string.h>
+#include "codecs/ans.h"
 #include "codecs/ascii.h"
+#include "codecs/binary.h"
+#include "codecs/fast.h"
+#include "codecs/huffman.h"
+#include "codecs/range.h"
 #include "lzss.h"
+#include "math2.h"
 #include "scunit.h"
 
 
@@ -36,7 +42,7 @@ struct buffer
  * @param  ctx  Output string.
  * @return      \c true on success, \c false otherwise.
  */
-static bool _ascii_codec_out_cb( const void *data, size_t size, void *ctx )
+static bool _codec_out_cb( const void *data, size_t size, void *ctx )
 {
   struct buffer *b = ctx;
 
@@ -51,28 +57,74 @@ static bool _ascii_codec_out_cb( const void *data, size_t size, void *ctx )
 
 /**
  * Feeds \a input into an LZSS with an ASCII codec and asserts the output is exactly the same as
- * \a expected.
+ * \a expected. The window size and the match lengths are taken from the macros \c WINDOW_SIZE,
+ * \c MIN_MATCH and \c MAX_MATCH.
  * @param  expected Expected output.
  * @param  input    String to compress.
  */
-#define TEST_W_ASCII( expected, input, min_match_len, max_match_len, window_size ) \
+#define TEST_W_ASCII( expected, input ) \
+  TEST_W_ASCII_FINDER( expected, input, lzss_finder_window )
+
+
+/**
+ * Same as \c TEST_W_ASCII but compressing with the match finder \a finder.
+ * @param  expected Expected output.
+ * @param  input    String to compress.
+ * @param  finder   Match finder.
+ */
+#define TEST_W_ASCII_FINDER( expected, input, finder )                             \
+  TEST_W_ASCII_PARSER( expected, input, finder, lzss_parser_greedy, 0 )
+
+
+/**
+ * Same as \c TEST_W_ASCII_FINDER but choosing the tokens with \a parser.
+ * @param  expected   Expected output.
+ * @param  input      String to compress.
+ * @param  f          Match finder.
+ * @param  p          Parser.
+ * @param  depth      Positions looked ahead by the lazy parser.
+ */
+#define TEST_W_ASCII_PARSER( expected, input, f, p, depth )                        \
+  TEST_W_ASCII_BLOCK( expected, input, f, p, depth, LZSS_DEFAULT_BLOCK_SIZE )
+
+
+/**
+ * Same as \c TEST_W_ASCII_PARSER but with blocks of \a block bytes for the optimal parser.
+ * @param  expected   Expected output.
+ * @param  input      String to compress.
+ * @param  f          Match finder.
+ * @param  p          Parser.
+ * @param  depth      Positions looked ahead by the lazy parser.
+ * @param  block      Bytes parsed at once by the optimal parser.
+ */
+#define TEST_W_ASCII_BLOCK( expected, input, f, p, depth, block )                  \
   do {                                                                             \
     /* encoded data */                                                             \
     struct buffer obtained;                                                        \
     memset( &obtained, 0, sizeof( obtained ) );                                    \
                                                                                    \
     /* creates the output encoder */                                               \
-    codec_t *codec = ascii_codec_create( _ascii_codec_out_cb,                      \
+    codec_t *codec = ascii_codec_create( _codec_out_cb,                            \
                                          &obtained,                                \
-                                         min_match_len,                            \
-                                         max_match_len,                            \
-                                         window_size );                            \
+                                         MIN_MATCH,                                \
+                                         MAX_MATCH,                                \
+                                         WINDOW_SIZE );                            \
                                                                                    \
     lzss_t lz;                                                                     \
+    lzss_params_t params = {                                                       \
+      .window_size = WINDOW_SIZE,                                                  \
+      .min_match_len = MIN_MATCH,                                                  \
+      .max_match_len = MAX_MATCH,                                                  \
+      .finder = f,                                                                 \
+      .search_depth = LZSS_DEFAULT_SEARCH_DEPTH,                                   \
+      .parser = p,                                                                 \
+      .lazy_depth = depth,                                                         \
+      .block_size = block                                                          \
+    };                                                                             \
                                                                                    \
     /* compresses the data */                                                      \
-    ASSERT_NO_ERROR( lzss_init( &lz, WINDOW_SIZE, MIN_MATCH, MAX_MATCH, codec ) ); \
-    ASSERT_NO_ERROR( lzss_compress( &lz, data, strlen( data ) ) );                 \
+    ASSERT_NO_ERROR( lzss_init_params( &lz, &params, codec ) );                    \
+    ASSERT_NO_ERROR( lzss_compress( &lz, ( input ), strlen( input ) ) );           \
     ASSERT_NO_ERROR( lzss_end( &lz ) );                                            \
                                                                                    \
     ASSERT_COMPRESSED( expected, obtained );                                       \
@@ -96,7 +148,7 @@ TEST( BasicCompression )
     /* expects a literal 'a' followed by a match from pos 0 of len 9 */
     const char expected[] = "0a 1(0,9)\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -114,7 +166,7 @@ TEST( BasicCompression )
      * match (at that time, the 'a' will be at pos 0) */
     const char expected[] = "0b 1(0,4) 0a 1(0,9)\n";
 
-   TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -136,7 +188,7 @@ TEST( MinMatchLength )
     /* expects 10 literal 'a' because the min match length is not reached */
     const char expected[] = "0a 0a 0a 0a 0a 0a 0a 0a 0a 0a\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
   }
 
   /* min length reached exactly */
@@ -147,7 +199,7 @@ TEST( MinMatchLength )
     /* expects 9 literal 'a' because the min match length was not reached */
     const char expected[] = "0a 1(0,10)\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -164,7 +216,7 @@ TEST( MinMatchLength )
     /* expects 9 literal 'a' because the min match length was not reached */
     const char expected[] = "0a 0a 0a 0a 0a 0a 0a 0a 0b 0b 0b 0b 0b 0b 0b 0b 1(15,8) 0a 0a 0a\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -183,7 +235,7 @@ TEST( MaxMatchLength )
     const char data[] = "aaaaaaaaaaaaaaaaaa";
     const char expected[] = "0a 1(0,15) 0a 0a\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -198,7 +250,7 @@ TEST( MaxMatchLength )
     const char data[] = "123456789123456789123456789";
     const char expected[] = "01 02 03 04 05 06 07 08 09 1(8,15) 1(8,3)\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -217,7 +269,7 @@ TEST( ComplexStrings )
     const char data[] = "abcabcabcabcabcabc";
     const char expected[] = "0a 0b 0c 1(2,15)\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -232,7 +284,7 @@ TEST( ComplexStrings )
     const char data[] = "abbbbcabcabcabcabcabd";
     const char expected[] = "0a 0b 0b 0b 0b 0c 0a 0b 1(2,12) 0d\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -247,7 +299,7 @@ TEST( ComplexStrings )
     const char data[] = "abcd 1 2 3 4 5 6 abcdaa";
     const char expected[] = "0a 0b 0c 0d 0  01 0  02 0  03 0  04 0  05 0  06 0  1(16,4) 0a 0a\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -262,7 +314,7 @@ TEST( ComplexStrings )
     const char data[] = "ABCDADADAABDAA";
     const char expected[] = "0A 0B 0C 0D 0A 1(1,4) 0A 0B 1(3,3)\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -277,7 +329,7 @@ TEST( ComplexStrings )
     const char data[] = "ABCDADADAABCAA";
     const char expected[] = "0A 0B 0C 0D 0A 1(1,4) 0A 0B 0C 1(3,2)\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -296,7 +348,7 @@ TEST( ShortWindow )
     const char data[] = "aaaaaaaaaaaaaaaaaaaa";
     const char expected[] = "0a 1(0,19)\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
@@ -315,13 +367,265 @@ TEST( ShortWindow )
                             " 0  0w 0h 0o 0  0u 0n 0d 0e 0r 0s 0t 0a 0n 0d 0  0b 0i 0n 0a 0r 0y 0, 0 "
                             " 1(11,4) 1(32,10) 0d 0o 0n 0' 0t 0.\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII( expected, data );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+
+  {
+    #define WINDOW_SIZE 32
+    #define MIN_MATCH 4
+    #define MAX_MATCH 1024
+
+    /* on equal lengths, the closest candidate is used */
+    const char data[] = "six sick hicks nick six slick bricks with picks and sticks.";
+    const char expected[] = "0s 0i 0x 0  0s 0i 0c 0k 0  0h 0i 0c 0k 0s 0  0n 1(10,4) 1(19,5) 0l "
+                            "1(9,4) 0b 0r 1(21,5) 0w 0i 0t 0h 0  0p 1(10,5) 0a 0n 0d 0  0s 0t "
+                            "1(10,4) 0.\n";
+
+    TEST_W_ASCII( expected, data );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+}
+
+
+TEST( CandidateLimit )
+{
+  const char data[] = "abcdXabcYabcdZabcd";
+  const size_t limits[] = { 0, 1, 2 };
+  const char *expected[] = {
+    "0a 0b 0c 0d 0X 1(4,3) 0Y 1(8,4) 0Z 1(4,4)\n",
+
+    /* only the closest candidate is tracked */
+    "0a 0b 0c 0d 0X 1(4,3) 0Y 1(3,3) 0d 0Z 1(4,4)\n",
+
+    "0a 0b 0c 0d 0X 1(4,3) 0Y 1(8,4) 0Z 1(4,4)\n"
+  };
+
+  for( size_t i = 0; i < sizeof( limits ) / sizeof( limits[0] ); i++ )
+  {
+    struct buffer obtained;
+    memset( &obtained, 0, sizeof( obtained ) );
+
+    codec_t *codec = ascii_codec_create( _codec_out_cb, &obtained, 3, 100, 32 );
+
+    lzss_t lz;
+    lzss_params_t params = {
+      .window_size = 32,
+      .min_match_len = 3,
+      .max_match_len = 100,
+      .finder = lzss_finder_window,
+      .parser = lzss_parser_greedy,
+      .max_candidates = limits[i]
+    };
+
+    ASSERT_NO_ERROR( lzss_init_params( &lz, &params, codec ) );
+    ASSERT_NO_ERROR( lzss_compress( &lz, data, strlen( data ) ) );
+    ASSERT_NO_ERROR( lzss_end( &lz ) );
+
+    ASSERT_EQ( strlen( expected[i] ) + 1, obtained.data_len );
+    ASSERT_EQ( 0, memcmp( expected[i], obtained.data, obtained.data_len ) );
+
+    codec->destroy( codec );
+    lzss_uninit( &lz );
+  }
+
+  /* the candidates are stored in 16 bits */
+  {
+    lzss_t lz;
+    lzss_params_t params = {
+      .window_size = 32,
+      .min_match_len = 3,
+      .max_match_len = UINT16_MAX + 1,
+      .finder = lzss_finder_window,
+      .parser = lzss_parser_greedy
+    };
+
+    ASSERT_EQ( lzss_error_invalid_params, lzss_init_params( &lz, &params, NULL ) );
+  }
+}
+
+
+/**
+ * Compresses \a input with an ASCII codec, feeding a first block of \a first bytes and the rest
+ * in blocks of \a block bytes, and checks the output is \a expected.
+ * @param  params   Compression parameters.
+ * @param  input    String to compress.
+ * @param  first    Size of the first block.
+ * @param  block    Size of the other blocks.
+ * @param  expected Expected output.
+ * @return          \c true if the output is the expected one, \c false otherwise.
+ */
+static bool _compress_in_blocks( const lzss_params_t *params,
+                                 const char *input,
+                                 size_t first,
+                                 size_t block,
+                                 const char *expected )
+{
+  struct buffer obtained;
+  memset( &obtained, 0, sizeof( obtained ) );
+
+  codec_t *codec = ascii_codec_create( _codec_out_cb,
+                                       &obtained,
+                                       params->min_match_len,
+                                       params->max_match_len,
+                                       params->window_size );
+  if( codec == NULL )
+    return false;
+
+  lzss_t lz;
+  bool success = ( lzss_init_params( &lz, params, codec ) == lzss_error_no_error );
+  if( success )
+  {
+    size_t len = strlen( input );
+    for( size_t i = 0, size = first; i < len && success; i += size, size = block )
+    {
+      size = MIN( size, len - i );
+      success = ( lzss_compress( &lz, input + i, size ) == lzss_error_no_error );
+    }
+
+    success = success && lzss_end( &lz ) == lzss_error_no_error;
+    lzss_uninit( &lz );
+  }
+
+  codec->destroy( codec );
+
+  return success && obtained.data_len == strlen( expected ) + 1 &&
+         memcmp( obtained.data, expected, obtained.data_len ) == 0;
+}
+
+
+TEST( WindowRuns )
+{
+  #define WINDOW_SIZE 32
+  #define MIN_MATCH 3
+  #define MAX_MATCH 100
+
+  char data[256];
+
+  /* the run after the first 'z' is matched at once, in matches of up to the maximum length */
+  memset( data, 'z', 152 );
+  memcpy( data, "abc", 3 );
+  memcpy( data + 152, "abcz", 5 );
+  TEST_W_ASCII( "0a 0b 0c 0z 1(0,100) 1(0,48) 0a 0b 0c 0z\n", data );
+
+  /* the match being tracked when the run starts is written first */
+  memset( data, 'z', 76 );
+  memcpy( data, "xyzxyz", 6 );
+  data[76] = '\0';
+  TEST_W_ASCII( "0x 0y 0z 1(2,3) 1(0,70)\n", data );
+
+  /* a tail shorter than a match is left to the window finder, and so are the short runs */
+  memset( data, 'z', 103 );
+  memcpy( data + 103, "abbbbbb", 8 );
+  data[0] = 'a';
+  TEST_W_ASCII( "0a 0z 1(0,100) 0z 0a 0b 1(0,5)\n", data );
+
+  /* a run reaching the end of a block goes on with the next ones, however short, as long as the
+   * first one has enough of it to be found (and so does a tail left to the window finder) */
+  lzss_params_t params = {
+    .window_size = WINDOW_SIZE,
+    .min_match_len = MIN_MATCH,
+    .max_match_len = MAX_MATCH,
+    .finder = lzss_finder_window,
+    .search_depth = LZSS_DEFAULT_SEARCH_DEPTH,
+    .parser = lzss_parser_greedy
+  };
+
+  memset( data, 'z', 152 );
+  memcpy( data, "abc", 3 );
+  memcpy( data + 152, "abcz", 5 );
+  for( size_t block = 1; block <= 100; block += 11 )
+  {
+    ASSERT_TRUE( _compress_in_blocks( &params,
+                                      data,
+                                      70,
+                                      block,
+                                      "0a 0b 0c 0z 1(0,100) 1(0,48) 0a 0b 0c 0z\n" ) );
+  }
+
+  memset( data, 'z', 103 );
+  data[0] = 'a';
+  data[103] = '\0';
+  for( size_t block = 1; block <= 40; block += 3 )
+    ASSERT_TRUE( _compress_in_blocks( &params, data, 80, block, "0a 0z 1(0,100) 0z\n" ) );
+
+  #undef WINDOW_SIZE
+  #undef MIN_MATCH
+  #undef MAX_MATCH
+}
+
+
+TEST( HashChainFinder )
+{
+  {
+    #define WINDOW_SIZE 10
+    #define MIN_MATCH 4
+    #define MAX_MATCH 1024
+
+    const char data[] = "bbbbbaaaaaaaaaa";
+    const char expected[] = "0b 1(0,4) 0a 1(0,9)\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_hash_chain );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+
+  {
+    #define WINDOW_SIZE 256
+    #define MIN_MATCH 3
+    #define MAX_MATCH 15
+
+    const char data[] = "123456789123456789123456789";
+    const char expected[] = "01 02 03 04 05 06 07 08 09 1(8,15) 1(8,3)\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_hash_chain );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+
+  /* unlike the window finder, the match can start in the middle of a repetition */
+  {
+    #define WINDOW_SIZE 1024
+    #define MIN_MATCH 8
+    #define MAX_MATCH 1024
+
+    const char data[] = "abbbbcabcabcabcabcabd";
+    const char expected[] = "0a 0b 0b 0b 0b 0c 0a 1(2,13) 0d\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_hash_chain );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+
+  /* matches can't go further than the window size */
+  {
+    #define WINDOW_SIZE 4
+    #define MIN_MATCH 2
+    #define MAX_MATCH 1024
+
+    const char data[] = "ABCDADADAABDAA";
+    const char expected[] = "0A 0B 0C 0D 0A 1(1,4) 0A 0B 1(3,3)\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_hash_chain );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
     #undef MAX_MATCH
   }
 
+  /* on equal lengths, the closest match is used */
   {
     #define WINDOW_SIZE 32
     #define MIN_MATCH 4
@@ -329,13 +633,639 @@ TEST( ShortWindow )
 
     const char data[] = "six sick hicks nick six slick bricks with picks and sticks.";
     const char expected[] = "0s 0i 0x 0  0s 0i 0c 0k 0  0h 0i 0c 0k 0s 0  0n 1(10,4) 1(19,5) 0l "
-                            "1(20,4) 0b 0r 1(21,5) 0w 0i 0t 0h 0  0p 1(10,5) 0a 0n 0d 0  0s 0t "
+                            "1(9,4) 0b 0r 1(21,5) 0w 0i 0t 0h 0  0p 1(10,5) 0a 0n 0d 0  0s 0t "
                             "1(10,4) 0.\n";
 
-    TEST_W_ASCII( expected, data, WINDOW_SIZE, MIN_MATCH, MAX_MATCH );
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_hash_chain );
 
     #undef WINDOW_SIZE
     #undef MIN_MATCH
     #undef MAX_MATCH
   }
 }
+
+
+TEST( BinaryTreeFinder )
+{
+  {
+    #define WINDOW_SIZE 10
+    #define MIN_MATCH 4
+    #define MAX_MATCH 1024
+
+    const char data[] = "bbbbbaaaaaaaaaa";
+    const char expected[] = "0b 1(0,4) 0a 1(0,9)\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_binary_tree );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+
+  /* the longest match wins even if it's further away */
+  {
+    #define WINDOW_SIZE 1024
+    #define MIN_MATCH 3
+    #define MAX_MATCH 1024
+
+    const char data[] = "abcdefg_abcxyz-abcdefg";
+    const char expected[] = "0a 0b 0c 0d 0e 0f 0g 0_ 1(7,3) 0x 0y 0z 0- 1(14,7)\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_binary_tree );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+
+  /* on equal lengths, the closest match is used */
+  {
+    #define WINDOW_SIZE 32
+    #define MIN_MATCH 4
+    #define MAX_MATCH 1024
+
+    const char data[] = "six sick hicks nick six slick bricks with picks and sticks.";
+    const char expected[] = "0s 0i 0x 0  0s 0i 0c 0k 0  0h 0i 0c 0k 0s 0  0n 1(10,4) 1(19,5) 0l "
+                            "1(9,4) 0b 0r 1(21,5) 0w 0i 0t 0h 0  0p 1(10,5) 0a 0n 0d 0  0s 0t "
+                            "1(10,4) 0.\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_binary_tree );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+}
+
+
+TEST( ScanFinder )
+{
+  /* the longest match wins even if it's further away */
+  {
+    #define WINDOW_SIZE 1024
+    #define MIN_MATCH 3
+    #define MAX_MATCH 1024
+
+    const char data[] = "abcdefg_abcxyz-abcdefg";
+    const char expected[] = "0a 0b 0c 0d 0e 0f 0g 0_ 1(7,3) 0x 0y 0z 0- 1(14,7)\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_scan );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+
+  /* on equal lengths, the closest match is used */
+  {
+    #define WINDOW_SIZE 32
+    #define MIN_MATCH 4
+    #define MAX_MATCH 1024
+
+    const char data[] = "six sick hicks nick six slick bricks with picks and sticks.";
+    const char expected[] = "0s 0i 0x 0  0s 0i 0c 0k 0  0h 0i 0c 0k 0s 0  0n 1(10,4) 1(19,5) 0l "
+                            "1(9,4) 0b 0r 1(21,5) 0w 0i 0t 0h 0  0p 1(10,5) 0a 0n 0d 0  0s 0t "
+                            "1(10,4) 0.\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_scan );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+
+  /* the window is longer than the SIMD blocks, and wraps around the end of its buffer */
+  {
+    #define WINDOW_SIZE 100
+    #define MIN_MATCH 4
+    #define MAX_MATCH 16
+
+    const char data[] = "she sells sea shells on the sea shore, the shells she sells are sea "
+                        "shells for sure. so if she sells sea shells on the sea shore, i am sure "
+                        "she sells sea shore shells.";
+    const char expected[] = "0s 0h 0e 0  0s 0e 0l 0l 0s 0  0s 0e 0a 0  0s 0h 1(10,5) 0o 0n 0  "
+                            "0t 1(23,5) 1(17,4) 0o 0r 0e 0, 1(14,6) 1(28,6) 1(49,10) 0a 0r "
+                            "1(35,8) 1(14,5) 0f 0o 0r 0  0s 0u 0r 0e 0. 0  0s 0o 0  0i 0f "
+                            "1(40,11) 1(90,16) 1(90,13) 0i 0  0a 0m 1(55,5) 1(48,16) 1(30,4) "
+                            "1(54,7) 0.\n";
+
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_scan );
+    TEST_W_ASCII_FINDER( expected, data, lzss_finder_binary_tree );
+
+    #undef WINDOW_SIZE
+    #undef MIN_MATCH
+    #undef MAX_MATCH
+  }
+}
+
+
+TEST( LazyParser )
+{
+  #define WINDOW_SIZE 1024
+  #define MIN_MATCH 3
+  #define MAX_MATCH 1024
+
+  /* a longer match starts right after the current one */
+  {
+    const char data[] = "abcXbcdefYabcdefZ";
+
+    TEST_W_ASCII_PARSER( "0a 0b 0c 0X 0b 0c 0d 0e 0f 0Y 1(9,3) 1(6,3) 0Z\n",
+                         data,
+                         lzss_finder_hash_chain,
+                         lzss_parser_greedy,
+                         0 );
+
+    TEST_W_ASCII_PARSER( "0a 0b 0c 0X 0b 0c 0d 0e 0f 0Y 0a 1(6,5) 0Z\n",
+                         data,
+                         lzss_finder_hash_chain,
+                         lzss_parser_lazy,
+                         1 );
+  }
+
+  /* the longer match starts two positions after the current one */
+  {
+    const char data[] = "abcXcdefgYabcdefgZ";
+
+    TEST_W_ASCII_PARSER( "0a 0b 0c 0X 0c 0d 0e 0f 0g 0Y 1(9,3) 1(7,4) 0Z\n",
+                         data,
+                         lzss_finder_binary_tree,
+                         lzss_parser_lazy,
+                         1 );
+
+    TEST_W_ASCII_PARSER( "0a 0b 0c 0X 0c 0d 0e 0f 0g 0Y 0a 0b 1(7,5) 0Z\n",
+                         data,
+                         lzss_finder_binary_tree,
+                         lzss_parser_lazy,
+                         2 );
+  }
+
+  #undef WINDOW_SIZE
+  #undef MIN_MATCH
+  #undef MAX_MATCH
+}
+
+
+TEST( OptimalParser )
+{
+  #define WINDOW_SIZE 1024
+  #define MIN_MATCH 3
+  #define MAX_MATCH 1024
+
+  /* two short matches take more space than two literals and a longer match */
+  {
+    const char data[] = "bddabdddabbc";
+
+    TEST_W_ASCII_PARSER( "0b 0d 0d 0a 1(3,3) 1(4,3) 0b 0c\n",
+                         data,
+                         lzss_finder_hash_chain,
+                         lzss_parser_lazy,
+                         2 );
+
+    TEST_W_ASCII_PARSER( "0b 0d 0d 0a 0b 0d 1(4,4) 0b 0c\n",
+                         data,
+                         lzss_finder_hash_chain,
+                         lzss_parser_optimal,
+                         0 );
+
+    TEST_W_ASCII_PARSER( "0b 0d 0d 0a 0b 0d 1(4,4) 0b 0c\n",
+                         data,
+                         lzss_finder_binary_tree,
+                         lzss_parser_optimal,
+                         0 );
+  }
+
+  /* the matches don't cross the end of the block */
+  {
+    const char data[] = "bddabdddabbc";
+
+    TEST_W_ASCII_BLOCK( "0b 0d 0d 0a 1(3,3) 0d 0a 0b 0b 0c\n",
+                        data,
+                        lzss_finder_binary_tree,
+                        lzss_parser_optimal,
+                        0,
+                        8 );
+  }
+
+  #undef WINDOW_SIZE
+  #undef MIN_MATCH
+  #undef MAX_MATCH
+}
+
+
+TEST( CompressionLevels )
+{
+  lzss_params_t params;
+  lzss_t lz;
+
+  ASSERT_EQ( lzss_error_invalid_params, lzss_level_params( LZSS_MIN_LEVEL - 1, &params ) );
+  ASSERT_EQ( lzss_error_invalid_params, lzss_level_params( LZSS_MAX_LEVEL + 1, &params ) );
+  ASSERT_EQ( lzss_error_invalid_params, lzss_init_level( &lz, LZSS_MAX_LEVEL + 1, NULL ) );
+
+  const char data[] = "abcdefgh_abcdefgh_abcdefgh";
+
+  for( int level = LZSS_MIN_LEVEL; level <= LZSS_MAX_LEVEL; level++ )
+  {
+    struct buffer obtained;
+    memset( &obtained, 0, sizeof( obtained ) );
+
+    ASSERT_NO_ERROR( lzss_level_params( level, &params ) );
+
+    codec_t *codec = ascii_codec_create( _codec_out_cb,
+                                         &obtained,
+                                         params.min_match_len,
+                                         params.max_match_len,
+                                         params.window_size );
+    ASSERT_TRUE( codec != NULL );
+
+    ASSERT_NO_ERROR( lzss_init_level( &lz, level, codec ) );
+    ASSERT_NO_ERROR( lzss_compress( &lz, data, strlen( data ) ) );
+    ASSERT_NO_ERROR( lzss_end( &lz ) );
+
+    /* every level finds the repetitions */
+    ASSERT_COMPRESSED( "0a 0b 0c 0d 0e 0f 0g 0h 0_ 1(8,17)\n", obtained );
+
+    codec->destroy( codec );
+    lzss_uninit( &lz );
+  }
+}
+
+
+TEST( Decompress )
+{
+  char data[4096];
+  struct buffer compressed;
+  lzss_t lz;
+
+  /* repetitive data, with matches overlapping their source */
+  for( size_t i = 0; i < sizeof( data ); i++ )
+    data[i] = ( i % 1000 < 500 ) ? "lorem ipsum dolor"[( i * i ) % 17] : 'z';
+
+  /* with the bit-packed, the byte-aligned and the entropy codecs */
+  codec_t *( *create[] )( codec_out_cb_t, void *, size_t, size_t, size_t ) = {
+    binary_codec_create, fast_codec_create, huffman_codec_create, ans_codec_create,
+    range_codec_create
+  };
+
+  for( size_t k = 0; k < sizeof( create ) / sizeof( create[0] ); k++ )
+  {
+    for( lzss_parser_t parser = lzss_parser_greedy; parser <= lzss_parser_optimal; parser++ )
+    {
+      memset( &compressed, 0, sizeof( compressed ) );
+
+      lzss_params_t params = {
+        .window_size = 300,
+        .min_match_len = 3,
+        .max_match_len = 34,
+        .finder = lzss_finder_hash_chain,
+        .search_depth = 16,
+        .parser = parser,
+        .lazy_depth = 1,
+        .block_size = 256
+      };
+
+      codec_t *codec = create[k]( _codec_out_cb, &compressed, 3, 34, 300 );
+      ASSERT_TRUE( codec != NULL );
+      ASSERT_NO_ERROR( lzss_init_params( &lz, &params, codec ) );
+      ASSERT_NO_ERROR( lzss_compress( &lz, data, sizeof( data ) ) );
+      ASSERT_NO_ERROR( lzss_end( &lz ) );
+      lzss_uninit( &lz );
+      codec->destroy( codec );
+
+      ASSERT_TRUE( compressed.data_len < sizeof( data ) / 4 );
+
+      /* decompresses feeding a few bytes at a time into a small output buffer */
+      char decompressed[sizeof( data ) + 7];
+      size_t in_pos = 0, out_len = 0, in_len, consumed, produced;
+
+      codec = create[k]( NULL, NULL, 3, 34, 300 );
+      ASSERT_TRUE( codec != NULL );
+      ASSERT_NO_ERROR( lzss_decompress_init( &lz, 300, 3, 34, codec ) );
+
+      do
+      {
+        in_len = MIN( compressed.data_len - in_pos, 5 );
+
+        ASSERT_NO_ERROR( lzss_decompress( &lz,
+                                          compressed.data + in_pos,
+                                          in_len,
+                                          decompressed + out_len,
+                                          7,
+                                          &consumed,
+                                          &produced ) );
+        in_pos += consumed;
+        out_len += produced;
+      }
+      while( in_len > 0 || produced > 0 );
+
+      ASSERT_NO_ERROR( lzss_decompress_end( &lz ) );
+      ASSERT_EQ( out_len, sizeof( data ) );
+      ASSERT_EQ( memcmp( data, decompressed, sizeof( data ) ), 0 );
+
+      codec->destroy( codec );
+
+      /* a truncated stream can't be completely decoded */
+      codec = create[k]( NULL, NULL, 3, 34, 300 );
+      ASSERT_TRUE( codec != NULL );
+      ASSERT_NO_ERROR( lzss_decompress_init( &lz, 300, 3, 34, codec ) );
+      ASSERT_NO_ERROR( lzss_decompress( &lz,
+                                        compressed.data,
+                                        compressed.data_len / 2,
+                                        decompressed,
+                                        sizeof( decompressed ),
+                                        &consumed,
+                                        &produced ) );
+      ASSERT_EQ( lzss_error_corrupt_data, lzss_decompress_end( &lz ) );
+
+      codec->destroy( codec );
+    }
+
+  }
+
+  /* a match can't refer to data not decoded yet */
+  const byte corrupt[] = { 0x80, 0x00, 0x00, 0x80 };
+  char out[16];
+  size_t consumed, produced;
+
+  codec_t *codec = binary_codec_create( NULL, NULL, 3, 34, 300 );
+  ASSERT_TRUE( codec != NULL );
+  ASSERT_NO_ERROR( lzss_decompress_init( &lz, 300, 3, 34, codec ) );
+  ASSERT_EQ( lzss_error_corrupt_data,
+             lzss_decompress( &lz, corrupt, sizeof( corrupt ), out, sizeof( out ), &consumed, &produced ) );
+  ASSERT_EQ( lzss_error_corrupt_data, lzss_decompress_end( &lz ) );
+  codec->destroy( codec );
+}
+
+
+TEST( DecompressCopies )
+{
+  #define MAX_LEN 40
+  #define CANARY 0xA5
+
+  /* the distances the copies special-case: the patterns of 1, 2 and 4 bytes fill whole words,
+   * and from 8 and 16 the chunks don't overlap */
+  const size_t distances[] = { 1, 2, 3, 4, 7, 8, 15, 16, 17 };
+  const char source[] = "0123456789abcdefghij";
+
+  for( size_t d = 0; d < sizeof( distances ) / sizeof( distances[0] ); d++ )
+  {
+    size_t dist = distances[d];
+
+    for( size_t len = 3; len <= MAX_LEN; len++ )
+    {
+      /* the literals of the source, and a match repeating them */
+      struct buffer compressed;
+      memset( &compressed, 0, sizeof( compressed ) );
+
+      codec_t *codec = binary_codec_create( _codec_out_cb, &compressed, 3, MAX_LEN, 32 );
+      ASSERT_TRUE( codec != NULL );
+      for( size_t i = 0; i < dist; i++ )
+        ASSERT_TRUE( codec->write_literal( codec, source[i] ) );
+      ASSERT_TRUE( codec->write_match( codec, ( match_t ){ .pos = dist - 1, .len = len } ) );
+      ASSERT_TRUE( codec->close( codec ) );
+      codec->destroy( codec );
+
+      byte expected[sizeof( source ) + MAX_LEN];
+      for( size_t i = 0; i < dist + len; i++ )
+        expected[i] = source[i % dist];
+
+      /* the match ends right at the end of the output, within the room the wild copies need, and
+       * past it; with the source in the same output or in the window of a previous call */
+      const size_t rooms[] = { 0, 1, LZSS_WILD_COPY - 1, LZSS_WILD_COPY, 2 * LZSS_WILD_COPY };
+      for( size_t r = 0; r < sizeof( rooms ) / sizeof( rooms[0] ); r++ )
+      {
+        size_t room = rooms[r];
+
+        for( size_t split = 0; split <= 1; split++ )
+        {
+          byte out[sizeof( expected ) + 3 * LZSS_WILD_COPY];
+          memset( out, CANARY, sizeof( out ) );
+
+          lzss_t lz;
+          codec = binary_codec_create( NULL, NULL, 3, MAX_LEN, 32 );
+          ASSERT_TRUE( codec != NULL );
+          ASSERT_NO_ERROR( lzss_decompress_init( &lz, 32, 3, MAX_LEN, codec ) );
+
+          size_t in_pos = 0, out_len = 0, consumed, produced;
+          if( split )
+          {
+            /* only the literals fit */
+            ASSERT_NO_ERROR( lzss_decompress( &lz,
+                                              compressed.data,
+                                              compressed.data_len,
+                                              out,
+                                              dist,
+                                              &consumed,
+                                              &produced ) );
+            ASSERT_EQ( dist, produced );
+            in_pos += consumed;
+            out_len += produced;
+          }
+
+          /* the output ends \a room bytes after the match (a byte more is given once it's full,
+           * so the end of the stream can be read) */
+          byte *end = out + dist + len + room;
+          size_t in_len;
+          do
+          {
+            in_len = compressed.data_len - in_pos;
+            ASSERT_NO_ERROR( lzss_decompress( &lz,
+                                              compressed.data + in_pos,
+                                              in_len,
+                                              out + out_len,
+                                              MAX( end - ( out + out_len ), 1 ),
+                                              &consumed,
+                                              &produced ) );
+            in_pos += consumed;
+            out_len += produced;
+          }
+          while( in_len > 0 || produced > 0 );
+
+          ASSERT_EQ( dist + len, out_len );
+          ASSERT_EQ( 0, memcmp( expected, out, out_len ) );
+
+          /* nothing is written past the output buffer, and nothing past the output either unless
+           * the buffer has room for the wild copies */
+          size_t clean = ( room < LZSS_WILD_COPY ) ? out_len : out_len + room;
+          for( size_t i = clean; i < sizeof( out ); i++ )
+            ASSERT_EQ( CANARY, out[i] );
+
+          ASSERT_NO_ERROR( lzss_decompress_end( &lz ) );
+          codec->destroy( codec );
+        }
+      }
+    }
+  }
+
+  #undef MAX_LEN
+  #undef CANARY
+}
+
+
+TEST( CompressBound )
+{
+  static byte data[3000];
+  static byte compressed[4000];
+  static byte decompressed[sizeof( data ) + LZSS_WILD_COPY];
+
+  /* noise (with a few repetitions) so most bytes are encoded as literals */
+  uint32_t seed = 1;
+  for( size_t i = 0; i < sizeof( data ); i++ )
+  {
+    seed = seed * 1103515245 + 12345;
+    data[i] = ( i % 500 < 20 ) ? data[i % 20] : seed >> 24;
+  }
+
+  for( int level = LZSS_MIN_LEVEL; level <= LZSS_MAX_LEVEL; level++ )
+  {
+    lzss_params_t params;
+    lzss_t lz;
+    sink_t sink;
+
+    ASSERT_NO_ERROR( lzss_level_params( level, &params ) );
+
+    size_t bound = lzss_compress_bound( sizeof( data ), &params );
+    ASSERT_TRUE( bound > sizeof( data ) && bound <= sizeof( compressed ) );
+
+    /* compresses straight into a buffer of the size of the bound */
+    sink_init_buffer( &sink, compressed, bound );
+    codec_t *codec = binary_codec_create_sink( &sink,
+                                               params.min_match_len,
+                                               params.max_match_len,
+                                               params.window_size );
+    ASSERT_TRUE( codec != NULL );
+
+    ASSERT_NO_ERROR( lzss_init_params( &lz, &params, codec ) );
+    ASSERT_NO_ERROR( lzss_compress( &lz, data, sizeof( data ) ) );
+    ASSERT_NO_ERROR( lzss_end( &lz ) );
+    lzss_uninit( &lz );
+    codec->destroy( codec );
+
+    ASSERT_TRUE( sink.len > 0 && sink.len <= bound );
+
+    /* checks the data written */
+    size_t consumed, produced, total = 0;
+    codec = binary_codec_create( NULL,
+                                 NULL,
+                                 params.min_match_len,
+                                 params.max_match_len,
+                                 params.window_size );
+    ASSERT_TRUE( codec != NULL );
+    ASSERT_NO_ERROR( lzss_decompress_init( &lz,
+                                           params.window_size,
+                                           params.min_match_len,
+                                           params.max_match_len,
+                                           codec ) );
+
+    /* the whole input, then the end of the input */
+    for( size_t in_len = sink.len; ; in_len = 0 )
+    {
+      ASSERT_NO_ERROR( lzss_decompress( &lz,
+                                        compressed,
+                                        in_len,
+                                        decompressed + total,
+                                        sizeof( decompressed ) - total,
+                                        &consumed,
+                                        &produced ) );
+      total += produced;
+
+      if( in_len == 0 )
+        break;
+    }
+    ASSERT_NO_ERROR( lzss_decompress_end( &lz ) );
+    codec->destroy( codec );
+
+    ASSERT_EQ( total, sizeof( data ) );
+    ASSERT_EQ( memcmp( data, decompressed, sizeof( data ) ), 0 );
+
+    /* fails once the buffer is full */
+    sink_init_buffer( &sink, compressed, sizeof( data ) / 2 );
+    codec = binary_codec_create_sink( &sink,
+                                      params.min_match_len,
+                                      params.max_match_len,
+                                      params.window_size );
+    ASSERT_TRUE( codec != NULL );
+    ASSERT_NO_ERROR( lzss_init_params( &lz, &params, codec ) );
+
+    lzss_error_t error = lzss_compress( &lz, data, sizeof( data ) );
+    if( error == lzss_error_no_error )
+      error = lzss_end( &lz );
+
+    ASSERT_EQ( lzss_error_io_error, error );
+    ASSERT_TRUE( sink.len <= sizeof( data ) / 2 );
+    lzss_uninit( &lz );
+    codec->destroy( codec );
+  }
+}
+
+
+TEST( LongRuns )
+{
+  static char data[1 << 18];
+  static char decompressed[sizeof( data ) + LZSS_WILD_COPY];
+
+  /* a short header padded with zeros */
+  memset( data, 0, sizeof( data ) );
+  memcpy( data, "header: 0123456789", 18 );
+
+  for( int level = LZSS_MIN_LEVEL; level <= LZSS_MAX_LEVEL; level++ )
+  {
+    struct buffer compressed;
+    lzss_params_t params;
+    lzss_t lz;
+
+    memset( &compressed, 0, sizeof( compressed ) );
+    ASSERT_NO_ERROR( lzss_level_params( level, &params ) );
+
+    codec_t *codec = binary_codec_create( _codec_out_cb,
+                                          &compressed,
+                                          params.min_match_len,
+                                          params.max_match_len,
+                                          params.window_size );
+    ASSERT_TRUE( codec != NULL );
+    ASSERT_NO_ERROR( lzss_init_params( &lz, &params, codec ) );
+    ASSERT_NO_ERROR( lzss_compress( &lz, data, sizeof( data ) ) );
+    ASSERT_NO_ERROR( lzss_end( &lz ) );
+    lzss_uninit( &lz );
+    codec->destroy( codec );
+
+    /* the header, and a few tokens for the whole run */
+    ASSERT_TRUE( compressed.data_len < 48 );
+
+    size_t consumed, produced, total = 0;
+    codec = binary_codec_create( NULL,
+                                 NULL,
+                                 params.min_match_len,
+                                 params.max_match_len,
+                                 params.window_size );
+    ASSERT_TRUE( codec != NULL );
+    ASSERT_NO_ERROR( lzss_decompress_init( &lz,
+                                           params.window_size,
+                                           params.min_match_len,
+                                           params.max_match_len,
+                                           codec ) );
+
+    /* the output is taken in small chunks, so the long matches are copied over several calls */
+    size_t in_pos = 0, in_len;
+    do
+    {
+      in_len = compressed.data_len - in_pos;
+
+      ASSERT_NO_ERROR( lzss_decompress( &lz,
+                                        compressed.data + in_pos,
+                                        in_len,
+                                        decompressed + total,
+                                        MIN( sizeof( decompressed ) - total, 4096 ),
+                                        &consumed,
+                                        &produced ) );
+      in_pos += consumed;
+      total += produced;
+    }
+    while( in_len > 0 || produced > 0 );
+
+    ASSERT_NO_ERROR( lzss_decompress_end( &lz ) );
+    codec->destroy( codec );
+
+    ASSERT_EQ( total, sizeof( data ) );
+    ASSERT_EQ( memcmp( data, decompressed, sizeof( data ) ), 0 );
+  }
+}
@@ -0,0 +1,155 @@
+#include "scunit.h"
+#include "codecs/range.h"
+#include "codec_round_trip.h"
+
+
+/** Stream of a single token repeated. */
+struct run
+{
+  /** The literal, or -1 for the match. */
+  int literal;
+
+  /** The match (if \c literal is -1). */
+  match_t match;
+};
+
+
+/**
+ * Returns the i-th token of a run of a single token.
+ * @param  i   Token index.
+ * @param  m   Match (if the token is a match).
+ * @param  ctx The run.
+ * @return     The literal, or -1 if the token is a match.
+ */
+static int _run_token( size_t i, match_t *m, const void *ctx )
+{
+  const struct run *r = ctx;
+
+  ( void )i;
+  *m = r->match;
+
+  return r->literal;
+}
+
+
+/**
+ * Returns the i-th token of a random stream: random literals, and random matches one time in
+ * five.
+ * @param  i   Token index.
+ * @param  m   Match (if the token is a match).
+ * @param  ctx Seed of the stream.
+ * @return     The literal, or -1 if the token is a match.
+ */
+static int _random_token( size_t i, match_t *m, const void *ctx )
+{
+  const unsigned int *seed = ctx;
+
+  uint32_t x = ( uint32_t )( i + *seed * 100003U ) * 2654435761U;
+  x ^= x >> 15;
+  x *= 2246822519U;
+  x ^= x >> 13;
+
+  if( x % 5 == 0 )
+  {
+    m->pos = x % ROUND_TRIP_MAX_POS;
+    m->len = ROUND_TRIP_MIN_MATCH + ( x >> 8 ) % 300;
+    return -1;
+  }
+
+  return ( x >> 16 ) & 0xff;
+}
+
+
+TEST( RangeTokens )
+{
+  static struct round_trip_buffer encoded;
+
+  ASSERT_TRUE( round_trip( range_codec_create, round_trip_token, NULL, 50000, &encoded ) );
+}
+
+
+TEST( RangeAdaptation )
+{
+  static struct round_trip_buffer encoded;
+
+  codec_t *rc = range_codec_create( round_trip_out_cb,
+                                    &encoded,
+                                    ROUND_TRIP_MIN_MATCH,
+                                    ROUND_TRIP_MAX_MATCH,
+                                    ROUND_TRIP_MAX_POS );
+  ASSERT_NE( NULL, rc );
+  encoded.size = 0;
+
+  /* everything starts with even odds: the literal/match flag and the 8 bits */
+  ASSERT_EQ( 9, rc->price_literal( rc, 'a' ) );
+  ASSERT_EQ( 9, rc->price_literal( rc, 'b' ) );
+
+  /* the probabilities of a repeated literal grow, and the ones of the literals branching off its
+   * bit tree shrink (the sooner they branch off, the more) */
+  for( size_t i = 0; i < 500; i++ )
+    ASSERT_TRUE( rc->write_literal( rc, 'a' ) );
+
+  ASSERT_TRUE( rc->price_literal( rc, 'a' ) <= 1 );
+  ASSERT_TRUE( rc->price_literal( rc, 'b' ) < rc->price_literal( rc, '!' ) );
+  ASSERT_TRUE( rc->price_literal( rc, '!' ) > 9 );
+
+  /* after a literal with other high bits, the literals are in a context not seen yet (only the
+   * literal/match flag has adapted) */
+  ASSERT_TRUE( rc->write_literal( rc, 0x10 ) );
+  ASSERT_TRUE( rc->price_literal( rc, 'a' ) >= 8 );
+
+  /* the same for a repeated match */
+  match_t m = { .pos = 1000, .len = 20 };
+  size_t first_price = rc->price_match( rc, m, 501 );
+  for( size_t i = 0; i < 100; i++ )
+    ASSERT_TRUE( rc->write_match( rc, m ) );
+  ASSERT_TRUE( rc->price_match( rc, m, 501 + 100 * m.len ) < first_price / 4 );
+
+  ASSERT_TRUE( rc->close( rc ) );
+  rc->destroy( rc );
+
+  /* the statistics change halfway, and the second half adapts as quickly as the first one */
+  struct round_trip_buffer *halves = &encoded;
+  const struct run a = { 'a', { 0, 0 } };
+  const struct run b = { 'b', { 0, 0 } };
+
+  ASSERT_TRUE( round_trip( range_codec_create, _run_token, &a, 1000, halves ) );
+  size_t half_size = halves->size;
+  ASSERT_TRUE( round_trip( range_codec_create, _run_token, &b, 1000, halves ) );
+  ASSERT_TRUE( halves->size <= half_size + 1 );
+}
+
+
+TEST( RangeCarries )
+{
+  static struct round_trip_buffer encoded;
+
+  /* about a third of the bytes output take a carry on random data, and in some of these streams
+   * (seeds 2, 3, 8, 9 and 13) the carry goes through a byte with two 0xff bytes after it */
+  for( unsigned int seed = 0; seed < 16; seed++ )
+    ASSERT_TRUE( round_trip( range_codec_create, _random_token, &seed, 20000, &encoded ) );
+}
+
+
+TEST( RangeBitRuns )
+{
+  static struct round_trip_buffer encoded;
+
+  /* runs of zeros and of ones in every bit of the literals, and of the same match */
+  const struct run runs[] = {
+    { 0x00, { 0, 0 } },
+    { 0xff, { 0, 0 } },
+    { -1, { 0, ROUND_TRIP_MIN_MATCH } },
+    { -1, { ROUND_TRIP_MAX_POS - 1, ROUND_TRIP_MAX_MATCH } },
+  };
+
+  for( size_t k = 0; k < sizeof( runs ) / sizeof( runs[0] ); k++ )
+  {
+    ASSERT_TRUE( round_trip( range_codec_create, _run_token, &runs[k], 50000, &encoded ) );
+
+    /* the probabilities saturate, so each bit takes only a small fraction of a bit (but most of
+     * the extra bits of the far match are coded with even odds) */
+    size_t bits_per_token = ( runs[k].literal < 0 && runs[k].match.pos > 0 ) ? 20 : 1;
+    ASSERT_TRUE( encoded.size * 8 < 50000 * bits_per_token );
+  }
+}
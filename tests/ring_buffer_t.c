@@ -8,7 +8,7 @@ TEST( Empty )
   ring_buffer_t rb;
   size_t rb_size = 10;
 
-  ASSERT_TRUE( ring_buffer_init( &rb, rb_size ) );
+  ASSERT_TRUE( ring_buffer_init( &rb, rb_size, false ) );
 
   /* first available position is zero */
   ASSERT_EQ( 0, ring_buffer_first_pos( &rb ) );
@@ -26,7 +26,7 @@ TEST( AppendBytes )
   ring_buffer_t rb;
   size_t rb_size = 10;
 
-  ASSERT_TRUE( ring_buffer_init( &rb, rb_size ) );
+  ASSERT_TRUE( ring_buffer_init( &rb, rb_size, false ) );
 
   /* sets the ring buffer full */
   for( size_t i = 0; i < rb_size; i++ )
@@ -73,7 +73,7 @@ TEST( ExtraTests )
   const char input[] = "some stupid sexy and funny string.";
   const char *expected = input + ( strlen( input ) - rb_size );
 
-  ASSERT_TRUE( ring_buffer_init( &rb, rb_size ) );
+  ASSERT_TRUE( ring_buffer_init( &rb, rb_size, false ) );
 
   /* fills the buffer */
   for( size_t i = 0; i < strlen( input ); i++ )
@@ -92,3 +92,115 @@ TEST( ExtraTests )
 
   ring_buffer_release( &rb );
 }
+
+
+TEST( UncheckedAccess )
+{
+  ring_buffer_t rb;
+  size_t rb_size = 13;
+
+  const char input[] = "some stupid sexy and funny string.";
+
+  ASSERT_TRUE( ring_buffer_init( &rb, rb_size, false ) );
+
+  for( size_t i = 0; i < strlen( input ); i++ )
+  {
+    ring_buffer_append( &rb, input[i] );
+
+    /* the size is not a power of two, but still only the last bytes are available */
+    uint64_t first = ( i + 1 > rb_size ) ? i + 1 - rb_size : 0;
+    ASSERT_EQ( first, ring_buffer_first_pos( &rb ) );
+
+    for( uint64_t pos = first; pos <= i; pos++ )
+    {
+      byte obtained;
+      ASSERT_TRUE( ring_buffer_get( &rb, &obtained, pos ) );
+      ASSERT_EQ( input[pos], obtained );
+      ASSERT_EQ( input[pos], ring_buffer_at_mod( &rb, pos ) );
+    }
+  }
+
+  byte obtained;
+  ASSERT_FALSE( ring_buffer_get( &rb, &obtained, strlen( input ) - rb_size - 1 ) );
+
+  ring_buffer_release( &rb );
+}
+
+
+TEST( Mirrored )
+{
+  ring_buffer_t rb;
+  size_t rb_size = 5000;
+
+  ASSERT_TRUE( ring_buffer_init_mirrored( &rb, rb_size, false ) );
+
+  /* wraps around the end of the buffer a few times */
+  for( size_t i = 0; i < rb_size * 3 + 7; i++ )
+    ring_buffer_append( &rb, ( byte )i );
+
+  uint64_t first = ring_buffer_first_pos( &rb );
+
+  for( uint64_t pos = first; pos < first + rb_size; pos++ )
+  {
+    byte obtained;
+    ASSERT_TRUE( ring_buffer_get( &rb, &obtained, pos ) );
+    ASSERT_EQ( ( byte )pos, obtained );
+  }
+
+  /* when mirrored, the whole content can be read from the oldest byte with plain pointers */
+  if( rb.mirrored )
+  {
+    const byte *data = rb.buffer + ring_buffer_index( &rb, first );
+    ASSERT_TRUE( ring_buffer_contiguous( &rb, first ) >= rb_size );
+
+    for( size_t i = 0; i < rb_size; i++ )
+      ASSERT_EQ( ( byte )( first + i ), data[i] );
+  }
+
+  ring_buffer_release( &rb );
+}
+
+
+TEST( Capacity )
+{
+  ring_buffer_t exact, pow2;
+  size_t rb_size = 65537;
+
+  /* only the opt-in rounds the buffer up to a power of two */
+  ASSERT_TRUE( ring_buffer_init( &exact, rb_size, false ) );
+  ASSERT_TRUE( ring_buffer_init( &pow2, rb_size, true ) );
+  ASSERT_EQ( rb_size, exact.capacity );
+  ASSERT_EQ( 131072, pow2.capacity );
+  ASSERT_EQ( 0, exact.mask );
+  ASSERT_EQ( 131071, pow2.mask );
+
+  /* blocks of a size prime with both capacities, so they wrap around anywhere, followed by a
+   * single byte */
+  byte block[1021];
+  uint64_t count = 0;
+  for( size_t n = 0; n < 300; n++ )
+  {
+    for( size_t i = 0; i < sizeof( block ); i++ )
+      block[i] = ( byte )( ( count + i ) * 131 >> 3 );
+
+    ring_buffer_append_block( &exact, block, sizeof( block ) );
+    ring_buffer_append_block( &pow2, block, sizeof( block ) );
+    count += sizeof( block );
+
+    ring_buffer_append( &exact, ( byte )( count * 131 >> 3 ) );
+    ring_buffer_append( &pow2, ( byte )( count * 131 >> 3 ) );
+    count++;
+  }
+
+  uint64_t first = ring_buffer_first_pos( &exact );
+  ASSERT_EQ( first, ring_buffer_first_pos( &pow2 ) );
+
+  for( uint64_t pos = first; pos < count; pos++ )
+  {
+    ASSERT_EQ( ( byte )( pos * 131 >> 3 ), ring_buffer_at_mod( &exact, pos ) );
+    ASSERT_EQ( ( byte )( pos * 131 >> 3 ), ring_buffer_at( &pow2, pos ) );
+  }
+
+  ring_buffer_release( &exact );
+  ring_buffer_release( &pow2 );
+}
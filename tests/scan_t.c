@@ -0,0 +1,117 @@
+#include <string.h>
+#include "scan.h"
+#include "scunit.h"
+
+
+/** Names of all the kernels (the ones the CPU can't run are skipped). */
+static const char *_kernel_names[] = { "scalar", "sse2", "avx2", "avx512" };
+
+
+/**
+ * Fills a block with bytes from a small alphabet, so the prefixes are found often.
+ * @param data Block.
+ * @param size Size of \a data.
+ * @param seed Seed of the generator.
+ */
+static void _fill( byte *data, size_t size, unsigned int seed )
+{
+  for( size_t i = 0; i < size; i++ )
+  {
+    seed = seed * 1103515245U + 12345U;
+    data[i] = 'a' + ( seed >> 16 ) % 3;
+  }
+}
+
+
+TEST( ScanKernels )
+{
+  #define BLOCK_SIZE 300
+
+  byte data[BLOCK_SIZE + SCAN_MAX_PREFIX];
+  scan_t reference, s;
+
+  ASSERT_TRUE( scan_init( &reference, BLOCK_SIZE, SCAN_MAX_PREFIX ) );
+  ASSERT_TRUE( scan_set_kernel( &reference, "scalar" ) );
+  ASSERT_FALSE( scan_set_kernel( &reference, "mmx" ) );
+
+  for( size_t k = 0; k < sizeof( _kernel_names ) / sizeof( _kernel_names[0] ); k++ )
+  {
+    ASSERT_TRUE( scan_init( &s, BLOCK_SIZE, SCAN_MAX_PREFIX ) );
+    if( !scan_set_kernel( &s, _kernel_names[k] ) )
+      continue;
+
+    ASSERT_EQ( 0, strcmp( _kernel_names[k], scan_kernel_name( &s ) ) );
+
+    for( unsigned int seed = 0; seed < 8; seed++ )
+    {
+      _fill( data, sizeof( data ), seed );
+
+      for( size_t len = 1; len <= SCAN_MAX_PREFIX; len++ )
+      {
+        /* a prefix taken from the block, and one that isn't in it */
+        const byte *found = data + ( seed * 37 ) % BLOCK_SIZE;
+        const byte missing[SCAN_MAX_PREFIX] = { 'a', 'b', 'c', 'z' };
+
+        /* every size, so the blocks end anywhere within the vectors */
+        for( size_t size = 0; size <= BLOCK_SIZE; size++ )
+        {
+          ASSERT_EQ( reference.kernel( data, size, found, len ),
+                     s.kernel( data, size, found, len ) );
+          ASSERT_EQ( reference.kernel( data, size, missing, len ),
+                     s.kernel( data, size, missing, len ) );
+        }
+      }
+    }
+  }
+
+  #undef BLOCK_SIZE
+}
+
+
+TEST( ScanKernelsFindAll )
+{
+  /* the window isn't a multiple of the vector widths, and wraps around the end of its buffer */
+  #define WINDOW_SIZE 100
+  #define DATA_SIZE 300
+  #define MAX_MATCHES 8
+
+  byte data[DATA_SIZE];
+  _fill( data, sizeof( data ), 1 );
+
+  window_t w;
+  ASSERT_TRUE( window_init( &w, 2 * WINDOW_SIZE, false ) );
+  window_append_block( &w, data, sizeof( data ) );
+
+  scan_t reference, s;
+  ASSERT_TRUE( scan_init( &reference, WINDOW_SIZE, 3 ) );
+  ASSERT_TRUE( scan_set_kernel( &reference, "scalar" ) );
+
+  for( size_t k = 0; k < sizeof( _kernel_names ) / sizeof( _kernel_names[0] ); k++ )
+  {
+    ASSERT_TRUE( scan_init( &s, WINDOW_SIZE, 3 ) );
+    if( !scan_set_kernel( &s, _kernel_names[k] ) )
+      continue;
+
+    for( uint64_t pos = DATA_SIZE - WINDOW_SIZE; pos + 3 <= DATA_SIZE; pos++ )
+    {
+      match_t expected[MAX_MATCHES], obtained[MAX_MATCHES];
+      size_t max_len = DATA_SIZE - pos;
+
+      size_t num_expected = scan_find_all( &reference, &w, pos, max_len, expected, MAX_MATCHES );
+      size_t num_obtained = scan_find_all( &s, &w, pos, max_len, obtained, MAX_MATCHES );
+
+      ASSERT_EQ( num_expected, num_obtained );
+      for( size_t i = 0; i < num_expected; i++ )
+      {
+        ASSERT_EQ( expected[i].pos, obtained[i].pos );
+        ASSERT_EQ( expected[i].len, obtained[i].len );
+      }
+    }
+  }
+
+  window_release( &w );
+
+  #undef WINDOW_SIZE
+  #undef DATA_SIZE
+  #undef MAX_MATCHES
+}
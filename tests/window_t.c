@@ -30,7 +30,7 @@ TEST( BasicTest )
   char c;
   window_t w;
 
-  ASSERT_TRUE( window_init( &w, WINDOW_SIZE ) );
+  ASSERT_TRUE( window_init( &w, WINDOW_SIZE, false ) );
   ASSERT_EQ( 0, window_get_size( &w ) );
   ASSERT_FALSE( window_read( &w, &c, 0 ) );
 
@@ -77,7 +77,7 @@ TEST( Overflow )
   char c;
   window_t w;
 
-  window_init( &w, WINDOW_SIZE );
+  window_init( &w, WINDOW_SIZE, false );
 
   /* fills the window and checks the last character */
   for( size_t i = 0; i < BYTES_TO_WRITE; i++ )
@@ -110,3 +110,127 @@ TEST( Overflow )
 
   #undef WINDOW_SIZE
 }
+
+
+TEST( MatchLength )
+{
+  #define WINDOW_SIZE 44
+
+  const char input[] = "0123456789abcdefghijklmnopq0123456789abcdefghijklmnopZ";
+
+  window_t w;
+  ASSERT_TRUE( window_init( &w, WINDOW_SIZE, false ) );
+
+  /* fills the window so the second string wraps around the end of the buffer */
+  for( size_t i = 0; i < strlen( input ); i++ )
+    window_append( &w, input[i] );
+
+  /* the first copy of the digits has fallen out of the window */
+  ASSERT_EQ( 0, window_match_length( &w, 0, 27, 10 ) );
+
+  /* the mismatch is after more than a word */
+  ASSERT_EQ( 16, window_match_length( &w, 10, 37, 100 ) );
+  ASSERT_EQ( 16, window_match_length( &w, 10, 37, 16 ) );
+  ASSERT_EQ( 9, window_match_length( &w, 10, 37, 9 ) );
+  ASSERT_EQ( 0, window_match_length( &w, 10, 11, 9 ) );
+
+  /* stops at the end of the data */
+  ASSERT_EQ( 27, window_match_length( &w, 27, 27, 100 ) );
+
+  window_release( &w );
+
+  #undef WINDOW_SIZE
+}
+
+
+TEST( AppendBlock )
+{
+  #define WINDOW_SIZE 40
+
+  const char input[] = "Constipated people don't give a crap.";
+
+  window_t w, expected;
+  ASSERT_TRUE( window_init( &w, WINDOW_SIZE, false ) );
+  ASSERT_TRUE( window_init( &expected, WINDOW_SIZE, false ) );
+
+  /* appends blocks of every size, some longer than the window */
+  for( size_t len = 0; len <= 2 * WINDOW_SIZE; len++ )
+  {
+    for( size_t i = 0; i < len; i++ )
+    {
+      char c = input[( len + i ) % strlen( input )];
+      window_append( &expected, c );
+      window_append_block( &w, &c, 1 );
+    }
+
+    char block[2 * WINDOW_SIZE];
+    for( size_t i = 0; i < len; i++ )
+      block[i] = input[i % strlen( input )];
+
+    window_append_block( &w, block, len );
+    for( size_t i = 0; i < len; i++ )
+      window_append( &expected, block[i] );
+
+    /* the windows must hold the same characters */
+    ASSERT_EQ( window_get_offset( &expected ), window_get_offset( &w ) );
+    ASSERT_EQ( window_get_size( &expected ), window_get_size( &w ) );
+
+    for( size_t pos = 0; pos < window_get_size( &w ); pos++ )
+    {
+      char a, b;
+      ASSERT_TRUE( window_read( &expected, &a, pos ) );
+      ASSERT_TRUE( window_read( &w, &b, pos ) );
+      ASSERT_EQ( a, b );
+    }
+  }
+
+  window_release( &w );
+  window_release( &expected );
+
+  #undef WINDOW_SIZE
+}
+
+
+TEST( View )
+{
+  #define WINDOW_SIZE 40
+
+  const char input[] = "Constipated people don't give a crap.";
+
+  window_t w;
+  ASSERT_TRUE( window_init( &w, WINDOW_SIZE, false ) );
+
+  window_view_t view;
+  ASSERT_FALSE( window_view( &w, 0, 1, &view ) );
+
+  for( size_t i = 0; i < 3; i++ )
+    window_append_block( &w, input, strlen( input ) );
+
+  /* the position and length must be inside the window */
+  ASSERT_FALSE( window_view( &w, WINDOW_SIZE, 1, &view ) );
+  ASSERT_FALSE( window_view( &w, 3, 5, &view ) );
+  ASSERT_FALSE( window_view( &w, 3, 0, &view ) );
+
+  /* every span of the window holds the expected characters */
+  for( size_t pos = 0; pos < WINDOW_SIZE; pos++ )
+  {
+    for( size_t len = 1; len <= pos + 1; len++ )
+    {
+      ASSERT_TRUE( window_view( &w, pos, len, &view ) );
+      ASSERT_EQ( len, view.len[0] + view.len[1] );
+
+      for( size_t i = 0; i < len; i++ )
+      {
+        char c;
+        ASSERT_TRUE( window_read( &w, &c, pos - i ) );
+
+        byte obtained = ( i < view.len[0] ) ? view.data[0][i] : view.data[1][i - view.len[0]];
+        ASSERT_EQ( ( byte )c, obtained );
+      }
+    }
+  }
+
+  window_release( &w );
+
+  #undef WINDOW_SIZE
+}